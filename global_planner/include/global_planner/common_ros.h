@@ -153,6 +153,23 @@ double pathEnergy(const nav_msgs::Path& path, double up_penalty) {
   return total_energy;
 }
 
+// Limits how often a visualization topic is published, time going back (e.g. a
+// restarted simulation) always allows it
+class RateLimiter {
+ public:
+  bool tryPublish(const ros::Time& now, double min_period_s) {
+    if (now >= last_publish_time_ &&
+        (now - last_publish_time_).toSec() < min_period_s) {
+      return false;
+    }
+    last_publish_time_ = now;
+    return true;
+  }
+
+ private:
+  ros::Time last_publish_time_;
+};
+
 }  // namespace global_planner
 
 #endif /* GLOBAL_PLANNER_COMMON_ROS_H_ */
@@ -104,7 +104,7 @@ void GlobalPlannerNode::planPath() {
   bool found_path = global_planner_.getGlobalPath();
 
   // Publish even though no path is found
-  publishExploredCells();
+  publishExploredCells(true);
   publishPath();
 
   if (!found_path) {
@@ -157,6 +157,7 @@ void GlobalPlannerNode::dynamicReconfigureCallback(
   clicked_goal_radius_ = config.clicked_goal_radius_;
   simplify_iterations_ = config.simplify_iterations_;
   simplify_margin_ = config.simplify_margin_;
+  visualization_rate_ = config.visualization_rate_;
 
   // cell
   if (level == 2) {
@@ -212,7 +213,9 @@ void GlobalPlannerNode::positionCallback(
     // ROS_INFO("Travelled path extended");
     rot_msg.header.frame_id = "/world";
     actual_path_.poses.push_back(rot_msg);
-    actual_path_pub_.publish(actual_path_);
+    if (actual_path_pub_.getNumSubscribers() > 0) {
+      actual_path_pub_.publish(actual_path_);
+    }
   }
 }
 
@@ -363,33 +366,62 @@ void GlobalPlannerNode::publishGoal(const GoalCell& goal) {
 void GlobalPlannerNode::publishPath() {
   auto path_msg = global_planner_.getPathMsg();
   PathWithRiskMsg risk_msg = global_planner_.getPathWithRiskMsg();
+  const bool temp_path_subscribed =
+      global_temp_path_pub_.getNumSubscribers() > 0;
   // Always publish as temporary to remove any obsolete temporary path
-  global_temp_path_pub_.publish(path_msg);
-  if (!global_planner_.goal_pos_.is_temporary_) {
+  if (temp_path_subscribed) {
+    global_temp_path_pub_.publish(path_msg);
+  }
+  if (!global_planner_.goal_pos_.is_temporary_ &&
+      global_path_pub_.getNumSubscribers() > 0) {
     global_path_pub_.publish(path_msg);
   }
-  smooth_path_pub_.publish(smoothPath(path_msg));
+  const bool smooth_path_subscribed = smooth_path_pub_.getNumSubscribers() > 0;
+  if (smooth_path_subscribed) {
+    smooth_path_pub_.publish(smoothPath(path_msg));
+  }
+  if (!temp_path_subscribed && !smooth_path_subscribed) {
+    return;
+  }
 
   auto simple_path = simplifyPath(&global_planner_, global_planner_.curr_path_,
                                   simplify_iterations_, simplify_margin_);
   auto simple_path_msg = global_planner_.getPathMsg(simple_path);
-  global_temp_path_pub_.publish(simple_path_msg);
-  smooth_path_pub_.publish(smoothPath(simple_path_msg));
+  if (temp_path_subscribed) {
+    global_temp_path_pub_.publish(simple_path_msg);
+  }
+  if (smooth_path_subscribed) {
+    smooth_path_pub_.publish(smoothPath(simple_path_msg));
+  }
 }
 
 // Publish the cells that were explored in the last search
 // Can be tweeked to publish other info (path_cells)
-void GlobalPlannerNode::publishExploredCells() {
+void GlobalPlannerNode::publishExploredCells(bool rate_limited) {
+  if (explored_cells_pub_.getNumSubscribers() == 0) return;
+  const double min_period_s =
+      rate_limited && visualization_rate_ > 0.0 ? 1.0 / visualization_rate_
+                                                : 0.0;
+  if (!explored_cells_limiter_.tryPublish(ros::Time::now(), min_period_s)) {
+    return;
+  }
+
   visualization_msgs::MarkerArray msg;
 
   // The first marker deletes the ones from previous search
-  int id = 0;
   visualization_msgs::Marker marker;
-  marker.id = id;
+  marker.id = 0;
   marker.action = 3;  // same as visualization_msgs::Marker::DELETEALL
   msg.markers.push_back(marker);
 
-  id = 1;
+  // All cells go into one marker with a color per cell, rviz renders a single
+  // list much faster than one marker per cell
+  visualization_msgs::Marker cells =
+      createMarker(1, geometry_msgs::Point(), spectralColor(0.0));
+  cells.type = visualization_msgs::Marker::CUBE_LIST;
+  cells.pose.orientation.w = 1.0;
+  cells.points.reserve(global_planner_.visitor_.seen_.size());
+  cells.colors.reserve(global_planner_.visitor_.seen_.size());
   for (const auto& cell : global_planner_.visitor_.seen_) {
     // for (auto const& x : global_planner_.bubble_risk_cache_) {
     // Cell cell = x.first;
@@ -406,12 +438,12 @@ void GlobalPlannerNode::publishExploredCells() {
       // Unknown space
       color.r = color.g = color.b = 0.2;  // Dark gray
     }
-    visualization_msgs::Marker marker =
-        createMarker(id++, cell.toPoint(), color);
 
     // risk from 0% to 100%, sqrt is used to increase difference in low risk
-    msg.markers.push_back(marker);
+    cells.points.push_back(cell.toPoint());
+    cells.colors.push_back(color);
   }
+  msg.markers.push_back(cells);
   explored_cells_pub_.publish(msg);
 }
 
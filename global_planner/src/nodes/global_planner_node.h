@@ -62,6 +62,9 @@ class GlobalPlannerNode {
   double clicked_goal_radius_;
   int simplify_iterations_;
   double simplify_margin_;
+  double visualization_rate_;
+
+  RateLimiter explored_cells_limiter_;
 
   // Subscribers
   ros::Subscriber octomap_sub_;
@@ -109,7 +112,7 @@ class GlobalPlannerNode {
   void fcuInputGoalCallback(const mavros_msgs::Trajectory& msg);
   void publishGoal(const GoalCell& goal);
   void publishPath();
-  void publishExploredCells();
+  void publishExploredCells(bool rate_limited = false);
 
   void printPointInfo(double x, double y, double z);
 };
@@ -10,35 +10,39 @@ namespace avoidance {
 
 // Be very careful choosing the resolution! Valid resolutions must fullfill:
 // 180 % (2 * ALPHA_RES) = 0
-// Examples of valid resolution values: 1, 3, 5, 6, 10, 15, 18, 30, 45, 60
+// Examples of valid resolution values: 1, 3, 5, 6, 10, 15, 18, 30, 45
 const int ALPHA_RES = 6;
+static_assert(180 % (2 * ALPHA_RES) == 0,
+              "ALPHA_RES must fulfill 180 % (2 * ALPHA_RES) = 0");
 const int GRID_LENGTH_Z = 360 / ALPHA_RES;
 const int GRID_LENGTH_E = 180 / ALPHA_RES;
 
-class Histogram {
-  int resolution_;
-  int z_dim_;
-  int e_dim_;
-  Eigen::MatrixXf dist_;
-
-  /**
-  * @brief     wraps elevation and azimuth indeces around the histogram
-  * @param     x, elevation angle index
-  * @param     y, azimuth angle index
-  **/
-  inline void wrapIndex(int &x, int &y) const {
-    x = x % e_dim_;
-    if (x < 0) x += e_dim_;
-    y = y % z_dim_;
-    if (y < 0) y += z_dim_;
-  }
+/**
+* @brief polar histogram with a compile time resolution. The cells are stored
+*        in a fixed size, aligned matrix which lives inside the object, so
+*        histograms can be allocated on the stack and copied without heap
+*        allocations. Instantiations are provided for 3, 6 and 12 degrees.
+**/
+template <int RES>
+class PolarHistogram {
+  // the stricter constraint on ALPHA_RES above keeps the histogram of twice
+  // its resolution, used to select coarse candidates, an instantiation
+  static_assert(RES > 0 && 180 % RES == 0,
+                "histogram resolution must divide 180 degrees");
 
  public:
-  Histogram(const int res);
-  ~Histogram() = default;
+  static constexpr int resolution = RES;
+  static constexpr int e_dim = 180 / RES;
+  static constexpr int z_dim = 360 / RES;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  PolarHistogram();
+  ~PolarHistogram() = default;
 
   /**
-  * @brief     getter method for histogram cell distance
+  * @brief     getter method for histogram cell distance, indices outside the
+  *            histogram are wrapped around
   * @param[in] x, elevation angle index
   * @param[in] y, azimuth angle index
   * @returns   distance to the vehicle of obstacle mapped to (x, y) cell [m]
@@ -48,6 +52,15 @@ class Histogram {
     return dist_(x, y);
   }
 
+  /**
+  * @brief     getter method for histogram cell distance without wrapping, for
+  *            inner loops which only visit valid cells
+  * @param[in] x, elevation angle index in [0, e_dim)
+  * @param[in] y, azimuth angle index in [0, z_dim)
+  * @returns   distance to the vehicle of obstacle mapped to (x, y) cell [m]
+  **/
+  inline float get_dist_unchecked(int x, int y) const { return dist_(x, y); }
+
   /**
   * @brief     setter method for histogram cell distance
   * @param[in] x, elevation angle index
@@ -57,32 +70,6 @@ class Histogram {
   **/
   inline void set_dist(int x, int y, float value) { dist_(x, y) = value; }
 
-  /**
-  * @brief     Compute the upsampled version of the histogram
-  * @param[in] This object. Needs to be a histogram the larger bin size
-  *(ALPHA_RES * 2)
-  * @details   The histogram is upsampled to get the same histogram at regular
-  *bin size (ALPHA_RES).
-  *            This means the histogram matrix will be double the size in each
-  *dimension
-  * @returns   Modifies the object it is called from to have regular resolution
-  * @warning   Can only be called from a large bin size histogram
-  **/
-  void upsample();
-
-  /**
-  * @brief     Compute the downsampled version of the histogram
-  * @param[in] this object. Needs to be a histogram with regular bin size
-  *(ALPHA_RES)
-  * @details   The histogram is downsampled to get the same histogram at larger
-  *bin size (ALPHA_RES/2).
-  *            This means the histogram matrix will be half the size in each
-  *dimension
-  * @returns   Modifies the object it is called from to have larger bins
-  * @warning   Can only be called from a regular bin size histogram
-  **/
-  void downsample();
-
   /**
   * @brief     resets all histogram cells age and distance to zero
   **/
@@ -94,7 +81,72 @@ class Histogram {
   * @returns   whether histogram is empty
   **/
   bool isEmpty() const;
+
+ private:
+  Eigen::Matrix<float, 180 / RES, 360 / RES, Eigen::RowMajor> dist_;
+
+  /**
+  * @brief     wraps elevation and azimuth indeces around the histogram
+  * @param     x, elevation angle index
+  * @param     y, azimuth angle index
+  **/
+  inline void wrapIndex(int &x, int &y) const {
+    x = x % e_dim;
+    if (x < 0) x += e_dim;
+    y = y % z_dim;
+    if (y < 0) y += z_dim;
+  }
 };
+
+template <int RES>
+constexpr int PolarHistogram<RES>::resolution;
+template <int RES>
+constexpr int PolarHistogram<RES>::e_dim;
+template <int RES>
+constexpr int PolarHistogram<RES>::z_dim;
+
+typedef PolarHistogram<ALPHA_RES> Histogram;
+
+/**
+* @brief     Compute the upsampled version of a histogram
+* @param[in] histogram, histogram with the larger bin size (RES)
+* @details   Every cell is split into four cells of half the bin size, the
+*            histogram matrix will be double the size in each dimension
+* @returns   histogram with bin size RES / 2
+**/
+template <int RES>
+PolarHistogram<RES / 2> upsample(const PolarHistogram<RES>& histogram) {
+  static_assert(RES % 2 == 0, "cannot upsample an odd resolution");
+  PolarHistogram<RES / 2> upsampled;
+  for (int i = 0; i < PolarHistogram<RES / 2>::e_dim; ++i) {
+    for (int j = 0; j < PolarHistogram<RES / 2>::z_dim; ++j) {
+      upsampled.set_dist(i, j, histogram.get_dist_unchecked(i / 2, j / 2));
+    }
+  }
+  return upsampled;
+}
+
+/**
+* @brief     Compute the downsampled version of a histogram
+* @param[in] histogram, histogram with the regular bin size (RES)
+* @details   Four cells are fused into one cell of double the bin size, the
+*            histogram matrix will be half the size in each dimension
+* @returns   histogram with bin size 2 * RES
+**/
+template <int RES>
+PolarHistogram<2 * RES> downsample(const PolarHistogram<RES>& histogram) {
+  PolarHistogram<2 * RES> downsampled;
+  for (int i = 0; i < PolarHistogram<2 * RES>::e_dim; ++i) {
+    for (int j = 0; j < PolarHistogram<2 * RES>::z_dim; ++j) {
+      float sum = histogram.get_dist_unchecked(2 * i, 2 * j) +
+                  histogram.get_dist_unchecked(2 * i + 1, 2 * j) +
+                  histogram.get_dist_unchecked(2 * i, 2 * j + 1) +
+                  histogram.get_dist_unchecked(2 * i + 1, 2 * j + 1);
+      downsampled.set_dist(i, j, sum / 4.f);
+    }
+  }
+  return downsampled;
+}
 }
 
 #endif  // HISTOGRAM_H
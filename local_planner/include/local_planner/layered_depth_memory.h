@@ -0,0 +1,143 @@
+#ifndef LAYERED_DEPTH_MEMORY_H
+#define LAYERED_DEPTH_MEMORY_H
+
+#include "box.h"
+#include "histogram.h"
+
+#include <Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace avoidance {
+
+/**
+* @brief compact obstacle memory which stores, for every cell of the
+*        subsampling histogram (ALPHA_RES / 2), the nearest ranges seen in
+*        that direction with their age. When the vehicle moves the layers are
+*        re-projected to the new position. It replaces processPointcloud and
+*        the ObstacleMemory when selected at launch.
+**/
+class LayeredDepthMemory {
+ public:
+  // one remembered range, 6 bytes
+  struct Layer {
+    uint16_t range_mm;
+    // capture time on the memory clock in hundredths of a second, modulo
+    // 2^16, so ages up to 655s can be told apart
+    uint16_t stamp_cs;
+    uint8_t e_offset;  // direction inside the cell in 1/256 of a cell
+    uint8_t z_offset;
+  };
+  typedef PolarHistogram<ALPHA_RES / 2> Grid;
+
+ private:
+  // new point which is a candidate for the nearest layers of its cell, the
+  // index holds the cloud in the upper 8 and the point in the lower 24 bits
+  struct Candidate {
+    float range;
+    uint32_t index;
+  };
+
+  int n_layers_;
+  bool has_position_ = false;
+  Eigen::Vector3f position_;
+  // memory clock, the sum of the elapsed times of all updates [s]. Ages are
+  // taken from the absolute clock so their rounding does not add up
+  double time_s_ = 0.0;
+  // n_layers_ slots per cell sorted by range, the first counts_ are used
+  std::vector<Layer> layers_;
+  std::vector<uint8_t> counts_;
+  // double buffer for re-projection and new data
+  std::vector<Layer> next_layers_;
+  std::vector<uint8_t> next_counts_;
+  // nearest new points of every cell, reused between updates
+  std::vector<Candidate> candidates_;
+  std::vector<uint8_t> candidate_counts_;
+
+  /**
+  * @brief     inserts a layer into a cell, keeping the nearest n_layers_
+  * @param     layers, counts, storage to insert into
+  * @param[in] cell, flattened cell index
+  * @param[in] layer, layer to be inserted
+  **/
+  void insertNearest(std::vector<Layer>& layers, std::vector<uint8_t>& counts,
+                     int cell, const Layer& layer) const;
+
+  /**
+  * @brief     encodes a point relative to the vehicle as cell and layer
+  * @param[in] offset, point relative to the vehicle
+  * @param[in] stamp_cs, capture time of the point on the memory clock
+  * @param[out] cell, flattened cell index
+  * @param[out] layer, encoded layer
+  **/
+  void encode(const Eigen::Vector3f& offset, uint16_t stamp_cs, int& cell,
+              Layer& layer) const;
+
+  /**
+  * @brief     current time of the memory clock as layer stamp
+  **/
+  uint16_t clockStamp() const;
+
+  /**
+  * @brief     decodes a layer to a point relative to the vehicle
+  * @param[in] cell, flattened cell index
+  * @param[in] layer, encoded layer
+  * @returns   point relative to the vehicle
+  **/
+  Eigen::Vector3f decode(int cell, const Layer& layer) const;
+
+ public:
+  /**
+  * @param[in] n_layers, number of ranges remembered per cell
+  **/
+  LayeredDepthMemory(int n_layers);
+  ~LayeredDepthMemory() = default;
+
+  /**
+  * @brief     re-projects and ages the remembered layers and replaces them
+  *            with the new data in every cell the new data covers
+  * @param[in] complete_cloud, array of pointclouds from the sensors, at most
+  *            256 clouds of 2^24 points are used
+  * @param[in] histogram_box, geometry definition of the bounding box
+  * @param[in] position, current vehicle position
+  * @param[in] min_realsense_dist, minimum sensor range [m]
+  * @param[in] max_age, maximum age to keep data [s], at most 655s
+  * @param[in] elapsed_s, time elapsed since the last update [s]
+  **/
+  void update(const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud,
+              Box histogram_box, const Eigen::Vector3f& position,
+              float min_realsense_dist, float max_age, float elapsed_s);
+
+  /**
+  * @brief      converts the layers to points around the last position
+  * @param[out] cloud, one point per layer, the intensity is its age [s]
+  **/
+  void getPoints(pcl::PointCloud<pcl::PointXYZI>& cloud) const;
+
+  /**
+  * @brief     number of remembered layers
+  **/
+  size_t size() const;
+
+  /**
+  * @brief     memory used by the remembered layers [bytes]
+  **/
+  size_t memoryFootprint() const {
+    return layers_.size() * sizeof(Layer) + counts_.size();
+  }
+
+  /**
+  * @brief     memory used by the buffers reused between updates [bytes]
+  **/
+  size_t bufferFootprint() const {
+    return next_layers_.size() * sizeof(Layer) + next_counts_.size() +
+           candidates_.size() * sizeof(Candidate) + candidate_counts_.size();
+  }
+};
+}
+
+#endif  // LAYERED_DEPTH_MEMORY_H
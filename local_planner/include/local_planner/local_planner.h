@@ -7,6 +7,8 @@
 #include "candidate_direction.h"
 #include "cost_parameters.h"
 #include "histogram.h"
+#include "layered_depth_memory.h"
+#include "obstacle_memory.h"
 
 #include <dynamic_reconfigure/server.h>
 #include <local_planner/LocalPlannerNodeConfig.h>
@@ -26,13 +28,16 @@
 
 #include <ros/time.h>
 #include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace avoidance {
 
+class PolarBinningTable;
 class StarPlanner;
-class TreeNode;
+class SearchTree;
+class WorkerPool;
 
 /**
 * @brief struct to contain the parameters needed for the model based trajectory
@@ -92,17 +97,23 @@ class LocalPlanner {
 
   waypoint_choice waypoint_type_;
   ros::Time last_path_time_;
-  ros::Time last_pointcloud_process_time_;
 
   std::vector<int> e_FOV_idx_;
   std::vector<int> z_FOV_idx_;
   std::deque<float> goal_dist_incline_;
   std::vector<float> cost_path_candidates_;
   std::vector<int> cost_idx_sorted_;
-  std::vector<int> closed_set_;
 
-  std::vector<TreeNode> tree_;
   std::unique_ptr<StarPlanner> star_planner_;
+  std::shared_ptr<const PolarBinningTable> binning_table_;
+  // threads subsampling the pointclouds, serial if not set
+  std::unique_ptr<WorkerPool> pointcloud_pool_;
+  // remembered obstacles in voxels of 0.1m, about the size of a subsampling
+  // cell at 2m distance
+  ObstacleMemory obstacle_memory_{0.1f};
+  // replaces processPointcloud and obstacle_memory_ if set
+  std::unique_ptr<LayeredDepthMemory> layered_memory_;
+  double last_layered_memory_update_s_ = 0.0;
   costParameters cost_params_;
 
   pcl::PointCloud<pcl::PointXYZI> final_cloud_;
@@ -112,8 +123,8 @@ class LocalPlanner {
   Eigen::Vector3f goal_ = Eigen::Vector3f::Zero();
   Eigen::Vector3f position_old_ = Eigen::Vector3f::Zero();
 
-  Histogram polar_histogram_ = Histogram(ALPHA_RES);
-  Histogram to_fcu_histogram_ = Histogram(ALPHA_RES);
+  Histogram polar_histogram_;
+  Histogram to_fcu_histogram_;
   Eigen::MatrixXf cost_matrix_;
 
   /**
@@ -152,6 +163,8 @@ class LocalPlanner {
   bool smooth_waypoints_ = true;
   bool send_obstacles_fcu_ = false;
   bool disable_rise_to_goal_altitude_ = false;
+  bool generate_histogram_image_ = true;
+  bool generate_cost_image_ = true;
 
   double timeout_critical_;
   double timeout_termination_;
@@ -168,6 +181,8 @@ class LocalPlanner {
   // original_cloud_vector_ contains n complete clouds from the cameras
   std::vector<pcl::PointCloud<pcl::PointXYZ>> original_cloud_vector_;
 
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
   LocalPlanner();
   ~LocalPlanner();
 
@@ -199,6 +214,21 @@ class LocalPlanner {
   void dynamicReconfigureSetParams(avoidance::LocalPlannerNodeConfig& config,
                                    uint32_t level);
   /**
+  * @brief     builds the binning table requested by the parameters without
+  *            changing the planner, takes up to a second for small voxels so
+  *            call it outside the lock that serializes the planner. Only the
+  *            thread calling setBinningTable may call it
+  * @param     config, struct containing all the parameters
+  * @returns   the current table if it still matches, nullptr if disabled
+  **/
+  std::shared_ptr<const PolarBinningTable> buildBinningTable(
+      const avoidance::LocalPlannerNodeConfig& config) const;
+  /**
+  * @brief     replaces the table used to bin points into the histogram
+  * @param     table, result of buildBinningTable
+  **/
+  void setBinningTable(std::shared_ptr<const PolarBinningTable> table);
+  /**
   * @brief     getter method for current vehicle position and orientation
   * @returns   vehicle position and orientation
   **/
@@ -218,11 +248,11 @@ class LocalPlanner {
 
   /**
   * @brief     getter method to visualize the tree in rviz
-  * @param[in] tree, the whole tree built during planning (vector of nodes)
+  * @param[in] tree, the whole tree built during planning
   * @param[in] closed_set, velocity message coming from the FCU
   * @param[in] path_node_positions, velocity message coming from the FCU
   **/
-  void getTree(std::vector<TreeNode>& tree, std::vector<int>& closed_set,
+  void getTree(SearchTree& tree, std::vector<int>& closed_set,
                std::vector<Eigen::Vector3f>& path_node_positions) const;
   /**
   * @brief     getter method for obstacle distance information
@@ -246,6 +276,14 @@ class LocalPlanner {
   **/
   void runPlanner();
 
+  /**
+  * @brief     selects the obstacle memory representation
+  * @param[in] n_layers, number of ranges remembered per subsampling cell by
+  *            a LayeredDepthMemory, 0 to remember points in the voxel
+  *            ObstacleMemory
+  **/
+  void setDepthMemoryLayers(int n_layers);
+
   /**
   * @brief     setter method for PX4 Firmware paramters
   **/
@@ -3,6 +3,10 @@
 
 #include "local_planner/avoidance_output.h"
 #include "local_planner/local_planner_visualization.h"
+#include "local_planner/pointcloud_ingestion.h"
+#include "local_planner/pose_buffer.h"
+#include "local_planner/stage_timer.h"
+#include "local_planner/triple_buffer.h"
 
 #ifndef DISABLE_SIMULATION
 // include simulation
@@ -19,23 +23,27 @@
 #include <mavros_msgs/SetMode.h>
 #include <mavros_msgs/State.h>
 #include <mavros_msgs/Trajectory.h>
-#include <pcl/filters/filter.h>
-#include <pcl_conversions/pcl_conversions.h>  // fromROSMsg
+#include <pcl_conversions/pcl_conversions.h>  // toPCL
 #include <pcl_ros/point_cloud.h>
-#include <pcl_ros/transforms.h>  // transformPointCloud
 #include <ros/ros.h>
 #include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/Image.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/Range.h>
 #include <std_msgs/Bool.h>
 #include <std_msgs/Float64.h>
 #include <std_msgs/String.h>
+#include <std_msgs/UInt32MultiArray.h>
 #include <tf/transform_listener.h>
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
 #include <Eigen/Core>
 #include <boost/bind.hpp>
 
+#ifndef DISABLE_STAGE_TIMING
+#include <diagnostic_msgs/DiagnosticArray.h>
+#endif
+
 #include <dynamic_reconfigure/server.h>
 #include <local_planner/LocalPlannerNodeConfig.h>
 
@@ -53,19 +61,31 @@ class WaypointGenerator;
 struct cameraData {
   std::string topic_;
   ros::Subscriber pointcloud_sub_;
+  ros::Subscriber depth_image_sub_;
   ros::Subscriber camera_info_sub_;
-  sensor_msgs::PointCloud2 newest_cloud_msg_;
-
-  std::unique_ptr<std::mutex> trans_ready_mutex_;
-  std::unique_ptr<std::condition_variable> trans_ready_cv_;
-
+  // number of points entering and leaving the prefilter for every cloud
+  ros::Publisher prefilter_counts_pub_;
+  // a camera either publishes pointclouds or depth images
+  sensor_msgs::PointCloud2::ConstPtr newest_cloud_msg_;
+  sensor_msgs::Image::ConstPtr newest_depth_msg_;
+  sensor_msgs::CameraInfo::ConstPtr camera_info_;
+
+  // guards the newest messages and the extrinsics
   std::unique_ptr<std::mutex> cloud_ready_mutex_;
   std::unique_ptr<std::condition_variable> cloud_ready_cv_;
   std::thread transform_thread_;
-  pcl::PointCloud<pcl::PointXYZ> pcl_cloud;
+  // transformed clouds handed from the transform thread to the main loop
+  // without locking, the point storage is recycled between the two
+  std::unique_ptr<TripleBuffer<pcl::PointCloud<pcl::PointXYZ>>> cloud_buffer_;
+
+  // static transform from the camera to the vehicle frame, looked up once
+  Eigen::Transform<float, 3, Eigen::Affine, Eigen::DontAlign> extrinsics_;
+  bool has_extrinsics_;
 
   bool received_;
-  bool transformed_;
+  // the read buffer holds a cloud the planner has not been given yet, only
+  // accessed by the main loop
+  bool fresh_;
 };
 
 enum class MAV_STATE {
@@ -104,6 +124,27 @@ class LocalPlannerNode {
   bool disable_rise_to_goal_altitude_;
   bool accept_goal_input_topic_;
   std::atomic<bool> should_exit_{false};
+  // crop and decimation applied by the transform threads
+  std::atomic<float> pointcloud_max_range_{INFINITY};
+  std::atomic<int> pointcloud_stride_{1};
+  std::atomic<bool> angular_stride_{true};
+  // prefilter applied by the transform threads after the ingestion
+  std::atomic<float> prefilter_leaf_size_{0.f};
+  std::atomic<int> prefilter_max_points_{0};
+  // clouds older than this are left out of a planning cycle, 0 waits for a
+  // new cloud from every camera instead
+  float max_cloud_staleness_s_ = 0.f;
+
+  // vehicle frame the camera extrinsics are expressed in
+  std::string body_frame_;
+  // vehicle poses to transform the clouds at their timestamp
+  PoseBuffer pose_buffer_;
+
+  // time the main loop spends taking the clouds from the camera threads
+  double handoff_ms_sum_ = 0.0;
+  double handoff_ms_max_ = 0.0;
+  size_t handoff_count_ = 0;
+  ros::WallTime handoff_report_time_;
 
   std::vector<cameraData> cameras_;
 
@@ -121,6 +162,7 @@ class LocalPlannerNode {
 
   ros::Time last_wp_time_;
   ros::Time t_status_sent_;
+  ros::Time t_stage_timings_sent_;
 
   std::unique_ptr<LocalPlanner> local_planner_;
   std::unique_ptr<WaypointGenerator> wp_generator_;
@@ -136,6 +178,9 @@ class LocalPlannerNode {
   ros::Publisher mavros_obstacle_distance_pub_;
   ros::ServiceClient get_px4_param_client_;
   ros::Publisher mavros_system_status_pub_;
+#ifndef DISABLE_STAGE_TIMING
+  ros::Publisher stage_timings_pub_;
+#endif
   tf::TransformListener* tf_listener_;
 
   std::mutex running_mutex_;  ///< guard against concurrent access to input &
@@ -145,24 +190,37 @@ class LocalPlannerNode {
   std::mutex px4_params_mutex_;
   std::condition_variable data_ready_cv_;
 
+  // planner output handed from the planner thread to the visualization
+  // thread, which publishes it without holding running_mutex_
+  TripleBuffer<plannerVisualizationData> visualization_buffer_;
+  std::mutex visualization_ready_mutex_;
+  std::condition_variable visualization_ready_cv_;
+
   /**
   * @brief     handles threads for data publication and subscription
   **/
   void threadFunction();
 
+  /**
+  * @brief     publishes the planner output for visualization at a lower
+  *            scheduling priority than the planner
+  **/
+  void visualizationThreadFunction();
+
   void updatePlanner();
 
   /**
-  * @brief     checks if the transformation from the camera frame to
-  *            local_origin is available at the pointcloud timestamp
-  * @returns   true, if the transformation is available
+  * @brief     checks if the transformation from the camera frames to the
+  *            vehicle frame is known and vehicle poses are available
+  * @returns   true, if the transformations are available
   **/
   bool canUpdatePlannerInfo();
 
   /**
   * @brief     updates the local planner agorithm with the latest pointcloud,
   *            vehicle position, velocity, state, and distance to ground, goal,
-  *            setpoint sent to the FCU
+  *            setpoint sent to the FCU. Clouds older than the staleness limit
+  *            are left out
   **/
   void updatePlannerInfo();
 
@@ -173,11 +231,20 @@ class LocalPlannerNode {
   size_t numReceivedClouds();
 
   /**
-  * @brief     computes the number of transformed pointclouds
-  * @ returns  number of transformed pointclouds
+  * @brief     takes the newest transformed pointclouds from the camera threads
+  *            without waiting for them
+  * @ returns  number of transformed pointclouds the planner has not been
+  *            given yet
   **/
   size_t numTransformedClouds();
 
+  /**
+  * @brief     stops listening to the camera info of the cameras which have
+  *            received it, the others keep their subscription since depth
+  *            images can't be ingested without it
+  **/
+  void unsubscribeCameraInfo();
+
   /**
   * @brief     threads for transforming pointclouds
   **/
@@ -217,6 +284,14 @@ class LocalPlannerNode {
   **/
   void publishSystemStatus();
 
+#ifndef DISABLE_STAGE_TIMING
+  /**
+  * @brief      publishes the latency percentiles of every pipeline stage since
+  *             the last call on the diagnostics topic
+  **/
+  void publishStageTimings();
+#endif
+
   /**
   * @brief      check healthiness of the avoidance system to trigger failsafe in
   *             the FCU
@@ -262,6 +337,7 @@ class LocalPlannerNode {
   NavigationState nav_state_ = NavigationState::none;
   bool new_goal_ = false;
   bool data_ready_ = false;
+  bool visualization_ready_ = false;
 
   dynamic_reconfigure::Server<avoidance::LocalPlannerNodeConfig>* server_;
   boost::recursive_mutex config_mutex_;
@@ -277,8 +353,11 @@ class LocalPlannerNode {
   /**
   * @brief     subscribes to all the camera topics and camera info
   * @param     camera_topics, array with the pointcloud topics strings
+  * @param     depth_image_topics, array with the depth image topics strings
   **/
-  void initializeCameraSubscribers(std::vector<std::string>& camera_topics);
+  void initializeCameraSubscribers(
+      std::vector<std::string>& camera_topics,
+      std::vector<std::string>& depth_image_topics);
 
   /**
   * @brief     callaback for vehicle position and orientation
@@ -294,6 +373,12 @@ class LocalPlannerNode {
   void pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& msg,
                           int index);
   /**
+  * @brief     callaback for depth images
+  * @param[in] msg, depth image message
+  * @param[in] index, camera instance number
+  **/
+  void depthImageCallback(const sensor_msgs::Image::ConstPtr& msg, int index);
+  /**
   * @brief     callaback for camera information
   * @param[in] msg, camera information message
   * @param[in] index, camera info instace number
@@ -2,16 +2,41 @@
 #define LOCAL_PLANNER_VISUALIZATION_H
 
 #include "local_planner/local_planner.h"
+#include "local_planner/rate_limiter.h"
+#include "local_planner/search_tree.h"
 
 #include <pcl/point_cloud.h>
 #include <pcl_ros/point_cloud.h>
 #include <ros/ros.h>
 #include <std_msgs/UInt32.h>
 #include <Eigen/Dense>
+#include <atomic>
 #include <vector>
 
 namespace avoidance {
 
+/**
+* @brief copy of the planner outputs at the end of one planner iteration, so
+*        they can be published without holding the planner lock
+**/
+struct plannerVisualizationData {
+  pcl::PointCloud<pcl::PointXYZI> pointcloud;
+  SearchTree tree;
+  std::vector<int> closed_set;
+  std::vector<Eigen::Vector3f> path_node_positions;
+  Eigen::Vector3f goal = Eigen::Vector3f::Zero();
+  Eigen::Vector3f position = Eigen::Vector3f::Zero();
+  float box_radius = 0.f;
+  float box_zmin = 0.f;
+  Eigen::Vector3f take_off_pose = Eigen::Vector3f::Zero();
+  float starting_height = 0.f;
+  std::vector<uint8_t> histogram_image_data;
+  std::vector<uint8_t> cost_image_data;
+  geometry_msgs::Point newest_waypoint_position;
+  geometry_msgs::Point newest_adapted_waypoint_position;
+  geometry_msgs::PoseStamped newest_pose;
+};
+
 class LocalPlannerVisualization {
  public:
   /**
@@ -20,18 +45,54 @@ class LocalPlannerVisualization {
   void initializePublishers(ros::NodeHandle& nh);
 
   /**
-  * @brief       Main function which calls functions to visualize all planner
-  *              output ready at the end of one planner iteration
+  * @brief      limits how often each visualization topic is published
+  * @param[in]  max_rate, maximum publishing rate [Hz], 0 for no limit
+  **/
+  void setMaxRate(double max_rate);
+
+  /**
+  * @brief      checks whether the output of the current planner iteration
+  *             should be visualized, restarts the rate limit if it should
+  * @returns    true, if any planner output topic is subscribed to and the
+  *             maximum rate allows publishing
+  **/
+  bool plannerDataDue();
+
+  /**
+  * @brief      checks whether the histogram image is subscribed to
+  * @returns    true, if the planner needs to generate the histogram image
+  **/
+  bool hasHistogramImageSubscribers() const;
+
+  /**
+  * @brief      checks whether the cost image is subscribed to
+  * @returns    true, if the planner needs to generate the cost image
+  **/
+  bool hasCostImageSubscribers() const;
+
+  /**
+  * @brief       copies the planner output of one planner iteration which is
+  *              subscribed to, the storage of data is reused
   * @params[in]  planner, reference to the planner
   * @params[in]  newest_waypoint_position, last caluclated waypoint (smoothed)
   * @params[in]  newest_adapted_waypoint_position, last caluclated waypoint
   *              (non-smoothed)
+  * @params[in]  newest_pose, most recent drone pose
+  * @params[out] data, snapshot of the planner output
   **/
-  void visualizePlannerData(
+  void getPlannerData(
       const LocalPlanner& planner,
       const geometry_msgs::Point& newest_waypoint_position,
       const geometry_msgs::Point& newest_adapted_waypoint_position,
-      const geometry_msgs::PoseStamped& newest_pose) const;
+      const geometry_msgs::PoseStamped& newest_pose,
+      plannerVisualizationData& data) const;
+
+  /**
+  * @brief       Main function which calls functions to visualize all planner
+  *              output of one planner iteration
+  * @params[in]  data, snapshot of the planner output
+  **/
+  void visualizePlannerData(const plannerVisualizationData& data) const;
 
   /**
   * @brief       Visualization of the calculated search tree and the best path
@@ -42,7 +103,7 @@ class LocalPlannerVisualization {
   *              the chosen best path
   **/
   void publishTree(
-      const std::vector<TreeNode>& tree, const std::vector<int>& closed_set,
+      const SearchTree& tree, const std::vector<int>& closed_set,
       const std::vector<Eigen::Vector3f>& path_node_positions) const;
 
   /**
@@ -96,7 +157,7 @@ class LocalPlannerVisualization {
   **/
   void visualizeWaypoints(const Eigen::Vector3f& goto_position,
                           const Eigen::Vector3f& adapted_goto_position,
-                          const Eigen::Vector3f& smoothed_goto_position) const;
+                          const Eigen::Vector3f& smoothed_goto_position);
 
   /**
   * @brief       Visualization of the actual path of the drone and the path of
@@ -128,7 +189,7 @@ class LocalPlannerVisualization {
   **/
   void publishCurrentSetpoint(const geometry_msgs::Twist& wp,
                               const waypoint_choice& waypoint_type,
-                              const geometry_msgs::Point& newest_pos) const;
+                              const geometry_msgs::Point& newest_pos);
 
   /**
   * @brief       Visualization of the ground
@@ -137,7 +198,7 @@ class LocalPlannerVisualization {
   * @params[in]  ground_distance, measured distance to ground
   **/
   void publishGround(const Eigen::Vector3f& drone_pos, float box_radius,
-                     float ground_distance) const;
+                     float ground_distance);
 
  private:
   ros::Publisher local_pointcloud_pub_;
@@ -160,6 +221,25 @@ class LocalPlannerVisualization {
   ros::Publisher cost_image_pub_;
 
   int path_length_ = 0;
+  // start of the path segments not published yet due to the rate limit
+  bool path_segment_pending_ = false;
+  geometry_msgs::Point path_start_pos_;
+  geometry_msgs::Point path_start_wp_;
+  geometry_msgs::Point path_start_adapted_wp_;
+
+  std::atomic<double> min_publish_period_s_{0.0};
+  RateLimiter planner_data_limiter_;
+  RateLimiter waypoints_limiter_;
+  RateLimiter paths_limiter_;
+  RateLimiter setpoint_limiter_;
+  RateLimiter ground_limiter_;
+
+  /**
+  * @brief      checks the rate limit of a topic group and restarts it if the
+  *             group can be published
+  * @param      limiter, rate limit of the group
+  **/
+  bool rateAllows(RateLimiter& limiter);
 };
 }
 #endif  // LOCAL_PLANNER_VISUALIZATION_H
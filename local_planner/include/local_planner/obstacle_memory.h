@@ -0,0 +1,137 @@
+#ifndef OBSTACLE_MEMORY_H
+#define OBSTACLE_MEMORY_H
+
+#include <Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+namespace avoidance {
+
+/**
+* @brief world frame obstacle memory. Every voxel remembers the last point
+*        seen inside it and when it was seen. The voxels are grouped into
+*        cubic blocks, so reading the memory around the vehicle only visits
+*        the blocks overlapping the query and the cost does not depend on
+*        how much has been remembered elsewhere. Voxels older than the
+*        maximum age are removed when their block is read, and every read
+*        also sweeps a slice of the hash buckets for expired blocks, so the
+*        memory does not grow with the distance flown.
+**/
+class ObstacleMemory {
+  struct Voxel {
+    float x, y, z;
+    double last_seen;
+  };
+  struct Block {
+    double last_seen = 0.0;
+    // voxels indexed by their position inside the block
+    std::unordered_map<int, Voxel> voxels;
+  };
+
+  float voxel_size_;
+  int block_voxels_;  // voxels per block edge
+  std::unordered_map<int64_t, Block> blocks_;
+  size_t n_voxels_ = 0;
+  // next hash bucket checked for expired blocks
+  size_t sweep_bucket_ = 0;
+  // every block is checked at least once in this many reads
+  static constexpr size_t kSweepPasses = 32;
+
+  /**
+  * @brief     computes the integer voxel coordinate along one axis
+  * @param[in] coordinate, world coordinate [m]
+  * @returns   voxel coordinate
+  **/
+  inline int voxelCoordinate(float coordinate) const {
+    return static_cast<int>(std::floor(coordinate / voxel_size_));
+  }
+
+  /**
+  * @brief     splits a voxel coordinate into the block coordinate and the
+  *            position inside the block
+  * @param[in] voxel, voxel coordinate
+  * @param[out] offset, voxel position inside the block
+  * @returns   block coordinate
+  **/
+  inline int blockCoordinate(int voxel, int& offset) const {
+    int block = voxel / block_voxels_;
+    offset = voxel - block * block_voxels_;
+    if (offset < 0) {
+      block--;
+      offset += block_voxels_;
+    }
+    return block;
+  }
+
+  /**
+  * @brief     packs block coordinates into a single hash key
+  * @param[in] x, y, z, block coordinates, valid within +-2^20 blocks
+  * @returns   hash key of the block
+  **/
+  inline int64_t blockKey(int x, int y, int z) const {
+    return ((static_cast<int64_t>(x) & 0x1FFFFF) << 42) |
+           ((static_cast<int64_t>(y) & 0x1FFFFF) << 21) |
+           (static_cast<int64_t>(z) & 0x1FFFFF);
+  }
+
+  /**
+  * @brief     removes the blocks not seen within the maximum age from the next
+  *            slice of hash buckets, costs 1/kSweepPasses of a full pass
+  * @param[in] timestamp, current time [s]
+  * @param[in] max_age, blocks seen this long ago or earlier are expired [s]
+  **/
+  void sweepExpiredBlocks(double timestamp, float max_age);
+
+ public:
+  /**
+  * @param[in] voxel_size, edge length of a voxel [m]
+  * @param[in] block_voxels, number of voxels along a block edge
+  **/
+  ObstacleMemory(float voxel_size, int block_voxels = 16);
+  ~ObstacleMemory() = default;
+
+  /**
+  * @brief     remembers points, replacing the point of their voxel
+  * @param[in] cloud, points in the world frame
+  * @param[in] timestamp, time the points were seen [s]
+  **/
+  void insert(const pcl::PointCloud<pcl::PointXYZI>& cloud, double timestamp);
+
+  /**
+  * @brief      collects the remembered points inside an axis aligned box,
+  *             removes the expired voxels of all blocks it visits and sweeps
+  *             some of the other blocks
+  * @param[in]  lower, upper, corners of the box
+  * @param[in]  timestamp, current time [s]
+  * @param[in]  max_age, points seen this long ago or earlier are expired [s]
+  * @param[out] cloud, points inside the box, the intensity is their age [s]
+  **/
+  void getPoints(const Eigen::Vector3f& lower, const Eigen::Vector3f& upper,
+                 double timestamp, float max_age,
+                 pcl::PointCloud<pcl::PointXYZI>& cloud);
+
+  /**
+  * @brief     forgets the voxel containing a point
+  * @param[in] x, y, z, world coordinates of the point
+  **/
+  void erase(float x, float y, float z);
+
+  /**
+  * @brief     forgets everything
+  **/
+  void clear();
+
+  /**
+  * @brief     getter method for the number of remembered voxels
+  * @returns   number of voxels
+  **/
+  size_t size() const { return n_voxels_; }
+};
+}
+
+#endif  // OBSTACLE_MEMORY_H
@@ -6,6 +6,9 @@
 #include "common.h"
 #include "cost_parameters.h"
 #include "histogram.h"
+#include "obstacle_memory.h"
+#include "polar_binning.h"
+#include "worker_pool.h"
 
 #include <Eigen/Dense>
 
@@ -18,21 +21,28 @@
 namespace avoidance {
 
 /**
-* @brief      crops and subsamples the incomming data, then combines it with
-*             the data from the last timestep
-* @param      final_cloud, processed data to be used for planning
+* @brief      crops and subsamples the incomming data, stores it in the
+*             obstacle memory and combines it with the remembered data
+* @param[out] final_cloud, processed data to be used for planning, the
+*             intensity is the age of a point [s]
 * @param[in]  complete_cloud, array of pointclouds from the sensors
 * @param[in]  histogram_box, geometry definition of the bounding box
 * @param[in]  position, current vehicle position
 * @param[in]  min_realsense_dist, minimum sensor range [m]
-* @param[in]  max_age, maximum age (compute cycles) to keep data
-* @param[in]  elapsed, time elapsed since last processing [s]
+* @param[in]  max_age, maximum age to keep data [s]
+* @param      memory, world frame obstacle memory
+* @param[in]  timestamp, time of the current data [s]
+* @param      pool, optional threads subsampling the new clouds. The result
+*             does not depend on the number of threads
+* @param[in]  table, optional lookup table for binning at ALPHA_RES / 2
 **/
 void processPointcloud(
     pcl::PointCloud<pcl::PointXYZI>& final_cloud,
     const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud,
     Box histogram_box, const Eigen::Vector3f& position,
-    float min_realsense_dist, int max_age, float elapsed_s);
+    float min_realsense_dist, float max_age, ObstacleMemory& memory,
+    double timestamp, WorkerPool* pool = nullptr,
+    const PolarBinningTable* table = nullptr);
 
 /**
 * @brief      calculates the histogram cells within the Field of View
@@ -55,10 +65,14 @@ void calculateFOV(float h_FOV, float v_FOV, std::vector<int>& z_FOV_idx,
 * @param[out] polar_histogram, represents cropped_cloud
 * @param[in]  cropped_cloud, current frame filtered pointcloud
 * @param[in]  position, current vehicle position
+* @param[in]  table, optional lookup table for binning at RES or a divisor
+* @details    instantiated for resolutions of 3, 6 and 12 degrees
 **/
-void generateNewHistogram(Histogram& polar_histogram,
+template <int RES>
+void generateNewHistogram(PolarHistogram<RES>& polar_histogram,
                           const pcl::PointCloud<pcl::PointXYZI>& cropped_cloud,
-                          const Eigen::Vector3f& position);
+                          const Eigen::Vector3f& position,
+                          const PolarBinningTable* table = nullptr);
 
 /**
 * @brief      compresses the histogram such that for each azimuth the minimum
@@ -70,6 +84,30 @@ void compressHistogramElevation(Histogram& new_hist,
                                 const Histogram& input_hist);
 /**
 * @brief      calculates each histogram bin cost and stores it in a cost matrix
+*             without generating the debug image, used in the tree search
+* @param[in]  histogram, polar histogram representing obstacles
+* @param[in]  goal, current goal position
+* @param[in]  position, current vehicle position
+* @param[in]  current vehicle heading in histogram angle convention [deg]
+* @param[in]  last_sent_waypoint, last position waypoint
+* @param[in]  cost_params, weight for the cost function
+* @param[in]  only_yawed, true if
+* @param[in]  parameter how far an obstacle is spread in the cost matrix
+* @param[out] cost_matrix
+**/
+template <int RES>
+void getCostMatrix(const PolarHistogram<RES>& histogram,
+                   const Eigen::Vector3f& goal,
+                   const Eigen::Vector3f& position,
+                   const float yaw_angle_histogram_frame_deg,
+                   const Eigen::Vector3f& last_sent_waypoint,
+                   costParameters cost_params, bool only_yawed,
+                   const float smoothing_margin_degrees,
+                   Eigen::MatrixXf& cost_matrix);
+
+/**
+* @brief      calculates each histogram bin cost and stores it in a cost matrix
+*             and an image for visualization
 * @param[in]  histogram, polar histogram representing obstacles
 * @param[in]  goal, current goal position
 * @param[in]  position, current vehicle position
@@ -81,7 +119,9 @@ void compressHistogramElevation(Histogram& new_hist,
 * @param[out] cost_matrix
 * @param[out] image of the cost matrix for visualization
 **/
-void getCostMatrix(const Histogram& histogram, const Eigen::Vector3f& goal,
+template <int RES>
+void getCostMatrix(const PolarHistogram<RES>& histogram,
+                   const Eigen::Vector3f& goal,
                    const Eigen::Vector3f& position,
                    const float yaw_angle_histogram_frame_deg,
                    const Eigen::Vector3f& last_sent_waypoint,
@@ -118,6 +158,32 @@ void getBestCandidatesFromCostMatrix(
     const Eigen::MatrixXf& matrix, unsigned int number_of_candidates,
     std::vector<candidateDirection>& candidate_vector);
 
+/**
+* @brief      coarse-to-fine replacement for getCostMatrix followed by
+*             getBestCandidatesFromCostMatrix. The costs are evaluated on a
+*             histogram with twice the bin size and only the cheapest coarse
+*             cells are refined at the resolution of the input histogram
+* @param[in]  histogram, polar histogram representing obstacles
+* @param[in]  goal, current goal position
+* @param[in]  position, current vehicle position
+* @param[in]  current vehicle heading in histogram angle convention [deg]
+* @param[in]  last_sent_waypoint, last position waypoint
+* @param[in]  cost_params, weight for the cost function
+* @param[in]  parameter how far an obstacle is spread in the cost matrix
+* @param[in]  number_of_candidates, number of candidate direction to consider,
+*             also the number of coarse cells which are refined
+* @param[out] candidate_vector, array of candidate polar direction arranged from
+*             the least to the most expensive
+* @details    instantiated for resolutions of 3 and 6 degrees
+**/
+template <int RES>
+void getBestCandidatesCoarseToFine(
+    const PolarHistogram<RES>& histogram, const Eigen::Vector3f& goal,
+    const Eigen::Vector3f& position, const float yaw_angle_histogram_frame_deg,
+    const Eigen::Vector3f& last_sent_waypoint, costParameters cost_params,
+    const float smoothing_margin_degrees, unsigned int number_of_candidates,
+    std::vector<candidateDirection>& candidate_vector);
+
 /**
 * @brief      computes the cost of each direction in the polar histogram
 * @param[in]  e_angle, elevation angle [deg]
@@ -0,0 +1,93 @@
+#ifndef POINTCLOUD_INGESTION_H
+#define POINTCLOUD_INGESTION_H
+
+#include <Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <cmath>
+#include <random>
+
+namespace avoidance {
+
+struct ingestionParameters {
+  float max_range = INFINITY;  // points farther from the sensor are dropped
+  int row_stride = 1;          // only every n-th row of the cloud is read
+  int column_stride = 1;       // only every n-th column of the cloud is read
+};
+
+/**
+* @brief      computes the row and column strides at which neighbouring
+*             samples of an organized cloud or depth image are at most the
+*             given angle apart, measured at the image center where the pixel
+*             footprint is the largest
+* @param[in]  info, camera info with the calibrated image size and the focal
+*             lengths
+* @param[in]  width, number of columns of the cloud or image
+* @param[in]  height, number of rows of the cloud or image
+* @param[in]  resolution, angular resolution [deg] the samples are binned at
+* @param[out] params, row_stride and column_stride are set, at least 1
+**/
+void setAngularStride(const sensor_msgs::CameraInfo& info, uint32_t width,
+                      uint32_t height, float resolution,
+                      ingestionParameters& params);
+
+/**
+* @brief      reads the x, y, z fields of a pointcloud message in a single
+*             pass, dropping NaN, out of range and decimated points and
+*             transforming the remaining ones into the output cloud
+* @param[in]  msg, pointcloud message with FLOAT32 x, y and z fields
+* @param[in]  transform, transform from the sensor frame to the output frame
+* @param[in]  params, crop and decimation parameters
+* @param[out] cloud, transformed points, its storage is reused
+* @returns    false if the message has no readable x, y and z fields
+**/
+bool ingestPointCloud(const sensor_msgs::PointCloud2& msg,
+                      const Eigen::Affine3f& transform,
+                      const ingestionParameters& params,
+                      pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+/**
+* @brief      back-projects a depth image in a single pass, dropping invalid,
+*             out of range and decimated pixels and transforming the
+*             remaining points into the output cloud
+* @param[in]  msg, rectified depth image, 16UC1 or mono16 in millimeters or
+*             32FC1 in meters
+* @param[in]  info, camera info of the depth image, only the focal lengths and
+*             the principal point are used
+* @param[in]  transform, transform from the optical frame to the output frame
+* @param[in]  params, crop and decimation parameters
+* @param[out] cloud, transformed points, its storage is reused
+* @returns    false if the encoding or the camera info is not supported
+**/
+bool ingestDepthImage(const sensor_msgs::Image& msg,
+                      const sensor_msgs::CameraInfo& info,
+                      const Eigen::Affine3f& transform,
+                      const ingestionParameters& params,
+                      pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+/**
+* @brief      keeps the first point of every occupied voxel, in place and in
+*             the original order. Unlike a centroid voxel grid the kept points
+*             are measured ones
+* @param[in]  leaf_size, voxel edge length [m], values <= 0 keep all points
+* @param[out] cloud, filtered cloud
+**/
+void voxelPrefilter(float leaf_size, pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+/**
+* @brief      keeps a uniform random sample of the cloud, in place
+* @param[in]  max_points, size of the sample, 0 keeps all points
+* @param[in]  generator, random number generator of the calling thread
+* @param[out] cloud, sampled cloud, the point order is not preserved
+**/
+void randomPrefilter(size_t max_points, std::minstd_rand& generator,
+                     pcl::PointCloud<pcl::PointXYZ>& cloud);
+}
+
+#endif  // POINTCLOUD_INGESTION_H
@@ -0,0 +1,140 @@
+#ifndef POLAR_BINNING_H
+#define POLAR_BINNING_H
+
+#include <Eigen/Dense>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace avoidance {
+
+/**
+* @brief      converts a batch of cartesian points to histogram bin indices
+*             and distances to the origin, equivalent to cartesianToPolar
+*             followed by polarToHistogramIndex for every point
+* @param[in]  x, y, z, coordinates of the points as structure of arrays
+* @param[in]  n, number of points
+* @param[in]  origin, origin of the polar coordinate system
+* @param[in]  res, histogram resolution [deg]
+* @param[out] e_index, elevation bin index of every point
+* @param[out] z_index, azimuth bin index of every point
+* @param[out] range, distance of every point to the origin [m]
+* @details    the angles are evaluated with SSE2 or AVX2 and a polynomial
+*             atan2 approximation. Points closer to a bin border than the
+*             approximation error are binned with the scalar functions, so
+*             the indices always match the scalar path. Without SIMD support
+*             all points take the scalar path.
+**/
+void cartesianToHistogramIndices(const float* x, const float* y,
+                                 const float* z, size_t n,
+                                 const Eigen::Vector3f& origin, int res,
+                                 int* e_index, int* z_index, float* range);
+
+// binning tables above this size are not built, 0.05m voxels at the default
+// box radius of 12m take 221 MB
+const size_t MAX_BINNING_TABLE_BYTES = 256 * 1000 * 1000;
+
+/**
+* @brief lookup table from the quantised offset of a point to the vehicle to
+*        its histogram bin. Every voxel of a cube around the vehicle stores
+*        the bin all of its points fall into, voxels which overlap a bin
+*        border (which includes all voxels close to the vehicle) are marked
+*        as unresolved and have to be binned with the exact math.
+**/
+class PolarBinningTable {
+  static const uint16_t UNRESOLVED = 0xFFFF;
+
+  float radius_;
+  float voxel_size_;
+  float inverse_voxel_size_;
+  int res_;
+  int n_voxels_;  // per axis
+  std::vector<uint16_t> bins_;
+
+ public:
+  /**
+  * @brief     builds the table
+  * @param[in] radius, half edge length of the cube covered by the table [m]
+  * @param[in] voxel_size, edge length of a voxel [m]
+  * @param[in] res, resolution of the stored bins [deg], lookups are valid for
+  *            all multiples of it
+  **/
+  PolarBinningTable(float radius, float voxel_size, int res);
+  ~PolarBinningTable() = default;
+
+  /**
+  * @brief      looks up the histogram bin of a point
+  * @param[in]  dx, dy, dz, offset of the point to the vehicle [m]
+  * @param[in]  res, histogram resolution, multiple of the table resolution
+  * @param[out] e_index, elevation bin index
+  * @param[out] z_index, azimuth bin index
+  * @returns    false if the point is outside of the table or in a voxel
+  *             overlapping a bin border
+  **/
+  inline bool lookup(float dx, float dy, float dz, int res, int& e_index,
+                     int& z_index) const {
+    const float x = (dx + radius_) * inverse_voxel_size_;
+    const float y = (dy + radius_) * inverse_voxel_size_;
+    const float z = (dz + radius_) * inverse_voxel_size_;
+    // the negated comparisons also reject NaN
+    if (!(x >= 0.f && x < n_voxels_ && y >= 0.f && y < n_voxels_ &&
+          z >= 0.f && z < n_voxels_)) {
+      return false;
+    }
+    const size_t n = static_cast<size_t>(n_voxels_);
+    const uint16_t bin =
+        bins_[(static_cast<size_t>(x) * n + static_cast<size_t>(y)) * n +
+              static_cast<size_t>(z)];
+    if (bin == UNRESOLVED) return false;
+    const int scale = res / res_;
+    e_index = bin / (360 / res_) / scale;
+    z_index = bin % (360 / res_) / scale;
+    return true;
+  }
+
+  /**
+  * @brief     fraction of the table voxels which resolve to a single bin
+  **/
+  float resolvedFraction() const;
+
+  /**
+  * @brief     memory used by the table [bytes]
+  **/
+  size_t memoryFootprint() const { return bins_.size() * sizeof(uint16_t); }
+
+  /**
+  * @brief     memory a table would use before building it [bytes]
+  * @param[in] radius, voxel_size, parameters of the constructor [m]
+  **/
+  static size_t memoryFootprint(float radius, float voxel_size) {
+    const size_t n_voxels =
+        static_cast<size_t>(std::ceil(2.f * radius / voxel_size));
+    return n_voxels * n_voxels * n_voxels * sizeof(uint16_t);
+  }
+
+  float radius() const { return radius_; }
+  float voxelSize() const { return voxel_size_; }
+  int resolution() const { return res_; }
+};
+
+/**
+* @brief      cartesianToHistogramIndices looking up the bins in a table, the
+*             points the table cannot resolve take the exact path
+* @param[in]  table, binning table at res or a divisor of it
+**/
+void cartesianToHistogramIndices(const PolarBinningTable& table,
+                                 const float* x, const float* y,
+                                 const float* z, size_t n,
+                                 const Eigen::Vector3f& origin, int res,
+                                 int* e_index, int* z_index, float* range);
+
+/**
+* @brief      name of the instruction set used by cartesianToHistogramIndices
+* @returns    "avx2", "sse2" or "scalar"
+**/
+const char* polarBinningInstructionSet();
+}
+
+#endif  // POLAR_BINNING_H
@@ -0,0 +1,62 @@
+#ifndef POSE_BUFFER_H
+#define POSE_BUFFER_H
+
+#include <Eigen/Dense>
+#include <Eigen/StdDeque>
+
+#include <deque>
+#include <mutex>
+
+namespace avoidance {
+
+/**
+* @brief thread safe history of the vehicle pose, which is interpolated at
+*        the timestamp of sensor data instead of pairing the data with the
+*        newest pose
+**/
+class PoseBuffer {
+  struct Sample {
+    double time;
+    Eigen::Vector3f position;
+    Eigen::Quaternionf orientation;
+  };
+
+  double history_s_;
+  double max_extrapolation_s_;
+  std::deque<Sample, Eigen::aligned_allocator<Sample>> samples_;
+  mutable std::mutex mutex_;
+
+ public:
+  /**
+  * @param[in] history_s, poses older than this compared to the newest pose
+  *            are dropped [s]
+  * @param[in] max_extrapolation_s, queries up to this much newer than the
+  *            newest pose return the newest pose [s]
+  **/
+  PoseBuffer(double history_s = 2.0, double max_extrapolation_s = 0.05);
+  ~PoseBuffer() = default;
+
+  /**
+  * @brief     adds a pose, poses older than the newest one are ignored
+  * @param[in] time, timestamp of the pose [s]
+  * @param[in] position, orientation, vehicle pose
+  **/
+  void insert(double time, const Eigen::Vector3f& position,
+              const Eigen::Quaternionf& orientation);
+
+  /**
+  * @brief      interpolates the pose at a timestamp
+  * @param[in]  time, timestamp of the query [s]
+  * @param[out] pose, transform from the vehicle frame to the pose frame
+  * @returns    false if the timestamp is not covered by the history
+  **/
+  bool get(double time, Eigen::Affine3f& pose) const;
+
+  /**
+  * @brief     getter method for the number of buffered poses
+  **/
+  size_t size() const;
+};
+}
+
+#endif  // POSE_BUFFER_H
@@ -0,0 +1,34 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <ros/time.h>
+
+namespace avoidance {
+
+/**
+* @brief limits how often a group of visualization topics is published
+**/
+class RateLimiter {
+  ros::Time last_publish_time_;
+
+ public:
+  /**
+  * @brief     checks whether the group can be published and restarts the
+  *            period if so, time going back (e.g. a restarted simulation)
+  *            always allows it
+  * @param[in] now, current time
+  * @param[in] min_period_s, minimum time between two publications [s]
+  * @returns   true if the group can be published
+  **/
+  bool tryPublish(const ros::Time& now, double min_period_s) {
+    if (now >= last_publish_time_ &&
+        (now - last_publish_time_).toSec() < min_period_s) {
+      return false;
+    }
+    last_publish_time_ = now;
+    return true;
+  }
+};
+}
+
+#endif  // RATE_LIMITER_H
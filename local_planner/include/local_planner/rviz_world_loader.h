@@ -4,12 +4,16 @@
 #include <geometry_msgs/PoseStamped.h>
 #include <ros/ros.h>
 #include <Eigen/Core>
+#include <atomic>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
 #include "yaml-cpp/yaml.h"
 
+#include "local_planner/rate_limiter.h"
+
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
 
@@ -36,13 +40,19 @@ void operator>>(const YAML::Node& node, world_object& item);
 class WorldVisualizer {
  private:
   /**
-  * @brief      helper function to resolve gazebo model path
+  * @brief      helper function to resolve gazebo model path, found models
+  *             are cached since the model path is searched on the filesystem
   **/
   int resolveUri(std::string& uri);
 
   ros::Publisher world_pub_;
   ros::Publisher drone_pub_;
 
+  // resolved model uris, models which were not found are searched again
+  std::map<std::string, std::string> resolved_uris_;
+  std::atomic<double> min_drone_period_s_{0.0};
+  RateLimiter drone_limiter_;
+
  public:
   WorldVisualizer();
 
@@ -59,7 +69,14 @@ class WorldVisualizer {
   int visualizeRVIZWorld(const std::string& world_path);
 
   /**
-  * @brief      visualize the drone mesh at the current drone position
+  * @brief      limits how often the drone marker is published
+  * @param[in]  max_rate, maximum publishing rate [Hz], 0 for no limit
+  **/
+  void setMaxRate(double max_rate);
+
+  /**
+  * @brief      visualize the drone mesh at the current drone position, only
+  *             if the marker is subscribed to and the rate limit allows it
   * @param[in]  pose, current drone pose
   **/
   int visualizeDrone(const geometry_msgs::PoseStamped& pose);
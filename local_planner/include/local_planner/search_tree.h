@@ -0,0 +1,110 @@
+#ifndef SEARCH_TREE_H
+#define SEARCH_TREE_H
+
+#include <Eigen/Core>
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace avoidance {
+
+/**
+* @brief     search tree of the star planner stored as structure of arrays,
+*            the node index addresses the same entry in all arrays and node 0
+*            is the root of the tree
+**/
+class SearchTree {
+  // hash grid over the node positions for close node queries
+  float grid_cell_size_;
+  std::unordered_map<int64_t, std::vector<int>> grid_;
+
+  /**
+  * @brief     computes the grid cell coordinate of a position component
+  * @param[in] coordinate, cartesian coordinate [m]
+  * @returns   cell coordinate
+  **/
+  inline int gridCoordinate(float coordinate) const {
+    return static_cast<int>(std::floor(coordinate / grid_cell_size_));
+  }
+
+  /**
+  * @brief     packs grid cell coordinates into a single hash key
+  * @param[in] x, y, z, cell coordinates, valid within +-2^20 cells
+  * @returns   hash key of the cell
+  **/
+  inline int64_t gridKey(int x, int y, int z) const {
+    return ((static_cast<int64_t>(x) & 0x1FFFFF) << 42) |
+           ((static_cast<int64_t>(y) & 0x1FFFFF) << 21) |
+           (static_cast<int64_t>(z) & 0x1FFFFF);
+  }
+
+ public:
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<float> z_;
+  std::vector<float> total_cost_;
+  std::vector<float> heuristic_;
+  std::vector<float> last_e_;
+  std::vector<float> last_z_;
+  std::vector<float> yaw_;
+  std::vector<int> origin_;
+  std::vector<int> depth_;
+  std::vector<uint8_t> closed_;
+
+  /**
+  * @brief     constructor
+  * @param[in] grid_cell_size, cell size of the close node hash grid, should
+  *            match the distance used in hasNodeCloserThan() [m]
+  **/
+  SearchTree(float grid_cell_size = 0.2f);
+  ~SearchTree() = default;
+
+  /**
+  * @brief     appends a new open node with zero costs and angles
+  * @param[in] from, index of the parent node
+  * @param[in] d, depth of the node in the tree
+  * @param[in] pos, node position
+  * @returns   index of the new node
+  **/
+  int addNode(int from, int d, const Eigen::Vector3f& pos);
+
+  /**
+  * @brief     checks whether any node lies closer than a distance to a
+  *            position, only the grid cells within distance are visited
+  * @param[in] pos, queried position
+  * @param[in] distance, distance threshold [m]
+  * @returns   true, if a node closer than distance exists
+  **/
+  bool hasNodeCloserThan(const Eigen::Vector3f& pos, float distance) const;
+
+  /**
+  * @brief     removes all nodes
+  **/
+  void clear();
+
+  /**
+  * @brief     reserves memory in all arrays
+  * @param[in] n_nodes, number of nodes to reserve memory for
+  **/
+  void reserve(size_t n_nodes);
+
+  /**
+  * @brief     getter method for the number of nodes
+  * @returns   number of nodes in the tree
+  **/
+  size_t size() const { return x_.size(); }
+
+  /**
+  * @brief     getter method for tree node position
+  * @param[in] node, index of the node
+  * @returns   node position in 3D cartesian coordinates
+  **/
+  inline Eigen::Vector3f getPosition(int node) const {
+    return Eigen::Vector3f(x_[node], y_[node], z_[node]);
+  }
+};
+}
+
+#endif  // SEARCH_TREE_H
@@ -0,0 +1,115 @@
+#ifndef STAGE_TIMER_H
+#define STAGE_TIMER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace avoidance {
+
+/**
+* @brief stages of the pipeline from a camera message to the published
+*        setpoint whose wall time is measured
+**/
+enum class Stage {
+  kIngest,      // conversion, transform to the world frame and prefiltering
+  kPoseLookup,  // vehicle pose at the time of the camera data
+  kProcessPointcloud,
+  kHistogram,
+  kCostMatrix,
+  kTreeBuild,
+  kWaypointGeneration,
+  kPublish,
+  kVisualization,
+  kNumStages
+};
+
+/**
+* @brief      name of a stage as shown on the diagnostics topic
+**/
+const char* stageName(Stage stage);
+
+/**
+* @brief latency percentiles of the samples recorded since the last collection
+**/
+struct stageStatistics {
+  uint64_t count = 0;
+  double p50_ms = 0.0;
+  double p95_ms = 0.0;
+  double p99_ms = 0.0;
+  double max_ms = 0.0;
+};
+
+/**
+* @brief lock-free histogram of durations with logarithmic buckets, eight per
+*        power of two from 1us to 16s, so percentiles are accurate to 9%.
+*        Any thread can record while one thread collects, every sample is
+*        counted in exactly one collection
+**/
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBuckets = 8;
+  static constexpr int kOctaves = 24;
+  static constexpr int kNumBuckets = kSubBuckets * kOctaves;
+
+  LatencyHistogram() = default;
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  /**
+  * @brief     adds a sample
+  * @param[in] duration_ns, measured duration [ns]
+  **/
+  void record(uint64_t duration_ns);
+
+  /**
+  * @brief     computes the percentiles of the samples recorded since the last
+  *            call and starts a new window
+  **/
+  stageStatistics collect();
+
+ private:
+  std::atomic<uint32_t> buckets_[kNumBuckets] = {};
+  std::atomic<uint64_t> max_ns_{0};
+
+  static int bucketIndex(uint64_t duration_ns);
+  static double bucketUpperBoundMs(int index);
+};
+
+/**
+* @brief     histograms of all stages, shared by the camera, planner and
+*            publishing threads
+**/
+LatencyHistogram& stageHistogram(Stage stage);
+
+/**
+* @brief records the wall time between its construction and destruction as a
+*        sample of one stage
+**/
+class ScopedStageTimer {
+  Stage stage_;
+  std::chrono::steady_clock::time_point start_;
+
+ public:
+  explicit ScopedStageTimer(Stage stage)
+      : stage_{stage}, start_{std::chrono::steady_clock::now()} {}
+  ~ScopedStageTimer() {
+    const auto elapsed = std::chrono::steady_clock::now() - start_;
+    stageHistogram(stage_).record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  }
+  ScopedStageTimer(const ScopedStageTimer&) = delete;
+  ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+};
+}
+
+// times the rest of the enclosing scope, build with -DDISABLE_STAGE_TIMING=ON
+// to remove all timers
+#ifdef DISABLE_STAGE_TIMING
+#define STAGE_TIMER(stage)
+#else
+#define STAGE_TIMER(stage) \
+  ::avoidance::ScopedStageTimer stage_timer_##stage(::avoidance::Stage::stage)
+#endif
+
+#endif  // STAGE_TIMER_H
@@ -4,6 +4,8 @@
 #include "box.h"
 #include "cost_parameters.h"
 #include "histogram.h"
+#include "search_tree.h"
+#include "voxel_index.h"
 
 #include <Eigen/Dense>
 
@@ -18,7 +20,6 @@
 #include <vector>
 
 namespace avoidance {
-class TreeNode;
 
 class StarPlanner {
   float h_FOV_ = 59.0f;
@@ -30,11 +31,25 @@ class StarPlanner {
   float max_path_length_ = 4.f;
   float curr_yaw_histogram_frame_deg_ = 90.f;
   float smoothing_margin_degrees_ = 30.f;
+  bool coarse_to_fine_candidates_ = false;
+  float node_histogram_radius_ = 6.f;
+  float node_clearance_ = 0.3f;
+  float min_node_distance_ = 0.2f;
 
   std::vector<int> path_node_origins_;
 
   pcl::PointCloud<pcl::PointXYZI> cloud_;
 
+  // histogram of cloud_ around position_, rebuilt lazily once per tree build
+  Histogram histogram_;
+  bool histogram_valid_ = false;
+
+  // spatial index over cloud_ for node-centred obstacle queries, rebuilt
+  // whenever a new pointcloud is set
+  VoxelIndex obstacle_index_ = VoxelIndex(1.f);
+  pcl::PointCloud<pcl::PointXYZI> node_cloud_;
+  Histogram node_histogram_;
+
   Eigen::Vector3f goal_ = Eigen::Vector3f(NAN, NAN, NAN);
   Eigen::Vector3f projected_last_wp_ = Eigen::Vector3f::Zero();
   Eigen::Vector3f position_ = Eigen::Vector3f(NAN, NAN, NAN);
@@ -55,11 +70,28 @@ class StarPlanner {
   **/
   float treeHeuristicFunction(int node_number) const;
 
+  /**
+  * @brief     getter method for the obstacle histogram of the current cycle,
+  *            generates it from the pointcloud if the cached one is outdated
+  * @returns   polar histogram of cloud_ around the vehicle position
+  **/
+  const Histogram& getHistogram();
+
+  /**
+  * @brief     generates an obstacle histogram centred on a tree node from the
+  *            points within node_histogram_radius_ of the node
+  * @param[in] node_position, position of the tree node
+  * @returns   polar histogram around the node
+  **/
+  const Histogram& getNodeHistogram(const Eigen::Vector3f& node_position);
+
  public:
   std::vector<Eigen::Vector3f> path_node_positions_;
   std::vector<int> closed_set_;
   int tree_age_;
-  std::vector<TreeNode> tree_;
+  SearchTree tree_ = SearchTree(min_node_distance_);
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
   StarPlanner();
   ~StarPlanner() = default;
@@ -86,6 +118,7 @@ class StarPlanner {
   /**
   * @brief     setter method for star_planner pointcloud
   * @param[in] cloud, processed data already cropped and combined with history
+  * @note      invalidates the cached obstacle histogram
   **/
   void setPointcloud(const pcl::PointCloud<pcl::PointXYZI>& cloud);
 
@@ -93,6 +126,7 @@ class StarPlanner {
   * @brief     setter method for vehicle position
   * @param[in] pos, vehicle current position and orientation
   * @param[in] curr_yaw, vehicle current yaw
+  * @note      invalidates the cached obstacle histogram
   **/
   void setPose(const Eigen::Vector3f& pos, float curr_yaw);
 
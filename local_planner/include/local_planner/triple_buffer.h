@@ -0,0 +1,74 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace avoidance {
+
+/**
+* @brief lock-free handoff of the latest value from one producer thread to one
+*        consumer thread. Neither side ever blocks: the producer overwrites
+*        values the consumer has not picked up yet and the consumer always
+*        gets the newest completely written value. The three values are
+*        recycled, so their storage is reused
+**/
+template <typename T>
+class TripleBuffer {
+  T buffers_[3];
+  // index of the buffer in the middle and whether it holds a value the
+  // consumer has not seen yet
+  std::atomic<uint8_t> middle_{1};
+  uint8_t back_ = 0;   // owned by the producer
+  uint8_t front_ = 2;  // owned by the consumer
+  bool has_value_ = false;
+
+  static constexpr uint8_t kFresh = 4;
+  static constexpr uint8_t kIndex = 3;
+
+ public:
+  TripleBuffer() = default;
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  /**
+  * @brief     buffer the producer fills, it holds an old value whose storage
+  *            can be reused
+  **/
+  T& writeBuffer() { return buffers_[back_]; }
+
+  /**
+  * @brief     makes the write buffer the newest value, the producer gets a
+  *            buffer the consumer is not using in exchange
+  **/
+  void publish() {
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) &
+            kIndex;
+  }
+
+  /**
+  * @brief     takes the newest published value if there is one the consumer
+  *            has not seen yet
+  * @returns   true, if the read buffer changed
+  **/
+  bool update() {
+    if (!(middle_.load(std::memory_order_relaxed) & kFresh)) return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+    has_value_ = true;
+    return true;
+  }
+
+  /**
+  * @brief     newest value taken by update(), owned by the consumer until the
+  *            next call to update()
+  **/
+  T& readBuffer() { return buffers_[front_]; }
+
+  /**
+  * @brief     whether update() took any value yet
+  **/
+  bool hasValue() const { return has_value_; }
+};
+}
+
+#endif  // TRIPLE_BUFFER_H
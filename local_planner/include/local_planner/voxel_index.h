@@ -0,0 +1,85 @@
+#ifndef VOXEL_INDEX_H
+#define VOXEL_INDEX_H
+
+#include <Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+
+namespace avoidance {
+
+class VoxelIndex {
+  float voxel_size_;
+
+  // points sorted by voxel, each voxel maps to a [begin, end) range in points_
+  pcl::PointCloud<pcl::PointXYZI> points_;
+  std::unordered_map<int64_t, std::pair<int, int>> voxels_;
+
+  /**
+  * @brief     computes the integer voxel coordinates of a point
+  * @param[in] x, y, z, cartesian coordinates of the point
+  * @returns   voxel coordinates
+  **/
+  inline Eigen::Vector3i voxelCoordinates(float x, float y, float z) const {
+    return Eigen::Vector3i(static_cast<int>(std::floor(x / voxel_size_)),
+                           static_cast<int>(std::floor(y / voxel_size_)),
+                           static_cast<int>(std::floor(z / voxel_size_)));
+  }
+
+  /**
+  * @brief     packs voxel coordinates into a single hash key
+  * @param[in] x, y, z, voxel coordinates, valid within +-2^20 voxels
+  * @returns   hash key of the voxel
+  **/
+  inline int64_t voxelKey(int x, int y, int z) const {
+    return ((static_cast<int64_t>(x) & 0x1FFFFF) << 42) |
+           ((static_cast<int64_t>(y) & 0x1FFFFF) << 21) |
+           (static_cast<int64_t>(z) & 0x1FFFFF);
+  }
+
+ public:
+  VoxelIndex(float voxel_size);
+  ~VoxelIndex() = default;
+
+  /**
+  * @brief     builds the index from scratch, previous content is discarded
+  * @param[in] cloud, pointcloud to be indexed
+  **/
+  void build(const pcl::PointCloud<pcl::PointXYZI>& cloud);
+
+  /**
+  * @brief      collects all indexed points within a sphere
+  * @param[in]  center, center of the sphere
+  * @param[in]  radius, radius of the sphere [m]
+  * @param[out] cloud, points inside the sphere
+  **/
+  void getPointsWithinRadius(const Eigen::Vector3f& center, float radius,
+                             pcl::PointCloud<pcl::PointXYZI>& cloud) const;
+
+  /**
+  * @brief     checks whether a straight segment keeps a minimum distance to
+  *            all indexed points. Points already closer than the clearance to
+  *            the start only have to be kept at their current distance
+  * @param[in] start, segment start point
+  * @param[in] end, segment end point
+  * @param[in] clearance, minimum distance to any point [m]
+  * @returns   true, if no point is closer than clearance to the segment and
+  *            the segment does not approach the points close to its start
+  **/
+  bool isSegmentFree(const Eigen::Vector3f& start, const Eigen::Vector3f& end,
+                     float clearance) const;
+
+  /**
+  * @brief     getter method for the number of indexed points
+  * @returns   number of indexed points
+  **/
+  size_t size() const { return points_.size(); }
+};
+}
+
+#endif  // VOXEL_INDEX_H
@@ -0,0 +1,56 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace avoidance {
+
+/**
+* @brief fixed set of threads which are started once and then run the same
+*        task with different indices, so parallel sections in the planning
+*        cycle don't pay for creating and joining threads
+**/
+class WorkerPool {
+  unsigned int n_threads_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  const std::function<void(unsigned int)>* task_ = nullptr;
+  uint64_t generation_ = 0;
+  unsigned int n_running_ = 0;
+  bool stop_ = false;
+
+  void workerLoop(unsigned int index);
+
+ public:
+  /**
+  * @param[in] n_threads, number of threads running a task including the
+  *            calling thread, n_threads - 1 threads are started
+  **/
+  explicit WorkerPool(unsigned int n_threads);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /**
+  * @brief     runs task(0) to task(size() - 1) in parallel, index 0 on the
+  *            calling thread, and returns when all of them are done. Only one
+  *            thread at a time may call it
+  * @param[in] task, function of the thread index
+  **/
+  void run(const std::function<void(unsigned int)>& task);
+
+  /**
+  * @brief     getter method for the number of threads running a task
+  **/
+  unsigned int size() const { return n_threads_; }
+};
+}
+
+#endif  // WORKER_POOL_H
@@ -0,0 +1,219 @@
+#include "local_planner/layered_depth_memory.h"
+
+#include "local_planner/common.h"
+#include "local_planner/polar_binning.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace avoidance {
+
+namespace {
+const int RES = ALPHA_RES / 2;
+const int N_CELLS = LayeredDepthMemory::Grid::e_dim *
+                    LayeredDepthMemory::Grid::z_dim;
+
+// inserts an item into a cell of n_slots items sorted by ascending range
+template <typename T, typename RangeOf>
+void insertSorted(T* slots, uint8_t& count, int n_slots, const T& item,
+                  RangeOf range_of) {
+  int i = count;
+  if (count < n_slots) {
+    count++;
+  } else if (range_of(item) < range_of(slots[n_slots - 1])) {
+    i = n_slots - 1;
+  } else {
+    return;
+  }
+  while (i > 0 && range_of(item) < range_of(slots[i - 1])) {
+    slots[i] = slots[i - 1];
+    i--;
+  }
+  slots[i] = item;
+}
+
+inline uint16_t layerRange(const LayeredDepthMemory::Layer& layer) {
+  return layer.range_mm;
+}
+
+template <typename T>
+inline float candidateRange(const T& candidate) {
+  return candidate.range;
+}
+
+// age of a layer in hundredths of a second, the stamps wrap around
+inline uint16_t layerAgeCs(uint16_t now_cs,
+                           const LayeredDepthMemory::Layer& layer) {
+  return static_cast<uint16_t>(now_cs - layer.stamp_cs);
+}
+
+// position of an angle inside its cell in 1/256 of a cell
+inline uint8_t cellOffset(float angle, float cell_begin) {
+  const float offset = (angle - cell_begin) / RES * 256.f;
+  return static_cast<uint8_t>(std::min(255.f, std::max(0.f, offset)));
+}
+}
+
+LayeredDepthMemory::LayeredDepthMemory(int n_layers)
+    : n_layers_{std::max(1, std::min(255, n_layers))},
+      position_{Eigen::Vector3f::Zero()} {
+  layers_.resize(N_CELLS * n_layers_);
+  counts_.assign(N_CELLS, 0);
+  next_layers_.resize(N_CELLS * n_layers_);
+  next_counts_.assign(N_CELLS, 0);
+  candidates_.resize(N_CELLS * n_layers_);
+  candidate_counts_.assign(N_CELLS, 0);
+}
+
+void LayeredDepthMemory::insertNearest(std::vector<Layer>& layers,
+                                       std::vector<uint8_t>& counts, int cell,
+                                       const Layer& layer) const {
+  insertSorted(&layers[cell * n_layers_], counts[cell], n_layers_, layer,
+               layerRange);
+}
+
+void LayeredDepthMemory::encode(const Eigen::Vector3f& offset,
+                                uint16_t stamp_cs, int& cell,
+                                Layer& layer) const {
+  PolarPoint p_pol = cartesianToPolar(offset, Eigen::Vector3f::Zero());
+  Eigen::Vector2i index = polarToHistogramIndex(p_pol, RES);
+  wrapPolar(p_pol);
+  cell = index.y() * Grid::z_dim + index.x();
+  layer.range_mm = static_cast<uint16_t>(
+      std::min(65535.f, std::round(p_pol.r * 1000.f)));
+  layer.stamp_cs = stamp_cs;
+  layer.e_offset = cellOffset(p_pol.e, index.y() * RES - 90.f);
+  layer.z_offset = cellOffset(p_pol.z, index.x() * RES - 180.f);
+}
+
+uint16_t LayeredDepthMemory::clockStamp() const {
+  return static_cast<uint16_t>(std::llround(time_s_ * 100.0) & 0xFFFF);
+}
+
+Eigen::Vector3f LayeredDepthMemory::decode(int cell,
+                                           const Layer& layer) const {
+  const int e = cell / Grid::z_dim;
+  const int z = cell % Grid::z_dim;
+  // the direction is restored to the middle of its 1/256 sub-cell
+  PolarPoint p_pol((e + (layer.e_offset + 0.5f) / 256.f) * RES - 90.f,
+                   (z + (layer.z_offset + 0.5f) / 256.f) * RES - 180.f,
+                   layer.range_mm / 1000.f);
+  return polarToCartesian(p_pol, Eigen::Vector3f::Zero());
+}
+
+void LayeredDepthMemory::update(
+    const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud,
+    Box histogram_box, const Eigen::Vector3f& position,
+    float min_realsense_dist, float max_age, float elapsed_s) {
+  std::fill(next_counts_.begin(), next_counts_.end(), 0);
+  time_s_ += elapsed_s;
+  const uint16_t now_cs = clockStamp();
+  // the stamps wrap after 655s, layers are dropped before they get this old
+  const float max_age_cs = std::min(max_age * 100.f, 65535.f);
+
+  // age the remembered layers and re-project them to the new position
+  if (has_position_ && elapsed_s * 100.f < max_age_cs) {
+    for (int cell = 0; cell < N_CELLS; cell++) {
+      for (int i = 0; i < counts_[cell]; i++) {
+        const Layer& layer = layers_[cell * n_layers_ + i];
+        if (layerAgeCs(now_cs, layer) >= max_age_cs) continue;
+        const Eigen::Vector3f point = position_ + decode(cell, layer);
+        const Eigen::Vector3f offset = point - position;
+        if (!histogram_box.isPointWithinBox(point.x(), point.y(),
+                                            point.z()) ||
+            offset.norm() >= histogram_box.radius_) {
+          continue;
+        }
+        int new_cell;
+        Layer moved;
+        encode(offset, layer.stamp_cs, new_cell, moved);
+        insertNearest(next_layers_, next_counts_, new_cell, moved);
+      }
+    }
+  }
+
+  // nearest points of the new data in every cell, binned in blocks
+  std::fill(candidate_counts_.begin(), candidate_counts_.end(), 0);
+  const size_t block_size = 256;
+  float x[block_size], y[block_size], z[block_size], range[block_size];
+  int e_index[block_size], z_index[block_size];
+  uint32_t index[block_size];
+  size_t n = 0;
+  auto binBlock = [&]() {
+    cartesianToHistogramIndices(x, y, z, n, position, RES, e_index, z_index,
+                                range);
+    for (size_t i = 0; i < n; i++) {
+      const int cell = e_index[i] * Grid::z_dim + z_index[i];
+      insertSorted(&candidates_[cell * n_layers_], candidate_counts_[cell],
+                   n_layers_, Candidate{range[i], index[i]},
+                   candidateRange<Candidate>);
+    }
+    n = 0;
+  };
+  const size_t n_clouds = std::min<size_t>(complete_cloud.size(), 256);
+  for (size_t c = 0; c < n_clouds; c++) {
+    const pcl::PointCloud<pcl::PointXYZ>& cloud = complete_cloud[c];
+    const size_t n_points = std::min<size_t>(cloud.points.size(), 1 << 24);
+    for (size_t p = 0; p < n_points; p++) {
+      const pcl::PointXYZ& xyz = cloud.points[p];
+      if (std::isnan(xyz.x) || std::isnan(xyz.y) || std::isnan(xyz.z)) {
+        continue;
+      }
+      if (!histogram_box.isPointWithinBox(xyz.x, xyz.y, xyz.z)) continue;
+      const float distance = (position - toEigen(xyz)).norm();
+      if (distance > min_realsense_dist && distance < histogram_box.radius_) {
+        x[n] = xyz.x;
+        y[n] = xyz.y;
+        z[n] = xyz.z;
+        index[n] = static_cast<uint32_t>(c << 24 | p);
+        if (++n == block_size) binBlock();
+      }
+    }
+  }
+  binBlock();
+
+  // the new data replaces the memory in every cell it covers
+  for (int cell = 0; cell < N_CELLS; cell++) {
+    if (candidate_counts_[cell] == 0) continue;
+    next_counts_[cell] = 0;
+    for (int i = 0; i < candidate_counts_[cell]; i++) {
+      const uint32_t index = candidates_[cell * n_layers_ + i].index;
+      const pcl::PointXYZ& xyz =
+          complete_cloud[index >> 24].points[index & 0xFFFFFF];
+      // the exact binning of encode agrees with the batch binning
+      int new_cell;
+      Layer layer;
+      encode(toEigen(xyz) - position, now_cs, new_cell, layer);
+      insertNearest(next_layers_, next_counts_, new_cell, layer);
+    }
+  }
+
+  layers_.swap(next_layers_);
+  counts_.swap(next_counts_);
+  position_ = position;
+  has_position_ = true;
+}
+
+void LayeredDepthMemory::getPoints(
+    pcl::PointCloud<pcl::PointXYZI>& cloud) const {
+  cloud.points.clear();
+  const uint16_t now_cs = clockStamp();
+  for (int cell = 0; cell < N_CELLS; cell++) {
+    for (int i = 0; i < counts_[cell]; i++) {
+      const Layer& layer = layers_[cell * n_layers_ + i];
+      cloud.points.push_back(toXYZI(position_ + decode(cell, layer),
+                                    layerAgeCs(now_cs, layer) / 100.f));
+    }
+  }
+  cloud.width = cloud.points.size();
+  cloud.height = 1;
+}
+
+size_t LayeredDepthMemory::size() const {
+  size_t n = 0;
+  for (uint8_t count : counts_) {
+    n += count;
+  }
+  return n;
+}
+}
@@ -2,8 +2,11 @@
 
 #include "local_planner/common.h"
 #include "local_planner/planner_functions.h"
+#include "local_planner/polar_binning.h"
 #include "local_planner/star_planner.h"
-#include "local_planner/tree_node.h"
+#include "local_planner/search_tree.h"
+#include "local_planner/stage_timer.h"
+#include "local_planner/worker_pool.h"
 
 #include <sensor_msgs/image_encodings.h>
 
@@ -46,6 +49,15 @@ void LocalPlanner::dynamicReconfigureSetParams(
   n_expanded_nodes_ = config.n_expanded_nodes_;
   smoothing_margin_degrees_ =
       static_cast<float>(config.smoothing_margin_degrees_);
+  // the pool keeps its threads between the cycles and is only replaced when
+  // the number of threads changes
+  if (config.pointcloud_threads_ <= 1) {
+    pointcloud_pool_.reset();
+  } else if (!pointcloud_pool_ ||
+             static_cast<int>(pointcloud_pool_->size()) !=
+                 config.pointcloud_threads_) {
+    pointcloud_pool_.reset(new WorkerPool(config.pointcloud_threads_));
+  }
 
   if (getGoal().z() != config.goal_z_param) {
     auto goal = getGoal();
@@ -87,22 +99,78 @@ void LocalPlanner::runPlanner() {
 
   histogram_box_.setBoxLimits(position_, ground_distance_);
 
-  float elapsed_since_last_processing = static_cast<float>(
-      (ros::Time::now() - last_pointcloud_process_time_).toSec());
-  processPointcloud(final_cloud_, original_cloud_vector_, histogram_box_,
-                    position_, min_realsense_dist_, max_point_age_s_,
-                    elapsed_since_last_processing);
-  last_pointcloud_process_time_ = ros::Time::now();
+  const double now_s = ros::Time::now().toSec();
+  if (layered_memory_) {
+    STAGE_TIMER(kProcessPointcloud);
+    const float elapsed_s =
+        last_layered_memory_update_s_ > 0.0
+            ? static_cast<float>(now_s - last_layered_memory_update_s_)
+            : 0.f;
+    layered_memory_->update(original_cloud_vector_, histogram_box_, position_,
+                            min_realsense_dist_, max_point_age_s_, elapsed_s);
+    layered_memory_->getPoints(final_cloud_);
+    if (!original_cloud_vector_.empty()) {
+      final_cloud_.header = original_cloud_vector_[0].header;
+    }
+    last_layered_memory_update_s_ = now_s;
+  } else {
+    STAGE_TIMER(kProcessPointcloud);
+    processPointcloud(final_cloud_, original_cloud_vector_, histogram_box_,
+                      position_, min_realsense_dist_, max_point_age_s_,
+                      obstacle_memory_, now_s, pointcloud_pool_.get(),
+                      binning_table_.get());
+  }
 
   determineStrategy();
 }
 
+std::shared_ptr<const PolarBinningTable> LocalPlanner::buildBinningTable(
+    const avoidance::LocalPlannerNodeConfig& config) const {
+  // the binning table only depends on the box radius and the voxel size
+  const float radius = static_cast<float>(config.box_radius_);
+  const float voxel_size = static_cast<float>(config.binning_table_voxel_size_);
+  if (!config.use_binning_table_ || voxel_size <= 0.f) {
+    return nullptr;
+  }
+  if (binning_table_ && binning_table_->radius() == radius &&
+      binning_table_->voxelSize() == voxel_size) {
+    return binning_table_;
+  }
+  const size_t bytes = PolarBinningTable::memoryFootprint(radius, voxel_size);
+  if (bytes > MAX_BINNING_TABLE_BYTES) {
+    ROS_WARN(
+        "Binning table of %.0f MB for a voxel size of %.3f m is above the "
+        "limit of %.0f MB, points are binned without it",
+        bytes / 1e6, voxel_size, MAX_BINNING_TABLE_BYTES / 1e6);
+    return nullptr;
+  }
+  return std::make_shared<const PolarBinningTable>(radius, voxel_size,
+                                                   ALPHA_RES / 2);
+}
+
+void LocalPlanner::setBinningTable(
+    std::shared_ptr<const PolarBinningTable> table) {
+  binning_table_ = std::move(table);
+}
+
+void LocalPlanner::setDepthMemoryLayers(int n_layers) {
+  if (n_layers > 0) {
+    layered_memory_.reset(new LayeredDepthMemory(n_layers));
+    last_layered_memory_update_s_ = 0.0;
+  } else {
+    layered_memory_.reset();
+  }
+  obstacle_memory_.clear();
+}
+
 void LocalPlanner::create2DObstacleRepresentation(const bool send_to_fcu) {
+  STAGE_TIMER(kHistogram);
   // construct histogram if it is needed
   // or if it is required by the FCU
-  Histogram new_histogram = Histogram(ALPHA_RES);
+  Histogram new_histogram;
   to_fcu_histogram_.setZero();
-  generateNewHistogram(new_histogram, final_cloud_, position_);
+  generateNewHistogram(new_histogram, final_cloud_, position_,
+                       binning_table_.get());
 
   if (send_to_fcu) {
     compressHistogramElevation(to_fcu_histogram_, new_histogram);
@@ -111,7 +179,11 @@ void LocalPlanner::create2DObstacleRepresentation(const bool send_to_fcu) {
   polar_histogram_ = new_histogram;
 
   // generate histogram image for logging
-  generateHistogramImage(polar_histogram_);
+  if (generate_histogram_image_) {
+    generateHistogramImage(polar_histogram_);
+  } else {
+    histogram_image_data_.clear();
+  }
 }
 
 void LocalPlanner::generateHistogramImage(Histogram& histogram) {
@@ -134,7 +206,9 @@ void LocalPlanner::determineStrategy() {
 
   // clear cost image
   cost_image_data_.clear();
-  cost_image_data_.resize(3 * GRID_LENGTH_E * GRID_LENGTH_Z, 0);
+  if (generate_cost_image_) {
+    cost_image_data_.resize(3 * GRID_LENGTH_E * GRID_LENGTH_Z, 0);
+  }
 
   if (disable_rise_to_goal_altitude_) {
     reach_altitude_ = true;
@@ -161,10 +235,20 @@ void LocalPlanner::determineStrategy() {
     create2DObstacleRepresentation(send_obstacles_fcu_);
 
     if (!polar_histogram_.isEmpty()) {
-      getCostMatrix(polar_histogram_, goal_, position_,
-                    curr_yaw_histogram_frame_deg_, last_sent_waypoint_,
-                    cost_params_, velocity_.norm() < 0.1f,
-                    smoothing_margin_degrees_, cost_matrix_, cost_image_data_);
+      if (generate_cost_image_) {
+        STAGE_TIMER(kCostMatrix);
+        getCostMatrix(polar_histogram_, goal_, position_,
+                      curr_yaw_histogram_frame_deg_, last_sent_waypoint_,
+                      cost_params_, velocity_.norm() < 0.1f,
+                      smoothing_margin_degrees_, cost_matrix_,
+                      cost_image_data_);
+      } else {
+        STAGE_TIMER(kCostMatrix);
+        getCostMatrix(polar_histogram_, goal_, position_,
+                      curr_yaw_histogram_frame_deg_, last_sent_waypoint_,
+                      cost_params_, velocity_.norm() < 0.1f,
+                      smoothing_margin_degrees_, cost_matrix_);
+      }
 
       star_planner_->setParams(cost_params_);
       star_planner_->setFOV(h_FOV_, v_FOV_);
@@ -318,7 +402,7 @@ void LocalPlanner::setDefaultPx4Parameters() {
 }
 
 void LocalPlanner::getTree(
-    std::vector<TreeNode>& tree, std::vector<int>& closed_set,
+    SearchTree& tree, std::vector<int>& closed_set,
     std::vector<Eigen::Vector3f>& path_node_positions) const {
   tree = star_planner_->tree_;
   closed_set = star_planner_->closed_set_;
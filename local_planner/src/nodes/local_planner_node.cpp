@@ -2,12 +2,17 @@
 
 #include "local_planner/local_planner.h"
 #include "local_planner/planner_functions.h"
-#include "local_planner/tree_node.h"
 #include "local_planner/waypoint_generator.h"
 
 #include <boost/algorithm/string.hpp>
 
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <string>
@@ -70,6 +75,10 @@ LocalPlannerNode::LocalPlannerNode(const ros::NodeHandle& nh,
           "/mavros/companion_process/status", 1);
   get_px4_param_client_ =
       nh_.serviceClient<mavros_msgs::ParamGet>("/mavros/param/get");
+#ifndef DISABLE_STAGE_TIMING
+  stage_timings_pub_ =
+      nh_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+#endif
 
   // initialize visualization topics
   visualizer_.initializePublishers(nh_);
@@ -95,17 +104,27 @@ void LocalPlannerNode::readParams() {
   nh_.param<bool>("disable_rise_to_goal_altitude",
                   disable_rise_to_goal_altitude_, false);
   nh_.param<bool>("accept_goal_input_topic", accept_goal_input_topic_, false);
+  int depth_memory_layers;
+  nh_.param<int>("depth_memory_layers", depth_memory_layers, 0);
+  local_planner_->setDepthMemoryLayers(depth_memory_layers);
 
-  std::vector<std::string> camera_topics;
+  std::vector<std::string> camera_topics, depth_image_topics;
   nh_.getParam("pointcloud_topics", camera_topics);
-  initializeCameraSubscribers(camera_topics);
+  nh_.getParam("depth_image_topics", depth_image_topics);
+  initializeCameraSubscribers(camera_topics, depth_image_topics);
 
   nh_.param<std::string>("world_name", world_path_, "");
+  nh_.param<std::string>("body_frame", body_frame_, "fcu");
   goal_msg_.pose.position = goal;
 }
 
 void LocalPlannerNode::initializeCameraSubscribers(
-    std::vector<std::string>& camera_topics) {
+    std::vector<std::string>& camera_topics,
+    std::vector<std::string>& depth_image_topics) {
+  // the depth image cameras follow the pointcloud cameras
+  const size_t n_pointcloud_topics = camera_topics.size();
+  camera_topics.insert(camera_topics.end(), depth_image_topics.begin(),
+                       depth_image_topics.end());
   cameras_.resize(camera_topics.size());
 
   // create sting containing the topic with the camera info from
@@ -115,15 +134,25 @@ void LocalPlannerNode::initializeCameraSubscribers(
   std::vector<std::string> camera_info(camera_topics.size(), s);
 
   for (size_t i = 0; i < camera_topics.size(); i++) {
-    cameras_[i].trans_ready_mutex_.reset(new std::mutex);
-    cameras_[i].trans_ready_cv_.reset(new std::condition_variable);
+    cameras_[i].cloud_buffer_.reset(
+        new TripleBuffer<pcl::PointCloud<pcl::PointXYZ>>);
     cameras_[i].cloud_ready_mutex_.reset(new std::mutex);
     cameras_[i].cloud_ready_cv_.reset(new std::condition_variable);
-    cameras_[i].transformed_ = false;
-
-    cameras_[i].pointcloud_sub_ = nh_.subscribe<sensor_msgs::PointCloud2>(
-        camera_topics[i], 1,
-        boost::bind(&LocalPlannerNode::pointCloudCallback, this, _1, i));
+    cameras_[i].fresh_ = false;
+    cameras_[i].has_extrinsics_ = false;
+
+    if (i < n_pointcloud_topics) {
+      cameras_[i].pointcloud_sub_ = nh_.subscribe<sensor_msgs::PointCloud2>(
+          camera_topics[i], 1,
+          boost::bind(&LocalPlannerNode::pointCloudCallback, this, _1, i));
+    } else {
+      cameras_[i].depth_image_sub_ = nh_.subscribe<sensor_msgs::Image>(
+          camera_topics[i], 1,
+          boost::bind(&LocalPlannerNode::depthImageCallback, this, _1, i));
+    }
+    cameras_[i].prefilter_counts_pub_ =
+        nh_.advertise<std_msgs::UInt32MultiArray>(
+            camera_topics[i] + "/prefilter_counts", 1);
     cameras_[i].topic_ = camera_topics[i];
     cameras_[i].received_ = false;
 
@@ -144,6 +173,16 @@ void LocalPlannerNode::initializeCameraSubscribers(
   }
 }
 
+void LocalPlannerNode::unsubscribeCameraInfo() {
+  for (size_t i = 0; i < cameras_.size(); ++i) {
+    if (!cameras_[i].camera_info_sub_) continue;
+    std::lock_guard<std::mutex> lck(*(cameras_[i].cloud_ready_mutex_));
+    if (cameras_[i].camera_info_) {
+      cameras_[i].camera_info_sub_.shutdown();
+    }
+  }
+}
+
 size_t LocalPlannerNode::numReceivedClouds() {
   size_t num_received_clouds = 0;
   for (size_t i = 0; i < cameras_.size(); i++) {
@@ -153,61 +192,104 @@ size_t LocalPlannerNode::numReceivedClouds() {
 }
 
 size_t LocalPlannerNode::numTransformedClouds() {
+  const auto start = std::chrono::steady_clock::now();
   size_t num_transformed_clouds = 0;
   for (size_t i = 0; i < cameras_.size(); i++) {
-    std::unique_lock<std::mutex> lk(*(cameras_[i].trans_ready_mutex_));
-    cameras_[i].trans_ready_cv_->wait_for(
-        lk, std::chrono::milliseconds(30),
-        [this, i] { return cameras_[i].transformed_; });
-    if (cameras_[i].transformed_) num_transformed_clouds++;
+    if (cameras_[i].cloud_buffer_->update()) cameras_[i].fresh_ = true;
+    if (cameras_[i].fresh_) num_transformed_clouds++;
+  }
+
+  // time the main loop spends on the handoff, it used to block here for up
+  // to 30ms per camera
+  const double handoff_ms = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+  handoff_ms_sum_ += handoff_ms;
+  handoff_ms_max_ = std::max(handoff_ms_max_, handoff_ms);
+  handoff_count_++;
+  if (ros::WallTime::now() - handoff_report_time_ > ros::WallDuration(5.0)) {
+    ROS_DEBUG("[OA] Cloud handoff: mean %.4f ms, max %.4f ms over %zu calls",
+              handoff_ms_sum_ / handoff_count_, handoff_ms_max_,
+              handoff_count_);
+    handoff_ms_sum_ = 0.0;
+    handoff_ms_max_ = 0.0;
+    handoff_count_ = 0;
+    handoff_report_time_ = ros::WallTime::now();
   }
   return num_transformed_clouds;
 }
 
 void LocalPlannerNode::updatePlanner() {
-  if (cameras_.size() == numReceivedClouds() && cameras_.size() != 0) {
-    if (cameras_.size() == numTransformedClouds()) {
-      if (running_mutex_.try_lock()) {
-        updatePlannerInfo();
-        // reset all clouds to not yet received
-        for (size_t i = 0; i < cameras_.size(); i++) {
-          cameras_[i].received_ = false;
-        }
-        wp_generator_->setPlannerInfo(local_planner_->getAvoidanceOutput());
-        running_mutex_.unlock();
-        // Wake up the planner
-        std::unique_lock<std::mutex> lck(data_ready_mutex_);
-        data_ready_ = true;
-        data_ready_cv_.notify_one();
+  if (cameras_.empty()) return;
+  const size_t num_transformed_clouds = numTransformedClouds();
+  // either every camera has to deliver a new cloud, or with a staleness limit
+  // any new cloud triggers a planning cycle with the recent clouds of all
+  // other cameras
+  const bool ready =
+      max_cloud_staleness_s_ > 0.f
+          ? num_transformed_clouds > 0
+          : cameras_.size() == numReceivedClouds() &&
+                cameras_.size() == num_transformed_clouds;
+  if (ready) {
+    if (running_mutex_.try_lock()) {
+      updatePlannerInfo();
+      // reset all clouds to not yet received
+      for (size_t i = 0; i < cameras_.size(); i++) {
+        cameras_[i].received_ = false;
       }
+      wp_generator_->setPlannerInfo(local_planner_->getAvoidanceOutput());
+      running_mutex_.unlock();
+      // Wake up the planner
+      std::unique_lock<std::mutex> lck(data_ready_mutex_);
+      data_ready_ = true;
+      data_ready_cv_.notify_one();
     }
   }
 }
 
 bool LocalPlannerNode::canUpdatePlannerInfo() {
-  // Check if we have a transformation available at the time of the current
-  // point cloud
+  // Check if the camera extrinsics are known and vehicle poses are available
+  // to transform the point clouds
   size_t missing_transforms = 0;
   for (size_t i = 0; i < cameras_.size(); ++i) {
-    if (!tf_listener_->canTransform(
-            "/local_origin", cameras_[i].newest_cloud_msg_.header.frame_id,
-            ros::Time(0))) {
+    std::lock_guard<std::mutex> lk(*(cameras_[i].cloud_ready_mutex_));
+    if (!cameras_[i].has_extrinsics_) {
       missing_transforms++;
     }
   }
 
-  return missing_transforms == 0;
+  return missing_transforms == 0 && pose_buffer_.size() > 0;
 }
 void LocalPlannerNode::updatePlannerInfo() {
-  // update the point cloud
-  local_planner_->original_cloud_vector_.clear();
+  // update the point cloud, the previous clouds go back to the cameras to be
+  // refilled
+  local_planner_->original_cloud_vector_.resize(cameras_.size());
   for (size_t i = 0; i < cameras_.size(); ++i) {
-    try {
-      local_planner_->original_cloud_vector_.push_back(
-          std::move(cameras_[i].pcl_cloud));
-    } catch (tf::TransformException& ex) {
-      ROS_ERROR("Received an exception trying to transform a pointcloud: %s",
-                ex.what());
+    if (!cameras_[i].fresh_) continue;
+    std::swap(local_planner_->original_cloud_vector_[i],
+              cameras_[i].cloud_buffer_->readBuffer());
+    cameras_[i].fresh_ = false;
+  }
+
+  // cameras without a new cloud contribute their previous one unless it is
+  // older than the staleness limit
+  if (max_cloud_staleness_s_ > 0.f) {
+    const ros::Time now = ros::Time::now();
+    std::string stale_topics;
+    for (size_t i = 0; i < cameras_.size(); ++i) {
+      pcl::PointCloud<pcl::PointXYZ>& cloud =
+          local_planner_->original_cloud_vector_[i];
+      const double age_s =
+          (now - pcl_conversions::fromPCL(cloud.header.stamp)).toSec();
+      if (age_s > max_cloud_staleness_s_) {
+        if (!cloud.empty()) cloud.clear();
+        stale_topics.append(" ");
+        stale_topics.append(cameras_[i].topic_);
+      }
+    }
+    if (!stale_topics.empty()) {
+      ROS_WARN_THROTTLE(1.0, "[OA] Planning without stale clouds from:%s",
+                        stale_topics.c_str());
     }
   }
 
@@ -238,17 +320,24 @@ void LocalPlannerNode::updatePlannerInfo() {
 
   // update last sent waypoint
   local_planner_->last_sent_waypoint_ = toEigen(newest_waypoint_position_);
+
+  // only generate the debug images if someone is listening
+  local_planner_->generate_histogram_image_ =
+      visualizer_.hasHistogramImageSubscribers();
+  local_planner_->generate_cost_image_ = visualizer_.hasCostImageSubscribers();
 }
 
 void LocalPlannerNode::positionCallback(const geometry_msgs::PoseStamped& msg) {
   last_pose_ = newest_pose_;
   newest_pose_ = msg;
   position_received_ = true;
+  pose_buffer_.insert(msg.header.stamp.toSec(), toEigen(msg.pose.position),
+                      toEigen(msg.pose.orientation));
 
 #ifndef DISABLE_SIMULATION
   // visualize drone in RVIZ
   if (!world_path_.empty()) {
-    if (!world_visualizer_.visualizeDrone(msg)) {
+    if (world_visualizer_.visualizeDrone(msg)) {
       ROS_WARN("failed to visualize RViz dron marker");
     }
   }
@@ -283,11 +372,17 @@ void LocalPlannerNode::stateCallback(const mavros_msgs::State& msg) {
 void LocalPlannerNode::calculateWaypoints(bool hover) {
   bool is_airborne = armed_ && (nav_state_ != NavigationState::none);
 
-  wp_generator_->updateState(
-      toEigen(newest_pose_.pose.position),
-      toEigen(newest_pose_.pose.orientation), toEigen(goal_msg_.pose.position),
-      toEigen(vel_msg_.twist.linear), hover, is_airborne);
-  waypointResult result = wp_generator_->getWaypoints();
+  waypointResult result;
+  {
+    STAGE_TIMER(kWaypointGeneration);
+    wp_generator_->updateState(
+        toEigen(newest_pose_.pose.position),
+        toEigen(newest_pose_.pose.orientation),
+        toEigen(goal_msg_.pose.position), toEigen(vel_msg_.twist.linear),
+        hover, is_airborne);
+    result = wp_generator_->getWaypoints();
+  }
+  STAGE_TIMER(kPublish);
 
   last_waypoint_position_ = newest_waypoint_position_;
   newest_waypoint_position_ = toPoint(result.smoothed_goto_position);
@@ -331,6 +426,37 @@ void LocalPlannerNode::publishSystemStatus() {
   t_status_sent_ = ros::Time::now();
 }
 
+#ifndef DISABLE_STAGE_TIMING
+void LocalPlannerNode::publishStageTimings() {
+  diagnostic_msgs::DiagnosticArray msg;
+  msg.header.stamp = ros::Time::now();
+  for (int i = 0; i < static_cast<int>(Stage::kNumStages); i++) {
+    const Stage stage = static_cast<Stage>(i);
+    // collecting restarts the window, so every message covers one period
+    const stageStatistics stats = stageHistogram(stage).collect();
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = std::string("local_planner: ") + stageName(stage);
+    status.message = "latency [ms]";
+    const std::pair<const char*, double> values[] = {
+        {"count", static_cast<double>(stats.count)},
+        {"p50", stats.p50_ms},
+        {"p95", stats.p95_ms},
+        {"p99", stats.p99_ms},
+        {"max", stats.max_ms}};
+    for (const auto& value : values) {
+      diagnostic_msgs::KeyValue key_value;
+      key_value.key = value.first;
+      key_value.value = std::to_string(value.second);
+      status.values.push_back(key_value);
+    }
+    msg.status.push_back(status);
+  }
+  stage_timings_pub_.publish(msg);
+  t_stage_timings_sent_ = msg.header.stamp;
+}
+#endif
+
 void LocalPlannerNode::clickedPointCallback(
     const geometry_msgs::PointStamped& msg) {
   printPointInfo(msg.point.x, msg.point.y, msg.point.z);
@@ -469,18 +595,31 @@ void LocalPlannerNode::printPointInfo(double x, double y, double z) {
 
 void LocalPlannerNode::pointCloudCallback(
     const sensor_msgs::PointCloud2::ConstPtr& msg, int index) {
-  cameras_[index].newest_cloud_msg_ = *msg;  // FIXME: avoid a copy
-  cameras_[index].received_ = true;
+  {
+    std::unique_lock<std::mutex> lck(*(cameras_[index].cloud_ready_mutex_));
+    cameras_[index].newest_cloud_msg_ = msg;
+    cameras_[index].received_ = true;
+    cameras_[index].cloud_ready_cv_->notify_one();
+  }
+}
 
+void LocalPlannerNode::depthImageCallback(
+    const sensor_msgs::Image::ConstPtr& msg, int index) {
   {
     std::unique_lock<std::mutex> lck(*(cameras_[index].cloud_ready_mutex_));
-    cameras_[index].transformed_ = false;
+    cameras_[index].newest_depth_msg_ = msg;
+    cameras_[index].received_ = true;
     cameras_[index].cloud_ready_cv_->notify_one();
   }
 }
 
 void LocalPlannerNode::cameraInfoCallback(
     const sensor_msgs::CameraInfo::ConstPtr& msg, int index) {
+  {
+    std::lock_guard<std::mutex> lck(*(cameras_[index].cloud_ready_mutex_));
+    cameras_[index].camera_info_ = msg;
+  }
+
   // calculate the horizontal and vertical field of view from the image size and
   // focal length:
   // h_fov = 2 * atan (image_width / (2 * focal_length_x))
@@ -565,11 +704,28 @@ void LocalPlannerNode::transformVelocityToTrajectory(
 
 void LocalPlannerNode::dynamicReconfigureCallback(
     avoidance::LocalPlannerNodeConfig& config, uint32_t level) {
+  // the planner keeps running with the old table while the new one is built
+  std::shared_ptr<const PolarBinningTable> binning_table =
+      local_planner_->buildBinningTable(config);
   std::lock_guard<std::mutex> guard(running_mutex_);
   local_planner_->dynamicReconfigureSetParams(config, level);
+  local_planner_->setBinningTable(std::move(binning_table));
   wp_generator_->setSmoothingSpeed(config.smoothing_speed_xy_,
                                    config.smoothing_speed_z_);
   rqt_param_config_ = config;
+
+  // the camera is mounted off the vehicle center and the vehicle moves until
+  // the cloud is processed, keep a margin around the histogram box
+  pointcloud_max_range_ = static_cast<float>(config.box_radius_) + 1.f;
+  pointcloud_stride_ = config.pointcloud_stride_;
+  angular_stride_ = config.angular_stride_;
+  prefilter_leaf_size_ = static_cast<float>(config.prefilter_leaf_size_);
+  prefilter_max_points_ = config.prefilter_max_points_;
+  max_cloud_staleness_s_ = static_cast<float>(config.max_cloud_staleness_s_);
+  visualizer_.setMaxRate(config.visualization_rate_);
+#ifndef DISABLE_SIMULATION
+  world_visualizer_.setMaxRate(config.visualization_rate_);
+#endif
 }
 
 void LocalPlannerNode::publishLaserScan() const {
@@ -591,19 +747,56 @@ void LocalPlannerNode::threadFunction() {
 
     if (should_exit_) break;
 
+    bool visualize = false;
     {
       std::lock_guard<std::mutex> guard(running_mutex_);
       never_run_ = false;
-      std::clock_t start_time = std::clock();
       local_planner_->runPlanner();
-      visualizer_.visualizePlannerData(
-          *(local_planner_.get()), newest_waypoint_position_,
-          newest_adapted_waypoint_position_, newest_pose_);
+      // only copy the output here, serializing and publishing it happens in
+      // the visualization thread
+      visualize = visualizer_.plannerDataDue();
+      if (visualize) {
+        visualizer_.getPlannerData(
+            *(local_planner_.get()), newest_waypoint_position_,
+            newest_adapted_waypoint_position_, newest_pose_,
+            visualization_buffer_.writeBuffer());
+      }
       publishLaserScan();
       last_wp_time_ = ros::Time::now();
+    }
+
+    if (!visualize) continue;
+    visualization_buffer_.publish();
+    {
+      std::lock_guard<std::mutex> lk(visualization_ready_mutex_);
+      visualization_ready_ = true;
+    }
+    visualization_ready_cv_.notify_one();
+  }
+}
+
+void LocalPlannerNode::visualizationThreadFunction() {
+  // the visualization must not take cpu time from the planner or the camera
+  // threads
+  if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10) != 0) {
+    ROS_WARN("Could not lower the priority of the visualization thread");
+  }
 
-      ROS_DEBUG("\033[0;35m[OA]Planner calculation time: %2.2f ms \n \033[0m",
-                (std::clock() - start_time) / (double)(CLOCKS_PER_SEC / 1000));
+  while (!should_exit_) {
+    {
+      std::unique_lock<std::mutex> lk(visualization_ready_mutex_);
+      visualization_ready_cv_.wait(
+          lk, [this] { return visualization_ready_ || should_exit_; });
+      visualization_ready_ = false;
+    }
+
+    if (should_exit_) break;
+
+    // planner iterations finished while publishing are skipped, only the
+    // newest one is visualized
+    if (visualization_buffer_.update()) {
+      STAGE_TIMER(kVisualization);
+      visualizer_.visualizePlannerData(visualization_buffer_.readBuffer());
     }
   }
 }
@@ -653,42 +846,104 @@ void LocalPlannerNode::checkFailsafe(ros::Duration since_last_cloud,
 }
 
 void LocalPlannerNode::pointCloudTransformThread(int index) {
+  std::minstd_rand generator(index + 1);
+  std_msgs::UInt32MultiArray prefilter_counts;
+  prefilter_counts.data.resize(2);
   while (!should_exit_) {
+    sensor_msgs::PointCloud2::ConstPtr msg;
+    sensor_msgs::Image::ConstPtr depth_msg;
+    sensor_msgs::CameraInfo::ConstPtr camera_info;
     {
       std::unique_lock<std::mutex> lk(*(cameras_[index].cloud_ready_mutex_));
       cameras_[index].cloud_ready_cv_->wait(lk);
+      msg = cameras_[index].newest_cloud_msg_;
+      depth_msg = cameras_[index].newest_depth_msg_;
+      camera_info = cameras_[index].camera_info_;
     }
 
     if (should_exit_) break;
 
-    if (tf_listener_->canTransform(
-            "/local_origin", cameras_[index].newest_cloud_msg_.header.frame_id,
-            ros::Time(0))) {
-      try {
-        pcl::PointCloud<pcl::PointXYZ> pcl_cloud;
-        // transform message to pcl type
-        pcl::fromROSMsg(cameras_[index].newest_cloud_msg_, pcl_cloud);
-
-        // remove nan padding
-        std::vector<int> dummy_index;
-        dummy_index.reserve(pcl_cloud.points.size());
-        pcl::removeNaNFromPointCloud(pcl_cloud, pcl_cloud, dummy_index);
-
-        // transform cloud to /local_origin frame
-        pcl_ros::transformPointCloud("/local_origin", pcl_cloud, pcl_cloud,
-                                     *tf_listener_);
+    if (!msg && !depth_msg) continue;
+    const std_msgs::Header& header = msg ? msg->header : depth_msg->header;
 
+    // the camera mount is rigid, its transform to the vehicle is only looked
+    // up once
+    if (!cameras_[index].has_extrinsics_ &&
+        tf_listener_->canTransform(body_frame_, header.frame_id,
+                                   ros::Time(0))) {
+      try {
+        tf::StampedTransform tf_transform;
+        tf_listener_->lookupTransform(body_frame_, header.frame_id,
+                                      ros::Time(0), tf_transform);
+        const tf::Vector3 t = tf_transform.getOrigin();
+        const tf::Quaternion q = tf_transform.getRotation();
         std::unique_lock<std::mutex> lk(*(cameras_[index].cloud_ready_mutex_));
-        cameras_[index].transformed_ = true;
-        cameras_[index].pcl_cloud = std::move(pcl_cloud);
+        cameras_[index].extrinsics_ =
+            Eigen::Translation3f(t.x(), t.y(), t.z()) *
+            Eigen::Quaternionf(q.w(), q.x(), q.y(), q.z());
+        cameras_[index].has_extrinsics_ = true;
       } catch (tf::TransformException& ex) {
-        ROS_ERROR("Received an exception trying to transform a pointcloud: %s",
+        ROS_ERROR("Received an exception looking up the camera extrinsics: %s",
                   ex.what());
       }
     }
+
+    Eigen::Affine3f vehicle_pose;
+    bool has_vehicle_pose = false;
     {
-      std::unique_lock<std::mutex> lk(*(cameras_[index].trans_ready_mutex_));
-      cameras_[index].trans_ready_cv_->notify_one();
+      STAGE_TIMER(kPoseLookup);
+      has_vehicle_pose = pose_buffer_.get(header.stamp.toSec(), vehicle_pose);
+    }
+    if (!cameras_[index].has_extrinsics_) {
+      ROS_WARN_THROTTLE(1.0, "No transform from %s to %s",
+                        header.frame_id.c_str(), body_frame_.c_str());
+    } else if (!has_vehicle_pose) {
+      ROS_WARN_THROTTLE(1.0, "No vehicle pose at the time of the cloud on %s",
+                        cameras_[index].topic_.c_str());
+    } else if (depth_msg && !camera_info) {
+      ROS_WARN_THROTTLE(1.0, "No camera info for the depth images on %s",
+                        cameras_[index].topic_.c_str());
+    } else {
+      STAGE_TIMER(kIngest);
+      // NaN removal, back-projection, transform, crop and decimation in a
+      // single pass over the message buffer
+      ingestionParameters params;
+      params.max_range = pointcloud_max_range_;
+      // neighbouring pixels of organized clouds closer than the resolution of
+      // the histogram the points are binned into carry no new information
+      const uint32_t width = msg ? msg->width : depth_msg->width;
+      const uint32_t height = msg ? msg->height : depth_msg->height;
+      if (angular_stride_ && camera_info && height > 1) {
+        setAngularStride(*camera_info, width, height, ALPHA_RES / 2.f, params);
+      }
+      params.row_stride = std::max<int>(params.row_stride, pointcloud_stride_);
+      params.column_stride =
+          std::max<int>(params.column_stride, pointcloud_stride_);
+      const Eigen::Affine3f transform =
+          vehicle_pose * Eigen::Affine3f(cameras_[index].extrinsics_);
+      // the write buffer holds an old cloud whose storage is reused
+      pcl::PointCloud<pcl::PointXYZ>& pcl_cloud =
+          cameras_[index].cloud_buffer_->writeBuffer();
+      const bool ingested =
+          msg ? ingestPointCloud(*msg, transform, params, pcl_cloud)
+              : ingestDepthImage(*depth_msg, *camera_info, transform, params,
+                                 pcl_cloud);
+      if (ingested) {
+        // thinning the cloud here runs in parallel for all cameras, before
+        // the single planner thread bins the points
+        prefilter_counts.data[0] = pcl_cloud.size();
+        voxelPrefilter(prefilter_leaf_size_, pcl_cloud);
+        randomPrefilter(prefilter_max_points_, generator, pcl_cloud);
+        prefilter_counts.data[1] = pcl_cloud.size();
+        cameras_[index].prefilter_counts_pub_.publish(prefilter_counts);
+
+        pcl_cloud.header.frame_id = "/local_origin";
+        pcl_cloud.header.stamp = pcl_conversions::toPCL(header.stamp);
+        cameras_[index].cloud_buffer_->publish();
+      } else {
+        ROS_ERROR("Unsupported pointcloud fields or depth image encoding on %s",
+                  cameras_[index].topic_.c_str());
+      }
     }
   }
 }
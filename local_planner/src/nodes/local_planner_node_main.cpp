@@ -25,6 +25,9 @@ int main(int argc, char** argv) {
 
   std::thread worker(&LocalPlannerNode::threadFunction, &Node);
 
+  std::thread worker_visualization(
+      &LocalPlannerNode::visualizationThreadFunction, &Node);
+
   std::thread worker_params(&LocalPlannerNode::checkPx4Parameters, &Node);
 
   // spin node, execute callbacks
@@ -65,10 +68,8 @@ int main(int argc, char** argv) {
       Node.calculateWaypoints(hover);
       if (!hover) Node.status_msg_.state = (int)MAV_STATE::MAV_STATE_ACTIVE;
     } else {
-      for (size_t i = 0; i < Node.cameras_.size(); ++i) {
-        // once the camera info have been set once, unsubscribe from topic
-        Node.cameras_[i].camera_info_sub_.shutdown();
-      }
+      // once the camera info have been set once, unsubscribe from topic
+      Node.unsubscribeCameraInfo();
     }
 
     Node.position_received_ = false;
@@ -76,11 +77,18 @@ int main(int argc, char** argv) {
     // publish system status
     if (now - Node.t_status_sent_ > ros::Duration(0.2))
       Node.publishSystemStatus();
+
+#ifndef DISABLE_STAGE_TIMING
+    if (now - Node.t_stage_timings_sent_ > ros::Duration(1.0))
+      Node.publishStageTimings();
+#endif
   }
 
   Node.should_exit_ = true;
   Node.data_ready_cv_.notify_all();
+  Node.visualization_ready_cv_.notify_all();
   worker.join();
+  worker_visualization.join();
   worker_params.join();
 
   for (size_t i = 0; i < Node.cameras_.size(); ++i) {
@@ -2,7 +2,7 @@
 
 #include "local_planner/common.h"
 #include "local_planner/planner_functions.h"
-#include "local_planner/tree_node.h"
+#include "local_planner/search_tree.h"
 
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
@@ -46,42 +46,116 @@ void LocalPlannerVisualization::initializePublishers(ros::NodeHandle& nh) {
   cost_image_pub_ = nh.advertise<sensor_msgs::Image>("/cost_image", 1);
 }
 
-void LocalPlannerVisualization::visualizePlannerData(
+void LocalPlannerVisualization::setMaxRate(double max_rate) {
+  min_publish_period_s_ = max_rate > 0.0 ? 1.0 / max_rate : 0.0;
+}
+
+bool LocalPlannerVisualization::rateAllows(RateLimiter& limiter) {
+  return limiter.tryPublish(ros::Time::now(), min_publish_period_s_);
+}
+
+bool LocalPlannerVisualization::plannerDataDue() {
+  const bool subscribed = local_pointcloud_pub_.getNumSubscribers() > 0 ||
+                          pointcloud_size_pub_.getNumSubscribers() > 0 ||
+                          complete_tree_pub_.getNumSubscribers() > 0 ||
+                          tree_path_pub_.getNumSubscribers() > 0 ||
+                          marker_goal_pub_.getNumSubscribers() > 0 ||
+                          bounding_box_pub_.getNumSubscribers() > 0 ||
+                          takeoff_pose_pub_.getNumSubscribers() > 0 ||
+                          initial_height_pub_.getNumSubscribers() > 0 ||
+                          histogram_image_pub_.getNumSubscribers() > 0 ||
+                          cost_image_pub_.getNumSubscribers() > 0;
+  return subscribed && rateAllows(planner_data_limiter_);
+}
+
+bool LocalPlannerVisualization::hasHistogramImageSubscribers() const {
+  return histogram_image_pub_.getNumSubscribers() > 0;
+}
+
+bool LocalPlannerVisualization::hasCostImageSubscribers() const {
+  return cost_image_pub_.getNumSubscribers() > 0;
+}
+
+void LocalPlannerVisualization::getPlannerData(
     const LocalPlanner& planner,
     const geometry_msgs::Point& newest_waypoint_position,
     const geometry_msgs::Point& newest_adapted_waypoint_position,
-    const geometry_msgs::PoseStamped& newest_pose) const {
+    const geometry_msgs::PoseStamped& newest_pose,
+    plannerVisualizationData& data) const {
+  // this runs under the planner lock, the large fields are only copied if
+  // their topics are subscribed to. Skipped fields are cleared as the buffer
+  // still holds the output of an older iteration
+  if (local_pointcloud_pub_.getNumSubscribers() > 0 ||
+      pointcloud_size_pub_.getNumSubscribers() > 0) {
+    data.pointcloud = planner.getPointcloud();
+  } else {
+    data.pointcloud.clear();
+  }
+  if (complete_tree_pub_.getNumSubscribers() > 0 ||
+      tree_path_pub_.getNumSubscribers() > 0) {
+    planner.getTree(data.tree, data.closed_set, data.path_node_positions);
+  } else {
+    data.tree.clear();
+    data.closed_set.clear();
+    data.path_node_positions.clear();
+  }
+  data.goal = planner.getGoal();
+  data.position = planner.getPosition();
+  data.box_radius = planner.histogram_box_.radius_;
+  data.box_zmin = planner.histogram_box_.zmin_;
+  data.take_off_pose = planner.take_off_pose_;
+  data.starting_height = planner.starting_height_;
+  if (hasHistogramImageSubscribers()) {
+    data.histogram_image_data = planner.histogram_image_data_;
+  } else {
+    data.histogram_image_data.clear();
+  }
+  if (hasCostImageSubscribers()) {
+    data.cost_image_data = planner.cost_image_data_;
+  } else {
+    data.cost_image_data.clear();
+  }
+  data.newest_waypoint_position = newest_waypoint_position;
+  data.newest_adapted_waypoint_position = newest_adapted_waypoint_position;
+  data.newest_pose = newest_pose;
+}
+
+void LocalPlannerVisualization::visualizePlannerData(
+    const plannerVisualizationData& data) const {
   // visualize clouds
-  local_pointcloud_pub_.publish(planner.getPointcloud());
-  pointcloud_size_pub_.publish(
-      static_cast<uint32_t>(planner.getPointcloud().size()));
+  if (local_pointcloud_pub_.getNumSubscribers() > 0) {
+    local_pointcloud_pub_.publish(data.pointcloud);
+  }
+  if (pointcloud_size_pub_.getNumSubscribers() > 0) {
+    pointcloud_size_pub_.publish(static_cast<uint32_t>(data.pointcloud.size()));
+  }
 
   // visualize tree calculation
-  std::vector<TreeNode> tree;
-  std::vector<int> closed_set;
-  std::vector<Eigen::Vector3f> path_node_positions;
-  planner.getTree(tree, closed_set, path_node_positions);
-  publishTree(tree, closed_set, path_node_positions);
+  publishTree(data.tree, data.closed_set, data.path_node_positions);
 
   // visualize goal
-  publishGoal(toPoint(planner.getGoal()));
+  publishGoal(toPoint(data.goal));
 
   // publish bounding box of pointcloud
-  publishBox(planner.getPosition(), planner.histogram_box_.radius_,
-             planner.histogram_box_.zmin_);
+  publishBox(data.position, data.box_radius, data.box_zmin);
 
   // publish data related to takeoff maneuver
-  publishReachHeight(planner.take_off_pose_, planner.starting_height_);
+  publishReachHeight(data.take_off_pose, data.starting_height);
 
   // publish histogram image
-  publishDataImages(planner.histogram_image_data_, planner.cost_image_data_,
-                    newest_waypoint_position, newest_adapted_waypoint_position,
-                    newest_pose);
+  publishDataImages(data.histogram_image_data, data.cost_image_data,
+                    data.newest_waypoint_position,
+                    data.newest_adapted_waypoint_position, data.newest_pose);
 }
 
 void LocalPlannerVisualization::publishTree(
-    const std::vector<TreeNode>& tree, const std::vector<int>& closed_set,
+    const SearchTree& tree, const std::vector<int>& closed_set,
     const std::vector<Eigen::Vector3f>& path_node_positions) const {
+  if (complete_tree_pub_.getNumSubscribers() == 0 &&
+      tree_path_pub_.getNumSubscribers() == 0) {
+    return;
+  }
+
   visualization_msgs::Marker tree_marker;
   tree_marker.header.frame_id = "local_origin";
   tree_marker.header.stamp = ros::Time::now();
@@ -111,9 +185,9 @@ void LocalPlannerVisualization::publishTree(
   tree_marker.points.reserve(closed_set.size() * 2);
   for (size_t i = 0; i < closed_set.size(); i++) {
     int node_nr = closed_set[i];
-    geometry_msgs::Point p1 = toPoint(tree[node_nr].getPosition());
-    int origin = tree[node_nr].origin_;
-    geometry_msgs::Point p2 = toPoint(tree[origin].getPosition());
+    geometry_msgs::Point p1 = toPoint(tree.getPosition(node_nr));
+    int origin = tree.origin_[node_nr];
+    geometry_msgs::Point p2 = toPoint(tree.getPosition(origin));
     tree_marker.points.push_back(p1);
     tree_marker.points.push_back(p2);
   }
@@ -130,6 +204,8 @@ void LocalPlannerVisualization::publishTree(
 
 void LocalPlannerVisualization::publishGoal(
     const geometry_msgs::Point& goal) const {
+  if (marker_goal_pub_.getNumSubscribers() == 0) return;
+
   visualization_msgs::MarkerArray marker_goal;
   visualization_msgs::Marker m;
 
@@ -154,6 +230,8 @@ void LocalPlannerVisualization::publishGoal(
 void LocalPlannerVisualization::publishBox(const Eigen::Vector3f& drone_pos,
                                            float box_radius,
                                            float plane_height) const {
+  if (bounding_box_pub_.getNumSubscribers() == 0) return;
+
   visualization_msgs::MarkerArray marker_array;
 
   visualization_msgs::Marker box;
@@ -202,6 +280,11 @@ void LocalPlannerVisualization::publishBox(const Eigen::Vector3f& drone_pos,
 
 void LocalPlannerVisualization::publishReachHeight(
     const Eigen::Vector3f& take_off_pose, float starting_height) const {
+  if (initial_height_pub_.getNumSubscribers() == 0 &&
+      takeoff_pose_pub_.getNumSubscribers() == 0) {
+    return;
+  }
+
   visualization_msgs::Marker m;
   m.header.frame_id = "local_origin";
   m.header.stamp = ros::Time::now();
@@ -249,6 +332,8 @@ void LocalPlannerVisualization::publishDataImages(
     const geometry_msgs::Point& newest_waypoint_position,
     const geometry_msgs::Point& newest_adapted_waypoint_position,
     const geometry_msgs::PoseStamped& newest_pose) const {
+  if (histogram_image_data.empty() && cost_image_data.empty()) return;
+
   sensor_msgs::Image cost_img;
   cost_img.header.stamp = ros::Time::now();
   cost_img.height = GRID_LENGTH_E;
@@ -308,14 +393,25 @@ void LocalPlannerVisualization::publishDataImages(
   hist_img.step = 255;
   hist_img.data = histogram_image_data;
 
-  histogram_image_pub_.publish(hist_img);
-  cost_image_pub_.publish(cost_img);
+  if (!histogram_image_data.empty()) {
+    histogram_image_pub_.publish(hist_img);
+  }
+  if (!cost_image_data.empty()) {
+    cost_image_pub_.publish(cost_img);
+  }
 }
 
 void LocalPlannerVisualization::visualizeWaypoints(
     const Eigen::Vector3f& goto_position,
     const Eigen::Vector3f& adapted_goto_position,
-    const Eigen::Vector3f& smoothed_goto_position) const {
+    const Eigen::Vector3f& smoothed_goto_position) {
+  if ((original_wp_pub_.getNumSubscribers() == 0 &&
+       adapted_wp_pub_.getNumSubscribers() == 0 &&
+       smoothed_wp_pub_.getNumSubscribers() == 0) ||
+      !rateAllows(waypoints_limiter_)) {
+    return;
+  }
+
   visualization_msgs::Marker sphere1;
   visualization_msgs::Marker sphere2;
   visualization_msgs::Marker sphere3;
@@ -387,6 +483,23 @@ void LocalPlannerVisualization::publishPaths(
     const geometry_msgs::Point& newest_wp,
     const geometry_msgs::Point& last_adapted_wp,
     const geometry_msgs::Point& newest_adapted_wp) {
+  if (path_actual_pub_.getNumSubscribers() == 0 &&
+      path_waypoint_pub_.getNumSubscribers() == 0 &&
+      path_adapted_waypoint_pub_.getNumSubscribers() == 0) {
+    path_segment_pending_ = false;
+    return;
+  }
+  // skipped segments are merged into the next published one so the paths
+  // stay continuous
+  if (!path_segment_pending_) {
+    path_start_pos_ = last_pos;
+    path_start_wp_ = last_wp;
+    path_start_adapted_wp_ = last_adapted_wp;
+    path_segment_pending_ = true;
+  }
+  if (!rateAllows(paths_limiter_)) return;
+  path_segment_pending_ = false;
+
   // publish actual path
   visualization_msgs::Marker path_actual_marker;
   path_actual_marker.header.frame_id = "local_origin";
@@ -401,7 +514,7 @@ void LocalPlannerVisualization::publishPaths(
   path_actual_marker.color.g = 1.0;
   path_actual_marker.color.b = 0.0;
 
-  path_actual_marker.points.push_back(last_pos);
+  path_actual_marker.points.push_back(path_start_pos_);
   path_actual_marker.points.push_back(newest_pos);
   path_actual_pub_.publish(path_actual_marker);
 
@@ -419,7 +532,7 @@ void LocalPlannerVisualization::publishPaths(
   path_waypoint_marker.color.g = 0.0;
   path_waypoint_marker.color.b = 0.0;
 
-  path_waypoint_marker.points.push_back(last_wp);
+  path_waypoint_marker.points.push_back(path_start_wp_);
   path_waypoint_marker.points.push_back(newest_wp);
   path_waypoint_pub_.publish(path_waypoint_marker);
 
@@ -437,7 +550,7 @@ void LocalPlannerVisualization::publishPaths(
   path_adapted_waypoint_marker.color.g = 0.0;
   path_adapted_waypoint_marker.color.b = 1.0;
 
-  path_adapted_waypoint_marker.points.push_back(last_adapted_wp);
+  path_adapted_waypoint_marker.points.push_back(path_start_adapted_wp_);
   path_adapted_waypoint_marker.points.push_back(newest_adapted_wp);
   path_adapted_waypoint_pub_.publish(path_adapted_waypoint_marker);
 
@@ -446,7 +559,12 @@ void LocalPlannerVisualization::publishPaths(
 
 void LocalPlannerVisualization::publishCurrentSetpoint(
     const geometry_msgs::Twist& wp, const waypoint_choice& waypoint_type,
-    const geometry_msgs::Point& newest_pos) const {
+    const geometry_msgs::Point& newest_pos) {
+  if (current_waypoint_pub_.getNumSubscribers() == 0 ||
+      !rateAllows(setpoint_limiter_)) {
+    return;
+  }
+
   visualization_msgs::Marker setpoint;
   setpoint.header.frame_id = "local_origin";
   setpoint.header.stamp = ros::Time::now();
@@ -497,7 +615,12 @@ void LocalPlannerVisualization::publishCurrentSetpoint(
 
 void LocalPlannerVisualization::publishGround(const Eigen::Vector3f& drone_pos,
                                               float box_radius,
-                                              float ground_distance) const {
+                                              float ground_distance) {
+  if (ground_measurement_pub_.getNumSubscribers() == 0 ||
+      !rateAllows(ground_limiter_)) {
+    return;
+  }
+
   visualization_msgs::Marker plane;
 
   plane.header.frame_id = "local_origin";
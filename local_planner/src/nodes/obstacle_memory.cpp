@@ -0,0 +1,133 @@
+#include "local_planner/obstacle_memory.h"
+
+#include "local_planner/common.h"
+
+#include <algorithm>
+
+namespace avoidance {
+
+ObstacleMemory::ObstacleMemory(float voxel_size, int block_voxels)
+    : voxel_size_{voxel_size}, block_voxels_{block_voxels} {}
+
+void ObstacleMemory::insert(const pcl::PointCloud<pcl::PointXYZI>& cloud,
+                            double timestamp) {
+  // consecutive points mostly share a block, so the last one is cached
+  int64_t cached_key = 0;
+  Block* cached_block = nullptr;
+  for (const pcl::PointXYZI& p : cloud) {
+    if (std::isnan(p.x) || std::isnan(p.y) || std::isnan(p.z)) continue;
+    int offset_x, offset_y, offset_z;
+    int block_x = blockCoordinate(voxelCoordinate(p.x), offset_x);
+    int block_y = blockCoordinate(voxelCoordinate(p.y), offset_y);
+    int block_z = blockCoordinate(voxelCoordinate(p.z), offset_z);
+    int64_t key = blockKey(block_x, block_y, block_z);
+    if (cached_block == nullptr || key != cached_key) {
+      // pointers to unordered_map elements stay valid when it grows
+      cached_block = &blocks_[key];
+      cached_key = key;
+    }
+
+    cached_block->last_seen = std::max(cached_block->last_seen, timestamp);
+    int voxel_key = (offset_x * block_voxels_ + offset_y) * block_voxels_ +
+                    offset_z;
+    auto inserted = cached_block->voxels.insert(
+        std::make_pair(voxel_key, Voxel{p.x, p.y, p.z, timestamp}));
+    if (inserted.second) {
+      n_voxels_++;
+    } else {
+      inserted.first->second = Voxel{p.x, p.y, p.z, timestamp};
+    }
+  }
+}
+
+void ObstacleMemory::getPoints(const Eigen::Vector3f& lower,
+                               const Eigen::Vector3f& upper, double timestamp,
+                               float max_age,
+                               pcl::PointCloud<pcl::PointXYZI>& cloud) {
+  cloud.points.clear();
+  int offset;
+  const int min_x = blockCoordinate(voxelCoordinate(lower.x()), offset);
+  const int min_y = blockCoordinate(voxelCoordinate(lower.y()), offset);
+  const int min_z = blockCoordinate(voxelCoordinate(lower.z()), offset);
+  const int max_x = blockCoordinate(voxelCoordinate(upper.x()), offset);
+  const int max_y = blockCoordinate(voxelCoordinate(upper.y()), offset);
+  const int max_z = blockCoordinate(voxelCoordinate(upper.z()), offset);
+
+  for (int x = min_x; x <= max_x; x++) {
+    for (int y = min_y; y <= max_y; y++) {
+      for (int z = min_z; z <= max_z; z++) {
+        auto block = blocks_.find(blockKey(x, y, z));
+        if (block == blocks_.end()) continue;
+
+        // whole blocks expire without looking at their voxels
+        if (timestamp - block->second.last_seen >= max_age) {
+          n_voxels_ -= block->second.voxels.size();
+          blocks_.erase(block);
+          continue;
+        }
+
+        auto& voxels = block->second.voxels;
+        for (auto voxel = voxels.begin(); voxel != voxels.end();) {
+          const Voxel& v = voxel->second;
+          const double age = timestamp - v.last_seen;
+          if (age >= max_age) {
+            voxel = voxels.erase(voxel);
+            n_voxels_--;
+            continue;
+          }
+          if (v.x >= lower.x() && v.x <= upper.x() && v.y >= lower.y() &&
+              v.y <= upper.y() && v.z >= lower.z() && v.z <= upper.z()) {
+            cloud.points.push_back(
+                toXYZI(v.x, v.y, v.z, static_cast<float>(age)));
+          }
+          ++voxel;
+        }
+      }
+    }
+  }
+  cloud.width = cloud.points.size();
+  cloud.height = 1;
+
+  sweepExpiredBlocks(timestamp, max_age);
+}
+
+void ObstacleMemory::sweepExpiredBlocks(double timestamp, float max_age) {
+  // erasing does not rehash, so the bucket indices stay valid while sweeping
+  const size_t n_buckets = blocks_.bucket_count();
+  const size_t n_swept = std::min(n_buckets, n_buckets / kSweepPasses + 1);
+  for (size_t i = 0; i < n_swept; i++) {
+    const size_t bucket = sweep_bucket_++ % n_buckets;
+    for (auto block = blocks_.begin(bucket); block != blocks_.end(bucket);) {
+      if (timestamp - block->second.last_seen >= max_age) {
+        n_voxels_ -= block->second.voxels.size();
+        // bucket iterators can't erase, the key is looked up again instead
+        const int64_t key = block->first;
+        ++block;
+        blocks_.erase(key);
+      } else {
+        ++block;
+      }
+    }
+  }
+  sweep_bucket_ %= n_buckets;
+}
+
+void ObstacleMemory::erase(float x, float y, float z) {
+  int offset_x, offset_y, offset_z;
+  int block_x = blockCoordinate(voxelCoordinate(x), offset_x);
+  int block_y = blockCoordinate(voxelCoordinate(y), offset_y);
+  int block_z = blockCoordinate(voxelCoordinate(z), offset_z);
+  auto block = blocks_.find(blockKey(block_x, block_y, block_z));
+  if (block == blocks_.end()) return;
+  n_voxels_ -= block->second.voxels.erase(
+      (offset_x * block_voxels_ + offset_y) * block_voxels_ + offset_z);
+  if (block->second.voxels.empty()) {
+    blocks_.erase(block);
+  }
+}
+
+void ObstacleMemory::clear() {
+  blocks_.clear();
+  n_voxels_ = 0;
+}
+}
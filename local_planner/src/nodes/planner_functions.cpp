@@ -1,69 +1,220 @@
 #include "local_planner/planner_functions.h"
 
 #include "local_planner/common.h"
+#include "local_planner/obstacle_memory.h"
+#include "local_planner/polar_binning.h"
+#include "local_planner/worker_pool.h"
 
 #include <ros/console.h>
 
+#include <algorithm>
+#include <array>
 #include <numeric>
 
 namespace avoidance {
 
+namespace {
+// structure of arrays buffer to bin blocks of points with
+// cartesianToHistogramIndices
+struct BinningBlock {
+  static const size_t capacity = 256;
+  size_t size = 0;
+  float x[capacity], y[capacity], z[capacity], range[capacity];
+  int e_index[capacity], z_index[capacity];
+
+  inline void push_back(float px, float py, float pz) {
+    x[size] = px;
+    y[size] = py;
+    z[size] = pz;
+    size++;
+  }
+  inline bool full() const { return size == capacity; }
+  inline void bin(const Eigen::Vector3f& origin, int res,
+                  const PolarBinningTable* table) {
+    if (table) {
+      cartesianToHistogramIndices(*table, x, y, z, size, origin, res, e_index,
+                                  z_index, range);
+    } else {
+      cartesianToHistogramIndices(x, y, z, size, origin, res, e_index,
+                                  z_index, range);
+    }
+  }
+};
+}
+
+// appends the points of a binned block which fall into a free cell of the
+// subsampling grid, in block order
+static void subsampleBlock(const BinningBlock& block,
+                           PolarHistogram<ALPHA_RES / 2>& grid,
+                           pcl::PointCloud<pcl::PointXYZI>& points,
+                           std::vector<int>& cells) {
+  for (size_t i = 0; i < block.size; i++) {
+    if (grid.get_dist_unchecked(block.e_index[i], block.z_index[i]) == 0) {
+      points.points.push_back(toXYZI(block.x[i], block.y[i], block.z[i], 0));
+      grid.set_dist(block.e_index[i], block.z_index[i], 1);
+      cells.push_back(block.e_index[i] * PolarHistogram<ALPHA_RES / 2>::z_dim +
+                      block.z_index[i]);
+    }
+  }
+}
+
+// crops, range-filters and subsamples the points [begin, end) of a cloud.
+// Points which fall into a free cell of the subsampling grid are appended to
+// points and mark the cell as occupied, the flattened cell indices are
+// appended to cells
+static void subsamplePoints(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                            size_t begin, size_t end, Box histogram_box,
+                            const Eigen::Vector3f& position,
+                            float min_realsense_dist,
+                            const PolarBinningTable* table,
+                            PolarHistogram<ALPHA_RES / 2>& grid,
+                            pcl::PointCloud<pcl::PointXYZI>& points,
+                            std::vector<int>& cells) {
+  BinningBlock block;
+  for (size_t i = begin; i < end; i++) {
+    const pcl::PointXYZ& xyz = cloud.points[i];
+    // Check if the point is invalid
+    if (!std::isnan(xyz.x) && !std::isnan(xyz.y) && !std::isnan(xyz.z)) {
+      if (histogram_box.isPointWithinBox(xyz.x, xyz.y, xyz.z)) {
+        float distance = (position - toEigen(xyz)).norm();
+        if (distance > min_realsense_dist &&
+            distance < histogram_box.radius_) {
+          // subsampling the cloud, the points are binned in blocks
+          block.push_back(xyz.x, xyz.y, xyz.z);
+          if (block.full()) {
+            block.bin(position, ALPHA_RES / 2, table);
+            subsampleBlock(block, grid, points, cells);
+            block.size = 0;
+          }
+        }
+      }
+    }
+  }
+  block.bin(position, ALPHA_RES / 2, table);
+  subsampleBlock(block, grid, points, cells);
+}
+
 // trim the point cloud so that only points inside the bounding box are
 // considered
 void processPointcloud(
     pcl::PointCloud<pcl::PointXYZI>& final_cloud,
     const std::vector<pcl::PointCloud<pcl::PointXYZ>>& complete_cloud,
     Box histogram_box, const Eigen::Vector3f& position,
-    float min_realsense_dist, int max_age, float elapsed_s) {
-  pcl::PointCloud<pcl::PointXYZI> old_cloud;
-  std::swap(final_cloud, old_cloud);
+    float min_realsense_dist, float max_age, ObstacleMemory& memory,
+    double timestamp, WorkerPool* pool, const PolarBinningTable* table) {
   final_cloud.points.clear();
   final_cloud.width = 0;
   final_cloud.points.reserve((2 * GRID_LENGTH_Z) * (2 * GRID_LENGTH_E));
 
-  float distance;
-
   // double resolution histogram for subsampling
   // the distance layer will show whether the cell is already
-  // occupied by a point
-  Histogram high_res_histogram = Histogram(ALPHA_RES / 2);
-
-  for (const auto& cloud : complete_cloud) {
-    for (const pcl::PointXYZ& xyz : cloud) {
-      // Check if the point is invalid
-      if (!std::isnan(xyz.x) && !std::isnan(xyz.y) && !std::isnan(xyz.z)) {
-        if (histogram_box.isPointWithinBox(xyz.x, xyz.y, xyz.z)) {
-          distance = (position - toEigen(xyz)).norm();
-          if (distance > min_realsense_dist &&
-              distance < histogram_box.radius_) {
-            // subsampling the cloud
-            PolarPoint p_pol = cartesianToPolar(toEigen(xyz), position);
-            Eigen::Vector2i p_ind = polarToHistogramIndex(p_pol, ALPHA_RES / 2);
-            if (high_res_histogram.get_dist(p_ind.y(), p_ind.x()) == 0) {
-              final_cloud.points.push_back(toXYZI(toEigen(xyz), 0));
-              high_res_histogram.set_dist(p_ind.y(), p_ind.x(), 1);
-            }
-          }
+  // occupied by a new point (1) or a remembered point (2)
+  PolarHistogram<ALPHA_RES / 2> high_res_histogram;
+
+  const unsigned int n_threads = pool ? pool->size() : 1;
+  if (n_threads <= 1) {
+    std::vector<int> cells;
+    for (const auto& cloud : complete_cloud) {
+      subsamplePoints(cloud, 0, cloud.points.size(), histogram_box, position,
+                      min_realsense_dist, table, high_res_histogram,
+                      final_cloud, cells);
+    }
+  } else {
+    // every cloud is split into n_threads chunks. The workers subsample their
+    // chunks on thread-local grids, so each chunk keeps the first point of
+    // every cell it touches
+    struct Chunk {
+      const pcl::PointCloud<pcl::PointXYZ>* cloud;
+      size_t begin;
+      size_t end;
+      pcl::PointCloud<pcl::PointXYZI> points;
+      std::vector<int> cells;
+    };
+    std::vector<Chunk, Eigen::aligned_allocator<Chunk>> chunks;
+    for (const auto& cloud : complete_cloud) {
+      const size_t n_points = cloud.points.size();
+      for (size_t i = 0; i < n_threads; i++) {
+        Chunk chunk;
+        chunk.cloud = &cloud;
+        chunk.begin = n_points * i / n_threads;
+        chunk.end = n_points * (i + 1) / n_threads;
+        chunks.push_back(chunk);
+      }
+    }
+
+    pool->run([&](unsigned int t) {
+      PolarHistogram<ALPHA_RES / 2> grid;
+      for (size_t i = t; i < chunks.size(); i += n_threads) {
+        Chunk& chunk = chunks[i];
+        subsamplePoints(*chunk.cloud, chunk.begin, chunk.end, histogram_box,
+                        position, min_realsense_dist, table, grid,
+                        chunk.points, chunk.cells);
+        for (int cell : chunk.cells) {
+          grid.set_dist(cell / PolarHistogram<ALPHA_RES / 2>::z_dim,
+                        cell % PolarHistogram<ALPHA_RES / 2>::z_dim, 0);
+        }
+      }
+    });
+
+    // merging the chunks in order keeps the globally first point of every
+    // cell, so the result is identical to the serial pass
+    for (const Chunk& chunk : chunks) {
+      for (size_t i = 0; i < chunk.cells.size(); i++) {
+        const int e = chunk.cells[i] / PolarHistogram<ALPHA_RES / 2>::z_dim;
+        const int z = chunk.cells[i] % PolarHistogram<ALPHA_RES / 2>::z_dim;
+        if (high_res_histogram.get_dist_unchecked(e, z) == 0) {
+          final_cloud.points.push_back(chunk.points.points[i]);
+          high_res_histogram.set_dist(e, z, 1);
         }
       }
     }
   }
 
-  // combine with old cloud
-  for (const pcl::PointXYZI& xyzi : old_cloud) {
-    // adding older points if not expired and space is free according to new
-    // cloud
-    if (histogram_box.isPointWithinBox(xyzi.x, xyzi.y, xyzi.z)) {
-      distance = (position - toEigen(xyzi)).norm();
-      if (distance < histogram_box.radius_) {
-        PolarPoint p_pol = cartesianToPolar(toEigen(xyzi), position);
-        Eigen::Vector2i p_ind = polarToHistogramIndex(p_pol, ALPHA_RES / 2);
-        if (high_res_histogram.get_dist(p_ind.y(), p_ind.x()) == 0 &&
-            xyzi.intensity < max_age) {
-          final_cloud.points.push_back(
-              toXYZI(toEigen(xyzi), xyzi.intensity + elapsed_s));
-          high_res_histogram.set_dist(p_ind.y(), p_ind.x(), 1);
-        }
+  // the new points refresh the memory, the remembered points inside the box
+  // are only kept where the new data leaves their cell free
+  memory.insert(final_cloud, timestamp);
+  pcl::PointCloud<pcl::PointXYZI> remembered;
+  memory.getPoints(
+      Eigen::Vector3f(position.x() - histogram_box.radius_,
+                      position.y() - histogram_box.radius_,
+                      histogram_box.zmin_),
+      position + Eigen::Vector3f::Constant(histogram_box.radius_), timestamp,
+      max_age, remembered);
+
+  pcl::PointCloud<pcl::PointXYZI> old_cloud;
+  old_cloud.points.reserve(remembered.points.size());
+  for (const pcl::PointXYZI& xyzi : remembered) {
+    // the points inserted above are already part of the new data
+    if (xyzi.intensity > 0.f &&
+        histogram_box.isPointWithinBox(xyzi.x, xyzi.y, xyzi.z) &&
+        (position - toEigen(xyzi)).norm() < histogram_box.radius_) {
+      old_cloud.points.push_back(xyzi);
+    }
+  }
+
+  BinningBlock block;
+  for (size_t begin = 0; begin < old_cloud.points.size();
+       begin += BinningBlock::capacity) {
+    block.size = 0;
+    const size_t end =
+        std::min(old_cloud.points.size(), begin + BinningBlock::capacity);
+    for (size_t i = begin; i < end; i++) {
+      const pcl::PointXYZI& xyzi = old_cloud.points[i];
+      block.push_back(xyzi.x, xyzi.y, xyzi.z);
+    }
+    block.bin(position, ALPHA_RES / 2, table);
+
+    for (size_t i = 0; i < block.size; i++) {
+      const pcl::PointXYZI& xyzi = old_cloud.points[begin + i];
+      const float cell =
+          high_res_histogram.get_dist_unchecked(block.e_index[i],
+                                                block.z_index[i]);
+      if (cell == 0) {
+        final_cloud.points.push_back(xyzi);
+        high_res_histogram.set_dist(block.e_index[i], block.z_index[i], 2);
+      } else if (cell == 1) {
+        // the new data sees something else in this direction
+        memory.erase(xyzi.x, xyzi.y, xyzi.z);
       }
     }
   }
@@ -107,29 +258,42 @@ void calculateFOV(float h_fov, float v_fov, std::vector<int>& z_FOV_idx,
 }
 
 // Generate new histogram from pointcloud
-void generateNewHistogram(Histogram& polar_histogram,
+template <int RES>
+void generateNewHistogram(PolarHistogram<RES>& polar_histogram,
                           const pcl::PointCloud<pcl::PointXYZI>& cropped_cloud,
-                          const Eigen::Vector3f& position) {
-  Eigen::MatrixXi counter(GRID_LENGTH_E, GRID_LENGTH_Z);
+                          const Eigen::Vector3f& position,
+                          const PolarBinningTable* table) {
+  Eigen::Matrix<int, PolarHistogram<RES>::e_dim, PolarHistogram<RES>::z_dim,
+                Eigen::RowMajor>
+      counter;
   counter.fill(0);
-  for (auto xyz : cropped_cloud) {
-    Eigen::Vector3f p = toEigen(xyz);
-    PolarPoint p_pol = cartesianToPolar(p, position);
-    float dist = p_pol.r;
-    Eigen::Vector2i p_ind = polarToHistogramIndex(p_pol, ALPHA_RES);
+  BinningBlock block;
+  for (size_t begin = 0; begin < cropped_cloud.points.size();
+       begin += BinningBlock::capacity) {
+    block.size = 0;
+    const size_t end = std::min(cropped_cloud.points.size(),
+                                begin + BinningBlock::capacity);
+    for (size_t i = begin; i < end; i++) {
+      const pcl::PointXYZI& xyz = cropped_cloud.points[i];
+      block.push_back(xyz.x, xyz.y, xyz.z);
+    }
+    block.bin(position, RES, table);
 
-    counter(p_ind.y(), p_ind.x()) += 1;
-    polar_histogram.set_dist(
-        p_ind.y(), p_ind.x(),
-        polar_histogram.get_dist(p_ind.y(), p_ind.x()) + dist);
+    for (size_t i = 0; i < block.size; i++) {
+      const int e = block.e_index[i];
+      const int z = block.z_index[i];
+      counter(e, z) += 1;
+      polar_histogram.set_dist(
+          e, z, polar_histogram.get_dist_unchecked(e, z) + block.range[i]);
+    }
   }
 
   // Normalize and get mean in distance bins
-  for (int e = 0; e < GRID_LENGTH_E; e++) {
-    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+  for (int e = 0; e < PolarHistogram<RES>::e_dim; e++) {
+    for (int z = 0; z < PolarHistogram<RES>::z_dim; z++) {
       if (counter(e, z) > 0) {
         polar_histogram.set_dist(
-            e, z, polar_histogram.get_dist(e, z) / counter(e, z));
+            e, z, polar_histogram.get_dist_unchecked(e, z) / counter(e, z));
       } else {
         polar_histogram.set_dist(e, z, 0.f);
       }
@@ -156,7 +320,269 @@ void compressHistogramElevation(Histogram& new_hist,
   }
 }
 
-void getCostMatrix(const Histogram& histogram, const Eigen::Vector3f& goal,
+namespace {
+// unit direction vectors of all histogram bin centres, stored row-major by
+// elevation so that the cost kernel runs over contiguous arrays
+template <int RES>
+struct CostDirectionTable {
+  static constexpr int e_dim = PolarHistogram<RES>::e_dim;
+  static constexpr int z_dim = PolarHistogram<RES>::z_dim;
+  std::array<float, e_dim * z_dim> x;
+  std::array<float, e_dim * z_dim> y;
+  std::array<float, e_dim * z_dim> z;
+  std::array<float, e_dim> cos_e;
+  std::array<int, e_dim> step_size;
+
+  CostDirectionTable() {
+    for (int e_index = 0; e_index < e_dim; e_index++) {
+      const float e_rad =
+          histogramIndexToPolar(e_index, 0, RES, 1).e * DEG_TO_RAD;
+      cos_e[e_index] = std::cos(e_rad);
+      // determine how many bins at this elevation angle would be equivalent
+      // to a single bin at horizontal
+      step_size[e_index] = static_cast<int>(std::round(1 / cos_e[e_index]));
+      for (int z_index = 0; z_index < z_dim; z_index++) {
+        const float z_rad =
+            histogramIndexToPolar(e_index, z_index, RES, 1).z * DEG_TO_RAD;
+        const int i = e_index * z_dim + z_index;
+        x[i] = cos_e[e_index] * std::sin(z_rad);
+        y[i] = cos_e[e_index] * std::cos(z_rad);
+        z[i] = std::sin(e_rad);
+      }
+    }
+  }
+};
+
+template <int RES>
+const CostDirectionTable<RES>& costDirectionTable() {
+  static const CostDirectionTable<RES> table;
+  return table;
+}
+
+// linearly interpolates the cells between the evaluated columns of a row,
+// wrapping the last interval around to column 0
+void interpolateRow(float* row, int n_cols, int step_size) {
+  int last_index = 0;
+  for (int z_index = step_size; z_index < n_cols; z_index += step_size) {
+    const float gradient = (row[z_index] - row[last_index]) / step_size;
+    for (int i = 1; i < step_size; i++) {
+      row[last_index + i] = row[last_index] + gradient * i;
+    }
+    last_index = z_index;
+  }
+
+  // special case the last columns wrapping around back to 0
+  const int clamped_z_scale = n_cols - last_index;
+  const float gradient = (row[0] - row[last_index]) / clamped_z_scale;
+  for (int i = 1; i < clamped_z_scale; i++) {
+    row[last_index + i] = row[last_index] + gradient * i;
+  }
+}
+
+// goal, smoothness and heading costs of a direction. Evaluates the same terms
+// as costFunction, with everything that does not depend on the direction
+// hoisted into the constructor
+class DirectionCost {
+  Eigen::Vector3f goal_;
+  Eigen::Vector3f position_;
+  Eigen::Vector3f projected_last_wp_;
+  float goal_dist_;
+  float heading_x_;
+  float heading_y_;
+  float goal_weight_;
+  float pitch_up_weight_;
+  float pitch_down_weight_;
+  float smooth_weight_;
+  float heading_weight_;
+
+ public:
+  DirectionCost(const Eigen::Vector3f& goal, const Eigen::Vector3f& position,
+                float yaw_angle_histogram_frame_deg,
+                const Eigen::Vector3f& last_sent_waypoint,
+                const costParameters& cost_params)
+      : goal_(goal), position_(position) {
+    // all directions are projected onto the sphere through the goal
+    goal_dist_ = (position - goal).norm();
+    PolarPoint last_wp_pol = cartesianToPolar(last_sent_waypoint, position);
+    last_wp_pol.r = goal_dist_;
+    projected_last_wp_ = polarToCartesian(last_wp_pol, position);
+    heading_x_ =
+        goal_dist_ * std::sin(yaw_angle_histogram_frame_deg * DEG_TO_RAD);
+    heading_y_ =
+        goal_dist_ * std::cos(yaw_angle_histogram_frame_deg * DEG_TO_RAD);
+    goal_weight_ = cost_params.goal_cost_param;
+    pitch_up_weight_ =
+        goal_weight_ * cost_params.height_change_cost_param_adapted;
+    pitch_down_weight_ = goal_weight_ * cost_params.height_change_cost_param;
+    smooth_weight_ = cost_params.smooth_cost_param;
+    heading_weight_ = cost_params.heading_cost_param;
+  }
+
+  // dir_x, dir_y, dir_z: unit direction, cos_e: cosine of its elevation
+  inline float operator()(float dir_x, float dir_y, float dir_z,
+                          float cos_e) const {
+    const float candidate_x = position_.x() + goal_dist_ * dir_x;
+    const float candidate_y = position_.y() + goal_dist_ * dir_y;
+    const float candidate_z = position_.z() + goal_dist_ * dir_z;
+
+    // goal costs
+    const float goal_dx = goal_.x() - candidate_x;
+    const float goal_dy = goal_.y() - candidate_y;
+    const float goal_dz = goal_.z() - candidate_z;
+    const float yaw_cost =
+        goal_weight_ * std::sqrt(goal_dx * goal_dx + goal_dy * goal_dy);
+    const float pitch_cost = goal_dz < 0.f ? -pitch_up_weight_ * goal_dz
+                                           : pitch_down_weight_ * goal_dz;
+
+    // smooth costs
+    const float wp_dx = projected_last_wp_.x() - candidate_x;
+    const float wp_dy = projected_last_wp_.y() - candidate_y;
+    const float wp_dz = projected_last_wp_.z() - candidate_z;
+    const float smooth_cost =
+        smooth_weight_ *
+        (std::sqrt(wp_dx * wp_dx + wp_dy * wp_dy) + std::abs(wp_dz));
+
+    // heading cost, the heading is projected at the elevation of the
+    // direction
+    const float heading_dx = position_.x() + cos_e * heading_x_ - candidate_x;
+    const float heading_dy = position_.y() + cos_e * heading_y_ - candidate_y;
+    const float heading_cost =
+        heading_weight_ *
+        std::sqrt(heading_dx * heading_dx + heading_dy * heading_dy);
+
+    return yaw_cost + pitch_cost + smooth_cost + heading_cost;
+  }
+};
+
+inline float obstacleDistanceCost(float obstacle_distance) {
+  return obstacle_distance > 0.f ? 700.f / obstacle_distance : 0.f;
+}
+}
+
+// fills the smoothed obstacle distance cost matrix
+template <int RES>
+static void getDistanceCostMatrix(const PolarHistogram<RES>& histogram,
+                                  unsigned int smooth_radius,
+                                  Eigen::MatrixXf& distance_matrix) {
+  const int e_dim = PolarHistogram<RES>::e_dim;
+  const int z_dim = PolarHistogram<RES>::z_dim;
+  const CostDirectionTable<RES>& table = costDirectionTable<RES>();
+  distance_matrix.resize(e_dim, z_dim);
+
+  std::array<float, z_dim> distance_costs;
+  for (int e_index = 0; e_index < e_dim; e_index++) {
+    // work in steps of the bins equivalent to a single horizontal bin
+    const int step_size = table.step_size[e_index];
+    for (int z_index = 0; z_index < z_dim; z_index += step_size) {
+      distance_costs[z_index] = obstacleDistanceCost(
+          histogram.get_dist_unchecked(e_index, z_index));
+    }
+    if (step_size > 1) {
+      // interpolate all of the un-calculated values
+      interpolateRow(distance_costs.data(), z_dim, step_size);
+    }
+    distance_matrix.row(e_index) =
+        Eigen::Map<const Eigen::RowVectorXf>(distance_costs.data(), z_dim);
+  }
+
+  smoothPolarMatrix(distance_matrix, smooth_radius);
+}
+
+// fills the goal and smoothness cost matrix
+template <int RES>
+static void getDirectionCostMatrix(const DirectionCost& direction_cost,
+                                   Eigen::MatrixXf& cost_matrix) {
+  const int e_dim = PolarHistogram<RES>::e_dim;
+  const int z_dim = PolarHistogram<RES>::z_dim;
+  const CostDirectionTable<RES>& table = costDirectionTable<RES>();
+  cost_matrix.resize(e_dim, z_dim);
+
+  std::array<float, z_dim> other_costs;
+  for (int e_index = 0; e_index < e_dim; e_index++) {
+    const int row = e_index * z_dim;
+    const int step_size = table.step_size[e_index];
+    const float cos_e = table.cos_e[e_index];
+    const float* dir_x = &table.x[row];
+    const float* dir_y = &table.y[row];
+    const float* dir_z = &table.z[row];
+
+    for (int z_index = 0; z_index < z_dim; z_index += step_size) {
+      other_costs[z_index] = direction_cost(dir_x[z_index], dir_y[z_index],
+                                            dir_z[z_index], cos_e);
+    }
+    if (step_size > 1) {
+      interpolateRow(other_costs.data(), z_dim, step_size);
+    }
+    cost_matrix.row(e_index) =
+        Eigen::Map<const Eigen::RowVectorXf>(other_costs.data(), z_dim);
+  }
+}
+
+// goal and smoothness cost of a single cell, equal to the entry
+// getDirectionCostMatrix computes for it: cells between the evaluated columns
+// of a row are interpolated like interpolateRow does
+template <int RES>
+static float getDirectionCost(const DirectionCost& direction_cost, int e_index,
+                              int z_index) {
+  const int z_dim = PolarHistogram<RES>::z_dim;
+  const CostDirectionTable<RES>& table = costDirectionTable<RES>();
+  const int row = e_index * z_dim;
+  const float cos_e = table.cos_e[e_index];
+  const auto cost = [&](int z) {
+    return direction_cost(table.x[row + z], table.y[row + z], table.z[row + z],
+                          cos_e);
+  };
+
+  const int step_size = table.step_size[e_index];
+  const int lower = (z_index / step_size) * step_size;
+  if (lower == z_index) return cost(z_index);
+  // the last interval of the row wraps around to column 0
+  const int interval = std::min(step_size, z_dim - lower);
+  const float lower_cost = cost(lower);
+  const float gradient =
+      (cost((lower + interval) % z_dim) - lower_cost) / interval;
+  return lower_cost + gradient * (z_index - lower);
+}
+
+// fills the goal and smoothness cost matrix and the smoothed obstacle distance
+// cost matrix, which are kept separate for the cost image
+template <int RES>
+static void getCostMatrices(const PolarHistogram<RES>& histogram,
+                            const Eigen::Vector3f& goal,
+                            const Eigen::Vector3f& position,
+                            const float yaw_angle_histogram_frame_deg,
+                            const Eigen::Vector3f& last_sent_waypoint,
+                            costParameters cost_params,
+                            const float smoothing_margin_degrees,
+                            Eigen::MatrixXf& cost_matrix,
+                            Eigen::MatrixXf& distance_matrix) {
+  const DirectionCost direction_cost(goal, position,
+                                     yaw_angle_histogram_frame_deg,
+                                     last_sent_waypoint, cost_params);
+  getDirectionCostMatrix<RES>(direction_cost, cost_matrix);
+  getDistanceCostMatrix(histogram, ceil(smoothing_margin_degrees / RES),
+                        distance_matrix);
+}
+
+template <int RES>
+void getCostMatrix(const PolarHistogram<RES>& histogram,
+                   const Eigen::Vector3f& goal,
+                   const Eigen::Vector3f& position,
+                   const float yaw_angle_histogram_frame_deg,
+                   const Eigen::Vector3f& last_sent_waypoint,
+                   costParameters cost_params, bool only_yawed,
+                   const float smoothing_margin_degrees,
+                   Eigen::MatrixXf& cost_matrix) {
+  Eigen::MatrixXf distance_matrix;
+  getCostMatrices(histogram, goal, position, yaw_angle_histogram_frame_deg,
+                  last_sent_waypoint, cost_params, smoothing_margin_degrees,
+                  cost_matrix, distance_matrix);
+  cost_matrix += distance_matrix;
+}
+
+template <int RES>
+void getCostMatrix(const PolarHistogram<RES>& histogram,
+                   const Eigen::Vector3f& goal,
                    const Eigen::Vector3f& position,
                    const float yaw_angle_histogram_frame_deg,
                    const Eigen::Vector3f& last_sent_waypoint,
@@ -164,76 +590,109 @@ void getCostMatrix(const Histogram& histogram, const Eigen::Vector3f& goal,
                    const float smoothing_margin_degrees,
                    Eigen::MatrixXf& cost_matrix,
                    std::vector<uint8_t>& image_data) {
-  Eigen::MatrixXf distance_matrix(GRID_LENGTH_E, GRID_LENGTH_Z);
-  distance_matrix.fill(NAN);
-  float distance_cost = 0.f;
-  float other_costs = 0.f;
-  // reset cost matrix to zero
-  cost_matrix.resize(GRID_LENGTH_E, GRID_LENGTH_Z);
-  cost_matrix.fill(NAN);
-
-  // fill in cost matrix
-  for (int e_index = 0; e_index < GRID_LENGTH_E; e_index++) {
-    // determine how many bins at this elevation angle would be equivalent to
-    // a single bin at horizontal, then work in steps of that size
-    const float bin_width = std::cos(
-        histogramIndexToPolar(e_index, 0, ALPHA_RES, 1).e * DEG_TO_RAD);
-    const int step_size = static_cast<int>(std::round(1 / bin_width));
-
-    for (int z_index = 0; z_index < GRID_LENGTH_Z; z_index += step_size) {
-      float obstacle_distance = histogram.get_dist(e_index, z_index);
-      PolarPoint p_pol =
-          histogramIndexToPolar(e_index, z_index, ALPHA_RES, obstacle_distance);
-
-      costFunction(p_pol.e, p_pol.z, obstacle_distance, goal, position,
-                   yaw_angle_histogram_frame_deg, last_sent_waypoint,
-                   cost_params, distance_cost, other_costs);
-      cost_matrix(e_index, z_index) = other_costs;
-      distance_matrix(e_index, z_index) = distance_cost;
-    }
-    if (step_size > 1) {
-      // horizontally interpolate all of the un-calculated values
-      int last_index = 0;
-      for (int z_index = step_size; z_index < GRID_LENGTH_Z;
-           z_index += step_size) {
-        float other_costs_gradient =
-            (cost_matrix(e_index, z_index) - cost_matrix(e_index, last_index)) /
-            step_size;
-        float distance_cost_gradient = (distance_matrix(e_index, z_index) -
-                                        distance_matrix(e_index, last_index)) /
-                                       step_size;
-        for (int i = 1; i < step_size; i++) {
-          cost_matrix(e_index, last_index + i) =
-              cost_matrix(e_index, last_index) + other_costs_gradient * i;
-          distance_matrix(e_index, last_index + i) =
-              distance_matrix(e_index, last_index) + distance_cost_gradient * i;
-        }
-        last_index = z_index;
-      }
+  Eigen::MatrixXf distance_matrix;
+  getCostMatrices(histogram, goal, position, yaw_angle_histogram_frame_deg,
+                  last_sent_waypoint, cost_params, smoothing_margin_degrees,
+                  cost_matrix, distance_matrix);
+  generateCostImage(cost_matrix, distance_matrix, image_data);
+  cost_matrix += distance_matrix;
+}
 
-      // special case the last columns wrapping around back to 0
-      int clamped_z_scale = GRID_LENGTH_Z - last_index;
-      float other_costs_gradient =
-          (cost_matrix(e_index, 0) - cost_matrix(e_index, last_index)) /
-          clamped_z_scale;
-      float distance_cost_gradient =
-          (distance_matrix(e_index, 0) - distance_matrix(e_index, last_index)) /
-          clamped_z_scale;
-
-      for (int i = 1; i < clamped_z_scale; i++) {
-        cost_matrix(e_index, last_index + i) =
-            cost_matrix(e_index, last_index) + other_costs_gradient * i;
-        distance_matrix(e_index, last_index + i) =
-            distance_matrix(e_index, last_index) + distance_cost_gradient * i;
+// selects the number_of_candidates lowest costs of a contiguous array. The
+// cells are returned as (cost, array index) pairs in increasing cost order,
+// equal costs are ordered by their index
+static void selectLowestCostCells(
+    const float* costs, int n_cells, unsigned int number_of_candidates,
+    std::vector<std::pair<float, int>>& cells) {
+  cells.clear();
+  const size_t n_selected = std::min(static_cast<size_t>(n_cells),
+                                     static_cast<size_t>(number_of_candidates));
+  if (n_selected == 0) return;
+
+  // cells cheaper than the current k-th best cost are collected in a buffer
+  // of 2k cells, which is pruned back to the k best ones whenever it is full.
+  // Most cells are rejected by a single comparison.
+  cells.reserve(2 * n_selected);
+  float threshold = INFINITY;
+  for (int i = 0; i < n_cells; i++) {
+    if (costs[i] < threshold) {
+      cells.push_back(std::make_pair(costs[i], i));
+      if (cells.size() == 2 * n_selected) {
+        std::nth_element(cells.begin(), cells.begin() + n_selected - 1,
+                         cells.end());
+        cells.resize(n_selected);
+        threshold = cells[n_selected - 1].first;
       }
     }
   }
+  if (cells.size() > n_selected) {
+    std::nth_element(cells.begin(), cells.begin() + n_selected - 1,
+                     cells.end());
+    cells.resize(n_selected);
+  }
+  std::sort(cells.begin(), cells.end());
+}
 
-  unsigned int smooth_radius = ceil(smoothing_margin_degrees / ALPHA_RES);
-  smoothPolarMatrix(distance_matrix, smooth_radius);
+template <int RES>
+void getBestCandidatesCoarseToFine(
+    const PolarHistogram<RES>& histogram, const Eigen::Vector3f& goal,
+    const Eigen::Vector3f& position, const float yaw_angle_histogram_frame_deg,
+    const Eigen::Vector3f& last_sent_waypoint, costParameters cost_params,
+    const float smoothing_margin_degrees, unsigned int number_of_candidates,
+    std::vector<candidateDirection>& candidate_vector) {
+  const int coarse_e_dim = PolarHistogram<2 * RES>::e_dim;
+  const int coarse_z_dim = PolarHistogram<2 * RES>::z_dim;
+  candidate_vector.clear();
+  if (number_of_candidates == 0) return;
 
-  generateCostImage(cost_matrix, distance_matrix, image_data);
-  cost_matrix = cost_matrix + distance_matrix;
+  // the smoothed obstacle cost is cheap to get for the whole histogram, only
+  // the goal and smoothness costs are evaluated coarse to fine
+  Eigen::MatrixXf distance_matrix;
+  getDistanceCostMatrix(histogram, ceil(smoothing_margin_degrees / RES),
+                        distance_matrix);
+  const DirectionCost direction_cost(goal, position,
+                                     yaw_angle_histogram_frame_deg,
+                                     last_sent_waypoint, cost_params);
+  Eigen::MatrixXf coarse_cost;
+  getDirectionCostMatrix<2 * RES>(direction_cost, coarse_cost);
+
+  // select the coarse cells with the lowest cost, taking the lowest obstacle
+  // cost of the four cells each of them covers
+  for (int e = 0; e < coarse_e_dim; e++) {
+    for (int z = 0; z < coarse_z_dim; z++) {
+      coarse_cost(e, z) += distance_matrix.block<2, 2>(2 * e, 2 * z).minCoeff();
+    }
+  }
+  std::vector<std::pair<float, int>> coarse_cells;
+  selectLowestCostCells(coarse_cost.data(), coarse_cost.size(),
+                        number_of_candidates, coarse_cells);
+
+  // evaluate the four cells of each selected coarse cell at full resolution,
+  // with the same cost getCostMatrix assigns them
+  std::vector<candidateDirection> fine_candidates;
+  fine_candidates.reserve(4 * coarse_cells.size());
+  for (const std::pair<float, int>& coarse_cell : coarse_cells) {
+    // Eigen::MatrixXf is stored column major
+    const int coarse_e = coarse_cell.second % coarse_e_dim;
+    const int coarse_z = coarse_cell.second / coarse_e_dim;
+    for (int e = 2 * coarse_e; e < 2 * coarse_e + 2; e++) {
+      for (int z = 2 * coarse_z; z < 2 * coarse_z + 2; z++) {
+        const float cost =
+            getDirectionCost<RES>(direction_cost, e, z) + distance_matrix(e, z);
+        PolarPoint p_pol = histogramIndexToPolar(e, z, RES, 1.f);
+        fine_candidates.push_back(candidateDirection(cost, p_pol.e, p_pol.z));
+      }
+    }
+  }
+
+  // lowest cost at the front, as getBestCandidatesFromCostMatrix
+  const size_t n_candidates = std::min(
+      fine_candidates.size(), static_cast<size_t>(number_of_candidates));
+  std::partial_sort(fine_candidates.begin(),
+                    fine_candidates.begin() + n_candidates,
+                    fine_candidates.end());
+  candidate_vector.assign(fine_candidates.begin(),
+                          fine_candidates.begin() + n_candidates);
 }
 
 void generateCostImage(const Eigen::MatrixXf& cost_matrix,
@@ -241,10 +700,10 @@ void generateCostImage(const Eigen::MatrixXf& cost_matrix,
                        std::vector<uint8_t>& image_data) {
   float max_val = std::max(cost_matrix.maxCoeff(), distance_matrix.maxCoeff());
   image_data.clear();
-  image_data.reserve(3 * GRID_LENGTH_E * GRID_LENGTH_Z);
+  image_data.reserve(3 * cost_matrix.rows() * cost_matrix.cols());
 
-  for (int e = GRID_LENGTH_E - 1; e >= 0; e--) {
-    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+  for (int e = cost_matrix.rows() - 1; e >= 0; e--) {
+    for (int z = 0; z < cost_matrix.cols(); z++) {
       float distance_cost = 255.f * distance_matrix(e, z) / max_val;
       float other_cost = 255.f * cost_matrix(e, z) / max_val;
       image_data.push_back(
@@ -264,62 +723,67 @@ int colorImageIndex(int e_ind, int z_ind, int color) {
 void getBestCandidatesFromCostMatrix(
     const Eigen::MatrixXf& matrix, unsigned int number_of_candidates,
     std::vector<candidateDirection>& candidate_vector) {
-  std::priority_queue<candidateDirection, std::vector<candidateDirection>,
-                      std::less<candidateDirection>>
-      queue;
+  std::vector<std::pair<float, int>> cells;
+  selectLowestCostCells(matrix.data(), matrix.size(), number_of_candidates,
+                        cells);
 
-  for (int row_index = 0; row_index < matrix.rows(); row_index++) {
-    for (int col_index = 0; col_index < matrix.cols(); col_index++) {
-      PolarPoint p_pol =
-          histogramIndexToPolar(row_index, col_index, ALPHA_RES, 1.0);
-      float cost = matrix(row_index, col_index);
-      candidateDirection candidate(cost, p_pol.e, p_pol.z);
-
-      if (queue.size() < number_of_candidates) {
-        queue.push(candidate);
-      } else if (candidate < queue.top()) {
-        queue.push(candidate);
-        queue.pop();
-      }
-    }
-  }
-  // copy queue to vector and change order such that lowest cost is at the
-  // front
+  // the matrix covers 180 degrees of elevation, only the selected cells are
+  // converted to polar coordinates
+  const int resolution = 180 / matrix.rows();
   candidate_vector.clear();
-  candidate_vector.reserve(queue.size());
-  while (!queue.empty()) {
-    candidate_vector.push_back(queue.top());
-    queue.pop();
+  candidate_vector.reserve(cells.size());
+  for (const std::pair<float, int>& cell : cells) {
+    // Eigen::MatrixXf is stored column major
+    const int row_index = cell.second % matrix.rows();
+    const int col_index = cell.second / matrix.rows();
+    PolarPoint p_pol =
+        histogramIndexToPolar(row_index, col_index, resolution, 1.0);
+    candidate_vector.push_back(
+        candidateDirection(cell.first, p_pol.e, p_pol.z));
+  }
+}
+
+// box filter of the given length as a running sum, out has
+// n_in - box_length + 1 elements
+static void boxFilter(const float* in, int n_in, int box_length, float* out) {
+  float sum = 0.f;
+  for (int i = 0; i < box_length; i++) {
+    sum += in[i];
+  }
+  out[0] = sum;
+  for (int i = box_length; i < n_in; i++) {
+    sum += in[i] - in[i - box_length];
+    out[i - box_length + 1] = sum;
   }
-  std::reverse(candidate_vector.begin(), candidate_vector.end());
 }
 
 void smoothPolarMatrix(Eigen::MatrixXf& matrix, unsigned int smoothing_radius) {
   // pad matrix by smoothing radius respecting all wrapping rules
   Eigen::MatrixXf matrix_padded;
   padPolarMatrix(matrix, smoothing_radius, matrix_padded);
-  Eigen::ArrayXf kernel1d = getConicKernel(smoothing_radius);
 
-  Eigen::ArrayXf temp_col(matrix_padded.rows());
+  // the conic kernel of getConicKernel is the convolution of two box filters
+  // of length radius + 1, scaled by 1 / (radius + 1)
+  const int box_length = smoothing_radius + 1;
+  const float scale = 1.f / box_length;
+  Eigen::ArrayXf temp(matrix_padded.rows() + matrix_padded.cols());
+  Eigen::ArrayXf box(temp.size());
+
   for (int col_index = 0; col_index < matrix_padded.cols(); col_index++) {
-    temp_col = matrix_padded.col(col_index);
-    for (int row_index = 0; row_index < matrix.rows(); row_index++) {
-      float smooth_val =
-          (temp_col.segment(row_index, 2 * smoothing_radius + 1) * kernel1d)
-              .sum();
-      matrix_padded(row_index + smoothing_radius, col_index) = smooth_val;
-    }
+    const int n_padded = matrix_padded.rows();
+    boxFilter(matrix_padded.col(col_index).data(), n_padded, box_length,
+              box.data());
+    boxFilter(box.data(), n_padded - box_length + 1, box_length, temp.data());
+    matrix_padded.col(col_index).segment(smoothing_radius, matrix.rows()) =
+        scale * temp.head(matrix.rows()).matrix();
   }
 
-  Eigen::ArrayXf temp_row(matrix_padded.cols());
   for (int row_index = 0; row_index < matrix.rows(); row_index++) {
-    temp_row = matrix_padded.row(row_index + smoothing_radius);
-    for (int col_index = 0; col_index < matrix.cols(); col_index++) {
-      float smooth_val =
-          (temp_row.segment(col_index, 2 * smoothing_radius + 1) * kernel1d)
-              .sum();
-      matrix(row_index, col_index) = smooth_val;
-    }
+    const int n_padded = matrix_padded.cols();
+    temp.head(n_padded) = matrix_padded.row(row_index + smoothing_radius);
+    boxFilter(temp.data(), n_padded, box_length, box.data());
+    boxFilter(box.data(), n_padded - box_length + 1, box_length, temp.data());
+    matrix.row(row_index) = scale * temp.head(matrix.cols()).matrix();
   }
 }
 
@@ -542,4 +1006,83 @@ void printHistogram(Histogram& histogram) {
   std::cout << "_______________________________________________________________"
                "____________________________________\n";
 }
+
+// resolutions the planner functions are provided for
+template void getBestCandidatesCoarseToFine(
+    const PolarHistogram<3>& histogram, const Eigen::Vector3f& goal,
+    const Eigen::Vector3f& position, const float yaw_angle_histogram_frame_deg,
+    const Eigen::Vector3f& last_sent_waypoint, costParameters cost_params,
+    const float smoothing_margin_degrees, unsigned int number_of_candidates,
+    std::vector<candidateDirection>& candidate_vector);
+template void getBestCandidatesCoarseToFine(
+    const PolarHistogram<6>& histogram, const Eigen::Vector3f& goal,
+    const Eigen::Vector3f& position, const float yaw_angle_histogram_frame_deg,
+    const Eigen::Vector3f& last_sent_waypoint, costParameters cost_params,
+    const float smoothing_margin_degrees, unsigned int number_of_candidates,
+    std::vector<candidateDirection>& candidate_vector);
+template void generateNewHistogram(
+    PolarHistogram<3>& polar_histogram,
+    const pcl::PointCloud<pcl::PointXYZI>& cropped_cloud,
+    const Eigen::Vector3f& position, const PolarBinningTable* table);
+template void getCostMatrix(const PolarHistogram<3>& histogram,
+                            const Eigen::Vector3f& goal,
+                            const Eigen::Vector3f& position,
+                            const float yaw_angle_histogram_frame_deg,
+                            const Eigen::Vector3f& last_sent_waypoint,
+                            costParameters cost_params, bool only_yawed,
+                            const float smoothing_margin_degrees,
+                            Eigen::MatrixXf& cost_matrix);
+template void getCostMatrix(const PolarHistogram<3>& histogram,
+                            const Eigen::Vector3f& goal,
+                            const Eigen::Vector3f& position,
+                            const float yaw_angle_histogram_frame_deg,
+                            const Eigen::Vector3f& last_sent_waypoint,
+                            costParameters cost_params, bool only_yawed,
+                            const float smoothing_margin_degrees,
+                            Eigen::MatrixXf& cost_matrix,
+                            std::vector<uint8_t>& image_data);
+
+template void generateNewHistogram(
+    PolarHistogram<6>& polar_histogram,
+    const pcl::PointCloud<pcl::PointXYZI>& cropped_cloud,
+    const Eigen::Vector3f& position, const PolarBinningTable* table);
+template void getCostMatrix(const PolarHistogram<6>& histogram,
+                            const Eigen::Vector3f& goal,
+                            const Eigen::Vector3f& position,
+                            const float yaw_angle_histogram_frame_deg,
+                            const Eigen::Vector3f& last_sent_waypoint,
+                            costParameters cost_params, bool only_yawed,
+                            const float smoothing_margin_degrees,
+                            Eigen::MatrixXf& cost_matrix);
+template void getCostMatrix(const PolarHistogram<6>& histogram,
+                            const Eigen::Vector3f& goal,
+                            const Eigen::Vector3f& position,
+                            const float yaw_angle_histogram_frame_deg,
+                            const Eigen::Vector3f& last_sent_waypoint,
+                            costParameters cost_params, bool only_yawed,
+                            const float smoothing_margin_degrees,
+                            Eigen::MatrixXf& cost_matrix,
+                            std::vector<uint8_t>& image_data);
+
+template void generateNewHistogram(
+    PolarHistogram<12>& polar_histogram,
+    const pcl::PointCloud<pcl::PointXYZI>& cropped_cloud,
+    const Eigen::Vector3f& position, const PolarBinningTable* table);
+template void getCostMatrix(const PolarHistogram<12>& histogram,
+                            const Eigen::Vector3f& goal,
+                            const Eigen::Vector3f& position,
+                            const float yaw_angle_histogram_frame_deg,
+                            const Eigen::Vector3f& last_sent_waypoint,
+                            costParameters cost_params, bool only_yawed,
+                            const float smoothing_margin_degrees,
+                            Eigen::MatrixXf& cost_matrix);
+template void getCostMatrix(const PolarHistogram<12>& histogram,
+                            const Eigen::Vector3f& goal,
+                            const Eigen::Vector3f& position,
+                            const float yaw_angle_histogram_frame_deg,
+                            const Eigen::Vector3f& last_sent_waypoint,
+                            costParameters cost_params, bool only_yawed,
+                            const float smoothing_margin_degrees,
+                            Eigen::MatrixXf& cost_matrix,
+                            std::vector<uint8_t>& image_data);
 }
@@ -0,0 +1,250 @@
+#include "local_planner/pointcloud_ingestion.h"
+
+#include <sensor_msgs/PointField.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace avoidance {
+
+namespace {
+// byte offset of a FLOAT32 field, -1 if the field is missing
+int floatFieldOffset(const sensor_msgs::PointCloud2& msg, const char* name) {
+  for (const sensor_msgs::PointField& field : msg.fields) {
+    if (field.name == name) {
+      return field.datatype == sensor_msgs::PointField::FLOAT32
+                 ? static_cast<int>(field.offset)
+                 : -1;
+    }
+  }
+  return -1;
+}
+
+// number of samples spanning at most resolution [deg] for a sample size of
+// pixel_scale calibrated pixels
+int strideForFootprint(double focal_length, double pixel_scale,
+                       float resolution) {
+  if (!(focal_length > 0.0) || !(pixel_scale > 0.0)) return 1;
+  const double footprint = std::atan(pixel_scale / focal_length) * 180.0 / M_PI;
+  return std::max(1, static_cast<int>(resolution / footprint));
+}
+
+// voxel index packed into 21 bits, which covers +-1 million voxels, far beyond
+// the sensor range
+inline uint64_t voxelCoordinate(float value, float inverse_leaf_size) {
+  const float scaled = value * inverse_leaf_size;
+  // truncation followed by a correction for negative values is much cheaper
+  // than std::floor
+  int64_t index = static_cast<int64_t>(scaled);
+  index -= scaled < index;
+  return static_cast<uint64_t>(index + (1 << 20)) & ((1 << 21) - 1);
+}
+
+const uint64_t kEmptyVoxel = ~uint64_t(0);
+
+// inserts key into the hash set with linear probing, the table size is a
+// power of two. Returns false if the key was already in the set
+inline bool insertVoxel(uint64_t key, std::vector<uint64_t>& table) {
+  const uint64_t mask = table.size() - 1;
+  uint64_t slot = (key * 0x9E3779B97F4A7C15ull >> 32) & mask;
+  while (table[slot] != kEmptyVoxel) {
+    if (table[slot] == key) return false;
+    slot = (slot + 1) & mask;
+  }
+  table[slot] = key;
+  return true;
+}
+
+inline float readFloat(const uint8_t* data) {
+  float value;
+  std::memcpy(&value, data, sizeof(float));
+  return value;
+}
+
+inline float readMillimeters(const uint8_t* data) {
+  uint16_t value;
+  std::memcpy(&value, data, sizeof(uint16_t));
+  // zero marks pixels without depth
+  return value == 0 ? NAN : value * 0.001f;
+}
+
+template <typename ReadDepth>
+void backProject(const sensor_msgs::Image& msg,
+                 const sensor_msgs::CameraInfo& info,
+                 const Eigen::Affine3f& transform,
+                 const ingestionParameters& params, size_t pixel_size,
+                 ReadDepth read_depth, pcl::PointCloud<pcl::PointXYZ>& cloud) {
+  const int row_stride = std::max(1, params.row_stride);
+  const int column_stride = std::max(1, params.column_stride);
+  const float inverse_fx = 1.f / static_cast<float>(info.K[0]);
+  const float inverse_fy = 1.f / static_cast<float>(info.K[4]);
+  const float cx = static_cast<float>(info.K[2]);
+  const float cy = static_cast<float>(info.K[5]);
+  const float max_range_sq = params.max_range * params.max_range;
+  cloud.points.reserve(((msg.height + row_stride - 1) / row_stride) *
+                       ((msg.width + column_stride - 1) / column_stride));
+
+  const Eigen::Matrix3f rotation = transform.linear();
+  const Eigen::Vector3f translation = transform.translation();
+  for (uint32_t v = 0; v < msg.height; v += row_stride) {
+    const uint8_t* pixel = &msg.data[static_cast<size_t>(v) * msg.step];
+    const float ray_y = (v - cy) * inverse_fy;
+    for (uint32_t u = 0; u < msg.width; u += column_stride) {
+      const float depth = read_depth(pixel);
+      pixel += column_stride * pixel_size;
+      const float x = (u - cx) * inverse_fx * depth;
+      const float y = ray_y * depth;
+      // the negated comparison also rejects NaN
+      if (!(depth > 0.f && x * x + y * y + depth * depth <= max_range_sq)) {
+        continue;
+      }
+      const Eigen::Vector3f p =
+          rotation * Eigen::Vector3f(x, y, depth) + translation;
+      cloud.points.push_back(pcl::PointXYZ(p.x(), p.y(), p.z()));
+    }
+  }
+}
+}
+
+void setAngularStride(const sensor_msgs::CameraInfo& info, uint32_t width,
+                      uint32_t height, float resolution,
+                      ingestionParameters& params) {
+  // clouds and images can be published at a lower resolution than the one
+  // the camera was calibrated at
+  const double column_scale =
+      width > 0 && info.width > 0 ? static_cast<double>(info.width) / width
+                                  : 1.0;
+  const double row_scale =
+      height > 0 && info.height > 0 ? static_cast<double>(info.height) / height
+                                    : 1.0;
+  params.column_stride =
+      strideForFootprint(info.K[0], column_scale, resolution);
+  params.row_stride = strideForFootprint(info.K[4], row_scale, resolution);
+}
+
+bool ingestPointCloud(const sensor_msgs::PointCloud2& msg,
+                      const Eigen::Affine3f& transform,
+                      const ingestionParameters& params,
+                      pcl::PointCloud<pcl::PointXYZ>& cloud) {
+  cloud.points.clear();
+  const int x_offset = floatFieldOffset(msg, "x");
+  const int y_offset = floatFieldOffset(msg, "y");
+  const int z_offset = floatFieldOffset(msg, "z");
+  const int last_offset = std::max(x_offset, std::max(y_offset, z_offset));
+  if (x_offset < 0 || y_offset < 0 || z_offset < 0 || msg.is_bigendian ||
+      last_offset + sizeof(float) > msg.point_step ||
+      static_cast<size_t>(msg.point_step) * msg.width > msg.row_step ||
+      msg.data.size() < static_cast<size_t>(msg.row_step) * msg.height) {
+    cloud.width = 0;
+    cloud.height = 1;
+    return false;
+  }
+
+  const int row_stride = std::max(1, params.row_stride);
+  const int column_stride = std::max(1, params.column_stride);
+  const float max_range_sq = params.max_range * params.max_range;
+  cloud.points.reserve(((msg.height + row_stride - 1) / row_stride) *
+                       ((msg.width + column_stride - 1) / column_stride));
+
+  const Eigen::Matrix3f rotation = transform.linear();
+  const Eigen::Vector3f translation = transform.translation();
+  for (uint32_t row = 0; row < msg.height; row += row_stride) {
+    const uint8_t* point = &msg.data[static_cast<size_t>(row) * msg.row_step];
+    for (uint32_t col = 0; col < msg.width; col += column_stride) {
+      const float x = readFloat(point + x_offset);
+      const float y = readFloat(point + y_offset);
+      const float z = readFloat(point + z_offset);
+      point += column_stride * msg.point_step;
+      // the negated comparison also rejects NaN
+      if (!(x * x + y * y + z * z <= max_range_sq)) continue;
+      const Eigen::Vector3f p = rotation * Eigen::Vector3f(x, y, z) +
+                                translation;
+      cloud.points.push_back(pcl::PointXYZ(p.x(), p.y(), p.z()));
+    }
+  }
+  cloud.width = cloud.points.size();
+  cloud.height = 1;
+  cloud.is_dense = true;
+  return true;
+}
+
+bool ingestDepthImage(const sensor_msgs::Image& msg,
+                      const sensor_msgs::CameraInfo& info,
+                      const Eigen::Affine3f& transform,
+                      const ingestionParameters& params,
+                      pcl::PointCloud<pcl::PointXYZ>& cloud) {
+  namespace enc = sensor_msgs::image_encodings;
+  cloud.points.clear();
+  const bool millimeters =
+      msg.encoding == enc::TYPE_16UC1 || msg.encoding == enc::MONO16;
+  const bool meters = msg.encoding == enc::TYPE_32FC1;
+  const size_t pixel_size = millimeters ? sizeof(uint16_t) : sizeof(float);
+  if ((!millimeters && !meters) || msg.is_bigendian || info.K[0] <= 0.0 ||
+      info.K[4] <= 0.0 || pixel_size * msg.width > msg.step ||
+      msg.data.size() < static_cast<size_t>(msg.step) * msg.height) {
+    cloud.width = 0;
+    cloud.height = 1;
+    return false;
+  }
+
+  if (millimeters) {
+    backProject(msg, info, transform, params, pixel_size, readMillimeters,
+                cloud);
+  } else {
+    backProject(msg, info, transform, params, pixel_size, readFloat, cloud);
+  }
+  cloud.width = cloud.points.size();
+  cloud.height = 1;
+  cloud.is_dense = true;
+  return true;
+}
+
+void voxelPrefilter(float leaf_size, pcl::PointCloud<pcl::PointXYZ>& cloud) {
+  if (!(leaf_size > 0.f) || cloud.points.empty()) return;
+  const float inverse_leaf_size = 1.f / leaf_size;
+
+  // open addressing hash set of the occupied voxels, kept at most half full.
+  // It grows with the number of voxels rather than points and keeps the size
+  // reached by the previous cloud of the thread
+  static thread_local std::vector<uint64_t> occupied;
+  occupied.assign(std::max<size_t>(occupied.size(), 4096), kEmptyVoxel);
+  size_t n_occupied = 0;
+
+  size_t n_kept = 0;
+  for (const pcl::PointXYZ& p : cloud.points) {
+    const uint64_t key = (voxelCoordinate(p.x, inverse_leaf_size) << 42) |
+                         (voxelCoordinate(p.y, inverse_leaf_size) << 21) |
+                         voxelCoordinate(p.z, inverse_leaf_size);
+    if (insertVoxel(key, occupied)) {
+      cloud.points[n_kept++] = p;
+      if (2 * ++n_occupied > occupied.size()) {
+        std::vector<uint64_t> old_table(2 * occupied.size(), kEmptyVoxel);
+        old_table.swap(occupied);
+        for (uint64_t old_key : old_table) {
+          if (old_key != kEmptyVoxel) insertVoxel(old_key, occupied);
+        }
+      }
+    }
+  }
+  cloud.points.resize(n_kept);
+  cloud.width = n_kept;
+  cloud.height = 1;
+}
+
+void randomPrefilter(size_t max_points, std::minstd_rand& generator,
+                     pcl::PointCloud<pcl::PointXYZ>& cloud) {
+  const size_t n_points = cloud.points.size();
+  if (max_points == 0 || n_points <= max_points) return;
+  // partial Fisher-Yates shuffle, the sample ends up at the front
+  for (size_t i = 0; i < max_points; i++) {
+    std::uniform_int_distribution<size_t> index(i, n_points - 1);
+    std::swap(cloud.points[i], cloud.points[index(generator)]);
+  }
+  cloud.points.resize(max_points);
+  cloud.width = max_points;
+  cloud.height = 1;
+}
+}
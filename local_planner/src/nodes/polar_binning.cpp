@@ -0,0 +1,321 @@
+#include "local_planner/polar_binning.h"
+
+#include "local_planner/common.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace avoidance {
+
+namespace {
+
+// the polynomial atan2 is accurate to about 1e-5 rad (6e-4 deg), points
+// closer than this to a bin border are binned by the scalar functions
+const float BORDER_MARGIN_DEG = 0.005f;
+
+// minimax polynomial for atan(a) / a on [0, 1]
+const float ATAN_C0 = 0.99986600f;
+const float ATAN_C1 = -0.33029950f;
+const float ATAN_C2 = 0.18014100f;
+const float ATAN_C3 = -0.08513300f;
+const float ATAN_C4 = 0.02083510f;
+
+inline void binPointExact(float x, float y, float z,
+                          const Eigen::Vector3f& origin, int res,
+                          int& e_index, int& z_index, float& range) {
+  PolarPoint p_pol = cartesianToPolar(x, y, z, origin);
+  Eigen::Vector2i p_ind = polarToHistogramIndex(p_pol, res);
+  e_index = p_ind.y();
+  z_index = p_ind.x();
+  range = p_pol.r;
+}
+
+#if defined(__AVX2__)
+typedef __m256 Floats;
+typedef __m256i Ints;
+const size_t WIDTH = 8;
+
+inline Floats set1(float v) { return _mm256_set1_ps(v); }
+inline Floats load(const float* p) { return _mm256_loadu_ps(p); }
+inline void store(float* p, Floats v) { _mm256_storeu_ps(p, v); }
+inline void store(int* p, Ints v) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+inline Floats add(Floats a, Floats b) { return _mm256_add_ps(a, b); }
+inline Floats sub(Floats a, Floats b) { return _mm256_sub_ps(a, b); }
+inline Floats mul(Floats a, Floats b) { return _mm256_mul_ps(a, b); }
+inline Floats div(Floats a, Floats b) { return _mm256_div_ps(a, b); }
+inline Floats sqrt(Floats a) { return _mm256_sqrt_ps(a); }
+inline Floats min(Floats a, Floats b) { return _mm256_min_ps(a, b); }
+inline Floats max(Floats a, Floats b) { return _mm256_max_ps(a, b); }
+inline Floats bitAnd(Floats a, Floats b) { return _mm256_and_ps(a, b); }
+inline Floats bitOr(Floats a, Floats b) { return _mm256_or_ps(a, b); }
+inline Floats bitXor(Floats a, Floats b) { return _mm256_xor_ps(a, b); }
+inline Floats bitAndNot(Floats a, Floats b) { return _mm256_andnot_ps(a, b); }
+inline Floats greater(Floats a, Floats b) {
+  return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+}
+inline Floats inRange(Floats a, Floats lower, Floats upper) {
+  return _mm256_and_ps(_mm256_cmp_ps(a, lower, _CMP_GE_OQ),
+                       _mm256_cmp_ps(a, upper, _CMP_LE_OQ));
+}
+inline Floats select(Floats mask, Floats a, Floats b) {
+  return _mm256_blendv_ps(b, a, mask);
+}
+inline Ints truncate(Floats a) { return _mm256_cvttps_epi32(a); }
+inline Floats toFloats(Ints a) { return _mm256_cvtepi32_ps(a); }
+inline int moveMask(Floats a) { return _mm256_movemask_ps(a); }
+#elif defined(__SSE2__)
+typedef __m128 Floats;
+typedef __m128i Ints;
+const size_t WIDTH = 4;
+
+inline Floats set1(float v) { return _mm_set1_ps(v); }
+inline Floats load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, Floats v) { _mm_storeu_ps(p, v); }
+inline void store(int* p, Ints v) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+inline Floats add(Floats a, Floats b) { return _mm_add_ps(a, b); }
+inline Floats sub(Floats a, Floats b) { return _mm_sub_ps(a, b); }
+inline Floats mul(Floats a, Floats b) { return _mm_mul_ps(a, b); }
+inline Floats div(Floats a, Floats b) { return _mm_div_ps(a, b); }
+inline Floats sqrt(Floats a) { return _mm_sqrt_ps(a); }
+inline Floats min(Floats a, Floats b) { return _mm_min_ps(a, b); }
+inline Floats max(Floats a, Floats b) { return _mm_max_ps(a, b); }
+inline Floats bitAnd(Floats a, Floats b) { return _mm_and_ps(a, b); }
+inline Floats bitOr(Floats a, Floats b) { return _mm_or_ps(a, b); }
+inline Floats bitXor(Floats a, Floats b) { return _mm_xor_ps(a, b); }
+inline Floats bitAndNot(Floats a, Floats b) { return _mm_andnot_ps(a, b); }
+inline Floats greater(Floats a, Floats b) { return _mm_cmpgt_ps(a, b); }
+inline Floats inRange(Floats a, Floats lower, Floats upper) {
+  return _mm_and_ps(_mm_cmpge_ps(a, lower), _mm_cmple_ps(a, upper));
+}
+inline Floats select(Floats mask, Floats a, Floats b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+inline Ints truncate(Floats a) { return _mm_cvttps_epi32(a); }
+inline Floats toFloats(Ints a) { return _mm_cvtepi32_ps(a); }
+inline int moveMask(Floats a) { return _mm_movemask_ps(a); }
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+// polynomial atan2 in radians, matches std::atan2 up to about 1e-5 rad
+inline Floats atan2Approx(Floats y, Floats x) {
+  const Floats sign_bit = set1(-0.f);
+  const Floats abs_x = bitAndNot(sign_bit, x);
+  const Floats abs_y = bitAndNot(sign_bit, y);
+  const Floats big = max(abs_x, abs_y);
+  const Floats small = min(abs_x, abs_y);
+  // a zero denominator only happens for x = y = 0, return 0 as std::atan2
+  const Floats a = div(small, max(big, set1(FLT_MIN)));
+  const Floats s = mul(a, a);
+  Floats p = add(mul(set1(ATAN_C4), s), set1(ATAN_C3));
+  p = add(mul(p, s), set1(ATAN_C2));
+  p = add(mul(p, s), set1(ATAN_C1));
+  p = add(mul(p, s), set1(ATAN_C0));
+  p = mul(p, a);
+  // undo the octant reduction
+  p = select(greater(abs_y, abs_x), sub(set1(M_PI_F / 2.f), p), p);
+  p = select(greater(set1(0.f), x), sub(set1(M_PI_F), p), p);
+  return bitXor(p, bitAnd(sign_bit, y));
+}
+
+// bin index of a continuous bin coordinate, lanes closer to a bin border than
+// margin are set in the returned mask
+inline Ints binIndex(Floats bin, Floats margin, Floats& unsafe) {
+  const Ints index = truncate(bin);
+  const Floats fraction = sub(bin, toFloats(index));
+  unsafe = bitOr(unsafe, bitAndNot(inRange(fraction, margin,
+                                           sub(set1(1.f), margin)),
+                                   set1(-0.f)));
+  return index;
+}
+#endif
+}
+
+void cartesianToHistogramIndices(const float* x, const float* y,
+                                 const float* z, size_t n,
+                                 const Eigen::Vector3f& origin, int res,
+                                 int* e_index, int* z_index, float* range) {
+  size_t i = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+  const Floats origin_x = set1(origin.x());
+  const Floats origin_y = set1(origin.y());
+  const Floats origin_z = set1(origin.z());
+  const Floats rad_to_bin = set1(RAD_TO_DEG / res);
+  const Floats e_offset = set1(90.f / res);
+  const Floats z_offset = set1(180.f / res);
+  const Floats margin = set1(BORDER_MARGIN_DEG / res);
+  for (; i + WIDTH <= n; i += WIDTH) {
+    const Floats dx = sub(load(x + i), origin_x);
+    const Floats dy = sub(load(y + i), origin_y);
+    const Floats dz = sub(load(z + i), origin_z);
+    const Floats horizontal_sq = add(mul(dx, dx), mul(dy, dy));
+    store(range + i, sqrt(add(horizontal_sq, mul(dz, dz))));
+
+    const Floats e_bin =
+        add(mul(atan2Approx(dz, sqrt(horizontal_sq)), rad_to_bin), e_offset);
+    const Floats z_bin = add(mul(atan2Approx(dx, dy), rad_to_bin), z_offset);
+    // lanes with NaN coordinates fail the range check as well
+    Floats unsafe = set1(0.f);
+    store(e_index + i, binIndex(e_bin, margin, unsafe));
+    store(z_index + i, binIndex(z_bin, margin, unsafe));
+
+    int unsafe_lanes = moveMask(unsafe);
+    while (unsafe_lanes != 0) {
+      const int lane = __builtin_ctz(unsafe_lanes);
+      unsafe_lanes &= unsafe_lanes - 1;
+      const size_t j = i + lane;
+      binPointExact(x[j], y[j], z[j], origin, res, e_index[j], z_index[j],
+                    range[j]);
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    binPointExact(x[i], y[i], z[i], origin, res, e_index[i], z_index[i],
+                  range[i]);
+  }
+}
+
+const uint16_t PolarBinningTable::UNRESOLVED;
+
+PolarBinningTable::PolarBinningTable(float radius, float voxel_size, int res)
+    : radius_{radius},
+      voxel_size_{voxel_size},
+      inverse_voxel_size_{1.f / voxel_size},
+      res_{res},
+      n_voxels_{static_cast<int>(std::ceil(2.f * radius / voxel_size))} {
+  const int e_dim = 180 / res;
+  const int z_dim = 360 / res;
+  // the voxels are grown slightly to cover the rounding of the voxel
+  // coordinates in lookup
+  const double grow = 1e-4 * voxel_size;
+  const double margin = BORDER_MARGIN_DEG;
+  bins_.assign(static_cast<size_t>(n_voxels_) * n_voxels_ * n_voxels_,
+               UNRESOLVED);
+
+  for (int i = 0; i < n_voxels_; i++) {
+    const double x0 = i * voxel_size - radius - grow;
+    const double x1 = x0 + voxel_size + 2.0 * grow;
+    for (int j = 0; j < n_voxels_; j++) {
+      const double y0 = j * voxel_size - radius - grow;
+      const double y1 = y0 + voxel_size + 2.0 * grow;
+      // voxels around the vertical axis see every azimuth, voxels crossing
+      // the negative y axis cover the +-180 degree azimuth border
+      if (x0 <= 0.0 && x1 >= 0.0 && y0 <= 0.0) continue;
+
+      // the azimuth extremes of a rectangle not containing the axis are at
+      // its corners
+      double z_min = 360.0;
+      double z_max = -360.0;
+      for (double x : {x0, x1}) {
+        for (double y : {y0, y1}) {
+          const double azimuth = std::atan2(x, y) * 180.0 / M_PI;
+          z_min = std::min(z_min, azimuth);
+          z_max = std::max(z_max, azimuth);
+        }
+      }
+      const int z_index =
+          static_cast<int>(std::floor((z_min - margin) / res + 180.0 / res));
+      if (z_index < 0 || z_index >= z_dim ||
+          z_index != static_cast<int>(
+                         std::floor((z_max + margin) / res + 180.0 / res))) {
+        continue;
+      }
+
+      // the elevation is largest at the top face closest to the axis (or
+      // furthest if the face is below the vehicle) and vice versa
+      const double near_x = x0 > 0.0 ? x0 : (x1 < 0.0 ? -x1 : 0.0);
+      const double near_y = y0 > 0.0 ? y0 : (y1 < 0.0 ? -y1 : 0.0);
+      const double h_min = std::sqrt(near_x * near_x + near_y * near_y);
+      const double far_x = std::max(std::abs(x0), std::abs(x1));
+      const double far_y = std::max(std::abs(y0), std::abs(y1));
+      const double h_max = std::sqrt(far_x * far_x + far_y * far_y);
+
+      for (int k = 0; k < n_voxels_; k++) {
+        const double z0 = k * voxel_size - radius - grow;
+        const double z1 = z0 + voxel_size + 2.0 * grow;
+        const double e_min =
+            std::atan2(z0, z0 <= 0.0 ? h_min : h_max) * 180.0 / M_PI;
+        const double e_max =
+            std::atan2(z1, z1 >= 0.0 ? h_min : h_max) * 180.0 / M_PI;
+        const int e_index =
+            static_cast<int>(std::floor((e_min - margin) / res + 90.0 / res));
+        if (e_index < 0 || e_index >= e_dim ||
+            e_index != static_cast<int>(
+                           std::floor((e_max + margin) / res + 90.0 / res))) {
+          continue;
+        }
+        bins_[(static_cast<size_t>(i) * n_voxels_ + j) * n_voxels_ + k] =
+            static_cast<uint16_t>(e_index * z_dim + z_index);
+      }
+    }
+  }
+}
+
+float PolarBinningTable::resolvedFraction() const {
+  if (bins_.empty()) return 0.f;
+  return static_cast<float>(bins_.size() - std::count(bins_.begin(),
+                                                      bins_.end(),
+                                                      UNRESOLVED)) /
+         bins_.size();
+}
+
+void cartesianToHistogramIndices(const PolarBinningTable& table,
+                                 const float* x, const float* y,
+                                 const float* z, size_t n,
+                                 const Eigen::Vector3f& origin, int res,
+                                 int* e_index, int* z_index, float* range) {
+  // the unresolved points are collected and binned as one batch
+  const size_t block_size = 256;
+  float fallback_x[block_size], fallback_y[block_size], fallback_z[block_size];
+  float fallback_range[block_size];
+  int fallback_e[block_size], fallback_z_index[block_size];
+  size_t fallback_point[block_size];
+
+  for (size_t begin = 0; begin < n; begin += block_size) {
+    const size_t end = std::min(n, begin + block_size);
+    size_t n_fallback = 0;
+    for (size_t i = begin; i < end; i++) {
+      const float dx = x[i] - origin.x();
+      const float dy = y[i] - origin.y();
+      const float dz = z[i] - origin.z();
+      if (table.lookup(dx, dy, dz, res, e_index[i], z_index[i])) {
+        range[i] = std::sqrt(dx * dx + dy * dy + dz * dz);
+      } else {
+        fallback_x[n_fallback] = x[i];
+        fallback_y[n_fallback] = y[i];
+        fallback_z[n_fallback] = z[i];
+        fallback_point[n_fallback] = i;
+        n_fallback++;
+      }
+    }
+    cartesianToHistogramIndices(fallback_x, fallback_y, fallback_z,
+                                n_fallback, origin, res, fallback_e,
+                                fallback_z_index, fallback_range);
+    for (size_t i = 0; i < n_fallback; i++) {
+      e_index[fallback_point[i]] = fallback_e[i];
+      z_index[fallback_point[i]] = fallback_z_index[i];
+      range[fallback_point[i]] = fallback_range[i];
+    }
+  }
+}
+
+const char* polarBinningInstructionSet() {
+#if defined(__AVX2__)
+  return "avx2";
+#elif defined(__SSE2__)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+}
@@ -0,0 +1,49 @@
+#include "local_planner/pose_buffer.h"
+
+#include <algorithm>
+
+namespace avoidance {
+
+PoseBuffer::PoseBuffer(double history_s, double max_extrapolation_s)
+    : history_s_{history_s}, max_extrapolation_s_{max_extrapolation_s} {}
+
+void PoseBuffer::insert(double time, const Eigen::Vector3f& position,
+                        const Eigen::Quaternionf& orientation) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!samples_.empty() && time <= samples_.back().time) return;
+  samples_.push_back(Sample{time, position, orientation.normalized()});
+  while (samples_.front().time < time - history_s_) {
+    samples_.pop_front();
+  }
+}
+
+bool PoseBuffer::get(double time, Eigen::Affine3f& pose) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (samples_.empty() || time < samples_.front().time ||
+      time > samples_.back().time + max_extrapolation_s_) {
+    return false;
+  }
+  if (time >= samples_.back().time) {
+    pose = Eigen::Translation3f(samples_.back().position) *
+           samples_.back().orientation;
+    return true;
+  }
+
+  // first sample newer than the query
+  auto after = std::upper_bound(
+      samples_.begin(), samples_.end(), time,
+      [](double t, const Sample& sample) { return t < sample.time; });
+  auto before = after - 1;
+  const float ratio =
+      static_cast<float>((time - before->time) / (after->time - before->time));
+  pose = Eigen::Translation3f(before->position +
+                              ratio * (after->position - before->position)) *
+         before->orientation.slerp(ratio, after->orientation);
+  return true;
+}
+
+size_t PoseBuffer::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return samples_.size();
+}
+}
@@ -12,6 +12,13 @@ void WorldVisualizer::initializePublishers(ros::NodeHandle& nh) {
 }
 
 int WorldVisualizer::resolveUri(std::string& uri) {
+  auto cached = resolved_uris_.find(uri);
+  if (cached != resolved_uris_.end()) {
+    uri = cached->second;
+    return 0;
+  }
+  const std::string model_uri = uri;
+
   // Iterate through all locations in GAZEBO_MODEL_PATH
   char* gazebo_model_path = getenv("GAZEBO_MODEL_PATH");
   char* home = getenv("HOME");
@@ -28,6 +35,7 @@ int WorldVisualizer::resolveUri(std::string& uri) {
       if (s.st_mode & S_IFREG)  // this path describes a file
       {
         uri = "file://" + current_location + uri;
+        resolved_uris_[model_uri] = uri;
         return 0;
       }
     }
@@ -110,10 +118,18 @@ int WorldVisualizer::visualizeRVIZWorld(const std::string& world_path) {
   return 0;
 }
 
+void WorldVisualizer::setMaxRate(double max_rate) {
+  min_drone_period_s_ = max_rate > 0.0 ? 1.0 / max_rate : 0.0;
+}
+
 int WorldVisualizer::visualizeDrone(const geometry_msgs::PoseStamped& pose) {
+  if (drone_pub_.getNumSubscribers() == 0) return 0;
+  const ros::Time now = ros::Time::now();
+  if (!drone_limiter_.tryPublish(now, min_drone_period_s_)) return 0;
+
   visualization_msgs::Marker drone;
   drone.header.frame_id = "local_origin";
-  drone.header.stamp = ros::Time::now();
+  drone.header.stamp = now;
   drone.type = visualization_msgs::Marker::MESH_RESOURCE;
   drone.mesh_resource = "model://matrice_100/meshes/Matrice_100.dae";
   if (drone.mesh_resource.find("model://") != std::string::npos) {
@@ -0,0 +1,86 @@
+#include "local_planner/search_tree.h"
+
+namespace avoidance {
+
+SearchTree::SearchTree(float grid_cell_size)
+    : grid_cell_size_{grid_cell_size} {}
+
+int SearchTree::addNode(int from, int d, const Eigen::Vector3f& pos) {
+  x_.push_back(pos.x());
+  y_.push_back(pos.y());
+  z_.push_back(pos.z());
+  total_cost_.push_back(0.0f);
+  heuristic_.push_back(0.0f);
+  last_e_.push_back(0.0f);
+  last_z_.push_back(0.0f);
+  yaw_.push_back(0.0f);
+  origin_.push_back(from);
+  depth_.push_back(d);
+  closed_.push_back(0);
+
+  int node = static_cast<int>(x_.size()) - 1;
+  grid_[gridKey(gridCoordinate(pos.x()), gridCoordinate(pos.y()),
+                gridCoordinate(pos.z()))]
+      .push_back(node);
+  return node;
+}
+
+bool SearchTree::hasNodeCloserThan(const Eigen::Vector3f& pos,
+                                   float distance) const {
+  const float distance_sq = distance * distance;
+  const int x_min = gridCoordinate(pos.x() - distance);
+  const int x_max = gridCoordinate(pos.x() + distance);
+  const int y_min = gridCoordinate(pos.y() - distance);
+  const int y_max = gridCoordinate(pos.y() + distance);
+  const int z_min = gridCoordinate(pos.z() - distance);
+  const int z_max = gridCoordinate(pos.z() + distance);
+
+  for (int x = x_min; x <= x_max; x++) {
+    for (int y = y_min; y <= y_max; y++) {
+      for (int z = z_min; z <= z_max; z++) {
+        auto cell = grid_.find(gridKey(x, y, z));
+        if (cell == grid_.end()) continue;
+        for (int node : cell->second) {
+          float dx = x_[node] - pos.x();
+          float dy = y_[node] - pos.y();
+          float dz = z_[node] - pos.z();
+          if (dx * dx + dy * dy + dz * dz < distance_sq) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+void SearchTree::clear() {
+  x_.clear();
+  y_.clear();
+  z_.clear();
+  total_cost_.clear();
+  heuristic_.clear();
+  last_e_.clear();
+  last_z_.clear();
+  yaw_.clear();
+  origin_.clear();
+  depth_.clear();
+  closed_.clear();
+  grid_.clear();
+}
+
+void SearchTree::reserve(size_t n_nodes) {
+  x_.reserve(n_nodes);
+  y_.reserve(n_nodes);
+  z_.reserve(n_nodes);
+  total_cost_.reserve(n_nodes);
+  heuristic_.reserve(n_nodes);
+  last_e_.reserve(n_nodes);
+  last_z_.reserve(n_nodes);
+  yaw_.reserve(n_nodes);
+  origin_.reserve(n_nodes);
+  depth_.reserve(n_nodes);
+  closed_.reserve(n_nodes);
+  grid_.reserve(n_nodes);
+}
+}
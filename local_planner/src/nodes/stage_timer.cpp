@@ -0,0 +1,92 @@
+#include "local_planner/stage_timer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace avoidance {
+
+const char* stageName(Stage stage) {
+  switch (stage) {
+    case Stage::kIngest:
+      return "ingest";
+    case Stage::kPoseLookup:
+      return "pose lookup";
+    case Stage::kProcessPointcloud:
+      return "processPointcloud";
+    case Stage::kHistogram:
+      return "histogram";
+    case Stage::kCostMatrix:
+      return "cost matrix";
+    case Stage::kTreeBuild:
+      return "tree build";
+    case Stage::kWaypointGeneration:
+      return "waypoint generation";
+    case Stage::kPublish:
+      return "publish";
+    case Stage::kVisualization:
+      return "visualization";
+    default:
+      return "unknown";
+  }
+}
+
+int LatencyHistogram::bucketIndex(uint64_t duration_ns) {
+  // durations below 1us share the first bucket
+  const uint64_t us_scaled = (duration_ns * kSubBuckets) / 1000;
+  if (us_scaled < 2 * kSubBuckets) {
+    return std::max<int>(0, static_cast<int>(us_scaled) - kSubBuckets);
+  }
+  // the highest bit gives the octave, the next three bits the sub-bucket
+  const int msb = 63 - __builtin_clzll(us_scaled);
+  const int octave = msb - 3;
+  const int sub = static_cast<int>(us_scaled >> (msb - 3)) - kSubBuckets;
+  return std::min(octave * kSubBuckets + sub, kNumBuckets - 1);
+}
+
+double LatencyHistogram::bucketUpperBoundMs(int index) {
+  const int octave = index / kSubBuckets;
+  const int sub = index % kSubBuckets;
+  return 1e-3 * std::ldexp(1.0 + (sub + 1) / static_cast<double>(kSubBuckets),
+                           octave);
+}
+
+void LatencyHistogram::record(uint64_t duration_ns) {
+  buckets_[bucketIndex(duration_ns)].fetch_add(1, std::memory_order_relaxed);
+  uint64_t max_ns = max_ns_.load(std::memory_order_relaxed);
+  while (duration_ns > max_ns &&
+         !max_ns_.compare_exchange_weak(max_ns, duration_ns,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+stageStatistics LatencyHistogram::collect() {
+  uint32_t counts[kNumBuckets];
+  stageStatistics stats;
+  for (int i = 0; i < kNumBuckets; i++) {
+    counts[i] = buckets_[i].exchange(0, std::memory_order_relaxed);
+    stats.count += counts[i];
+  }
+  stats.max_ms = 1e-6 * max_ns_.exchange(0, std::memory_order_relaxed);
+  if (stats.count == 0) return stats;
+
+  // a percentile is reported as the upper bound of its bucket, but never
+  // above the largest sample
+  const double quantiles[] = {0.5, 0.95, 0.99};
+  double* results[] = {&stats.p50_ms, &stats.p95_ms, &stats.p99_ms};
+  uint64_t cumulative = 0;
+  int q = 0;
+  for (int i = 0; i < kNumBuckets && q < 3; i++) {
+    cumulative += counts[i];
+    while (q < 3 && cumulative >= std::ceil(quantiles[q] * stats.count)) {
+      *results[q] = std::min(bucketUpperBoundMs(i), stats.max_ms);
+      q++;
+    }
+  }
+  return stats;
+}
+
+LatencyHistogram& stageHistogram(Stage stage) {
+  static LatencyHistogram histograms[static_cast<int>(Stage::kNumStages)];
+  return histograms[static_cast<int>(stage)];
+}
+}
@@ -1,10 +1,15 @@
 #include "local_planner/star_planner.h"
 #include "local_planner/common.h"
 #include "local_planner/planner_functions.h"
-#include "local_planner/tree_node.h"
+#include "local_planner/search_tree.h"
+#include "local_planner/stage_timer.h"
 
 #include <ros/console.h>
 
+#include <functional>
+#include <queue>
+#include <utility>
+
 namespace avoidance {
 
 StarPlanner::StarPlanner() : tree_age_(0) {}
@@ -19,6 +24,9 @@ void StarPlanner::dynamicReconfigureSetStarParams(
   max_path_length_ = static_cast<float>(config.max_path_length_);
   smoothing_margin_degrees_ =
       static_cast<float>(config.smoothing_margin_degrees_);
+  coarse_to_fine_candidates_ = config.coarse_to_fine_candidates_;
+  node_histogram_radius_ = static_cast<float>(config.node_histogram_radius_);
+  node_clearance_ = static_cast<float>(config.node_clearance_);
 }
 
 void StarPlanner::setParams(costParameters cost_params) {
@@ -37,6 +45,7 @@ void StarPlanner::setFOV(float h_FOV, float v_FOV) {
 void StarPlanner::setPose(const Eigen::Vector3f& pos, float curr_yaw) {
   position_ = pos;
   curr_yaw_histogram_frame_deg_ = curr_yaw;
+  histogram_valid_ = false;
 }
 
 void StarPlanner::setGoal(const Eigen::Vector3f& goal) {
@@ -46,13 +55,33 @@ void StarPlanner::setGoal(const Eigen::Vector3f& goal) {
 
 void StarPlanner::setPointcloud(const pcl::PointCloud<pcl::PointXYZI>& cloud) {
   cloud_ = cloud;
+  histogram_valid_ = false;
+  obstacle_index_.build(cloud_);
+}
+
+const Histogram& StarPlanner::getHistogram() {
+  if (!histogram_valid_) {
+    histogram_.setZero();
+    generateNewHistogram(histogram_, cloud_, position_);
+    histogram_valid_ = true;
+  }
+  return histogram_;
+}
+
+const Histogram& StarPlanner::getNodeHistogram(
+    const Eigen::Vector3f& node_position) {
+  obstacle_index_.getPointsWithinRadius(node_position, node_histogram_radius_,
+                                        node_cloud_);
+  node_histogram_.setZero();
+  generateNewHistogram(node_histogram_, node_cloud_, node_position);
+  return node_histogram_;
 }
 
 float StarPlanner::treeCostFunction(int node_number) const {
-  int origin = tree_[node_number].origin_;
-  float e = tree_[node_number].last_e_;
-  float z = tree_[node_number].last_z_;
-  Eigen::Vector3f origin_position = tree_[origin].getPosition();
+  int origin = tree_.origin_[node_number];
+  float e = tree_.last_e_[node_number];
+  float z = tree_.last_z_[node_number];
+  Eigen::Vector3f origin_position = tree_.getPosition(origin);
   PolarPoint goal_pol = cartesianToPolar(goal_, origin_position);
 
   float target_cost =
@@ -61,10 +90,10 @@ float StarPlanner::treeCostFunction(int node_number) const {
           indexAngleDifference(e, goal_pol.e);  // include effective direction?
   float turning_cost =
       5.0f *
-      indexAngleDifference(z, tree_[0].yaw_);  // maybe include pitching cost?
+      indexAngleDifference(z, tree_.yaw_[0]);  // maybe include pitching cost?
 
-  float last_e = tree_[origin].last_e_;
-  float last_z = tree_[origin].last_z_;
+  float last_e = tree_.last_e_[origin];
+  float last_z = tree_.last_z_[origin];
 
   float smooth_cost = 5.0f * (2.0f * indexAngleDifference(z, last_z) +
                               5.0f * indexAngleDifference(e, last_e));
@@ -72,139 +101,145 @@ float StarPlanner::treeCostFunction(int node_number) const {
   float smooth_cost_to_old_tree = 0.0f;
   if (tree_age_ < 10) {
     int partner_node_idx =
-        path_node_positions_.size() - 1 - tree_[node_number].depth_;
+        path_node_positions_.size() - 1 - tree_.depth_[node_number];
     if (partner_node_idx >= 0) {
       Eigen::Vector3f partner_node_position =
           path_node_positions_[partner_node_idx];
-      Eigen::Vector3f node_position = tree_[node_number].getPosition();
+      Eigen::Vector3f node_position = tree_.getPosition(node_number);
       float dist = (partner_node_position - node_position).norm();
       smooth_cost_to_old_tree =
           200.0f * dist /
-          (0.5f * static_cast<float>(tree_[node_number].depth_));
+          (0.5f * static_cast<float>(tree_.depth_[node_number]));
     }
   }
 
   return std::pow(tree_discount_factor_,
-                  static_cast<float>(tree_[node_number].depth_)) *
+                  static_cast<float>(tree_.depth_[node_number])) *
          (target_cost + smooth_cost + smooth_cost_to_old_tree + turning_cost);
 }
 float StarPlanner::treeHeuristicFunction(int node_number) const {
-  Eigen::Vector3f node_position = tree_[node_number].getPosition();
+  Eigen::Vector3f node_position = tree_.getPosition(node_number);
   PolarPoint goal_pol = cartesianToPolar(goal_, node_position);
 
-  int origin = tree_[node_number].origin_;
-  Eigen::Vector3f origin_position = tree_[origin].getPosition();
+  int origin = tree_.origin_[node_number];
+  Eigen::Vector3f origin_position = tree_.getPosition(origin);
   float origin_goal_dist = (goal_ - origin_position).norm();
   float goal_dist = (goal_ - node_position).norm();
   float goal_cost = (goal_dist / origin_goal_dist - 0.9f) * 5000.0f;
 
   float smooth_cost =
-      10.0f * (indexAngleDifference(goal_pol.z, tree_[node_number].last_z_) +
-               indexAngleDifference(goal_pol.e, tree_[node_number].last_e_));
+      10.0f * (indexAngleDifference(goal_pol.z, tree_.last_z_[node_number]) +
+               indexAngleDifference(goal_pol.e, tree_.last_e_[node_number]));
 
   return std::pow(tree_discount_factor_,
-                  static_cast<float>(tree_[node_number].depth_)) *
+                  static_cast<float>(tree_.depth_[node_number])) *
          (smooth_cost + goal_cost);
 }
 
 void StarPlanner::buildLookAheadTree() {
-  std::clock_t start_time = std::clock();
+  STAGE_TIMER(kTreeBuild);
   tree_.clear();
+  tree_.reserve(1 + n_expanded_nodes_ * children_per_node_);
   closed_set_.clear();
 
+  // open list ordered by total cost, ties are resolved by the lower node
+  // index. Costs of open nodes never change, closed nodes are skipped lazily
+  typedef std::pair<float, int> OpenNode;
+  std::priority_queue<OpenNode, std::vector<OpenNode>, std::greater<OpenNode>>
+      open_list;
+
   // insert first node
-  tree_.push_back(TreeNode(0, 0, position_));
-  tree_.back().setCosts(treeHeuristicFunction(0), treeHeuristicFunction(0));
-  tree_.back().yaw_ = curr_yaw_histogram_frame_deg_;
-  tree_.back().last_z_ = tree_.back().yaw_;
+  tree_.addNode(0, 0, position_);
+  tree_.yaw_[0] = curr_yaw_histogram_frame_deg_;
+  tree_.last_z_[0] = tree_.yaw_[0];
+  tree_.heuristic_[0] = treeHeuristicFunction(0);
+  tree_.total_cost_[0] = tree_.heuristic_[0];
 
   int origin = 0;
 
   for (int n = 0; n < n_expanded_nodes_; n++) {
-    Eigen::Vector3f origin_position = tree_[origin].getPosition();
-    int old_origin = tree_[origin].origin_;
-    Eigen::Vector3f origin_origin_position = tree_[old_origin].getPosition();
-    bool hist_is_empty = false;  // unused
+    Eigen::Vector3f origin_position = tree_.getPosition(origin);
 
-    // build new histogram
     std::vector<int> z_FOV_idx;
     int e_FOV_min, e_FOV_max;
     calculateFOV(h_FOV_, v_FOV_, z_FOV_idx, e_FOV_min, e_FOV_max,
-                 tree_[origin].yaw_,
+                 tree_.yaw_[origin],
                  0.0f);  // assume pitch is zero at every node
 
-    Histogram histogram = Histogram(ALPHA_RES);
-    generateNewHistogram(histogram, cloud_, position_);
+    // the root sees the whole cloud, deeper nodes only query the obstacles
+    // around their own position
+    const Histogram& histogram =
+        origin == 0 ? getHistogram() : getNodeHistogram(origin_position);
 
     // calculate candidates
-    Eigen::MatrixXf cost_matrix;
-    std::vector<uint8_t> cost_image_data;
     std::vector<candidateDirection> candidate_vector;
-    getCostMatrix(histogram, goal_, origin_position, tree_[origin].yaw_,
-                  projected_last_wp_, cost_params_, false,
-                  smoothing_margin_degrees_, cost_matrix, cost_image_data);
-    getBestCandidatesFromCostMatrix(cost_matrix, children_per_node_,
-                                    candidate_vector);
+    if (coarse_to_fine_candidates_) {
+      getBestCandidatesCoarseToFine(histogram, goal_, origin_position,
+                                    tree_.yaw_[origin], projected_last_wp_,
+                                    cost_params_, smoothing_margin_degrees_,
+                                    children_per_node_, candidate_vector);
+    } else {
+      Eigen::MatrixXf cost_matrix;
+      getCostMatrix(histogram, goal_, origin_position, tree_.yaw_[origin],
+                    projected_last_wp_, cost_params_, false,
+                    smoothing_margin_degrees_, cost_matrix);
+      getBestCandidatesFromCostMatrix(cost_matrix, children_per_node_,
+                                      candidate_vector);
+    }
 
     // add candidates as nodes
     if (candidate_vector.empty()) {
-      tree_[origin].total_cost_ = HUGE_VAL;
+      tree_.total_cost_[origin] = HUGE_VAL;
     } else {
       // insert new nodes
-      int depth = tree_[origin].depth_ + 1;
+      int depth = tree_.depth_[origin] + 1;
       int children = 0;
       for (candidateDirection candidate : candidate_vector) {
+        if (children >= children_per_node_) break;
         PolarPoint p_pol(candidate.elevation_angle, candidate.azimuth_angle,
                          tree_node_distance_);
 
         // check if another close node has been added
         Eigen::Vector3f node_location =
             polarToCartesian(p_pol, origin_position);
-        int close_nodes = 0;
-        for (size_t i = 0; i < tree_.size(); i++) {
-          float dist = (tree_[i].getPosition() - node_location).norm();
-          if (dist < 0.2f) {
-            close_nodes++;
-          }
-        }
 
-        if (children < children_per_node_ && close_nodes == 0) {
-          tree_.push_back(TreeNode(origin, depth, node_location));
-          tree_.back().last_e_ = p_pol.e;
-          tree_.back().last_z_ = p_pol.z;
-          float h = treeHeuristicFunction(tree_.size() - 1);
-          float c = treeCostFunction(tree_.size() - 1);
-          tree_.back().heuristic_ = h;
-          tree_.back().total_cost_ =
-              tree_[origin].total_cost_ - tree_[origin].heuristic_ + c + h;
+        if (!tree_.hasNodeCloserThan(node_location, min_node_distance_) &&
+            obstacle_index_.isSegmentFree(origin_position, node_location,
+                                          node_clearance_)) {
+          int node = tree_.addNode(origin, depth, node_location);
+          tree_.last_e_[node] = p_pol.e;
+          tree_.last_z_[node] = p_pol.z;
+          float h = treeHeuristicFunction(node);
+          float c = treeCostFunction(node);
+          tree_.heuristic_[node] = h;
+          tree_.total_cost_[node] = tree_.total_cost_[origin] -
+                                    tree_.heuristic_[origin] + c + h;
           Eigen::Vector3f diff = node_location - origin_position;
           float yaw_radians = atan2(diff.y(), diff.x());
-          tree_.back().yaw_ =
+          tree_.yaw_[node] =
               std::round((-yaw_radians * 180.0f / M_PI_F)) + 90.0f;
           children++;
+
+          // nodes too far from the vehicle are never expanded, non-finite
+          // costs would break the ordering of the open list
+          if ((node_location - position_).norm() < max_path_length_ &&
+              std::isfinite(tree_.total_cost_[node])) {
+            open_list.push(OpenNode(tree_.total_cost_[node], node));
+          }
         }
       }
     }
 
+    tree_.closed_[origin] = 1;
     closed_set_.push_back(origin);
 
     // find best node to continue
-    float minimal_cost = HUGE_VAL;
-    for (size_t i = 0; i < tree_.size(); i++) {
-      bool closed = false;
-      for (size_t j = 0; j < closed_set_.size(); j++) {
-        if (closed_set_[j] == (int)i) {
-          closed = true;
-        }
-      }
-
-      float node_distance = (tree_[i].getPosition() - position_).norm();
-      if (tree_[i].total_cost_ < minimal_cost && !closed &&
-          node_distance < max_path_length_) {
-        minimal_cost = tree_[i].total_cost_;
-        origin = i;
-      }
+    while (!open_list.empty() && tree_.closed_[open_list.top().second]) {
+      open_list.pop();
     }
+    if (open_list.empty()) break;
+    origin = open_list.top().second;
+    open_list.pop();
   }
   // smoothing between trees
   int tree_end = origin;
@@ -212,19 +247,18 @@ void StarPlanner::buildLookAheadTree() {
   path_node_origins_.clear();
   while (tree_end > 0) {
     path_node_origins_.push_back(tree_end);
-    path_node_positions_.push_back(tree_[tree_end].getPosition());
-    tree_end = tree_[tree_end].origin_;
+    path_node_positions_.push_back(tree_.getPosition(tree_end));
+    tree_end = tree_.origin_[tree_end];
   }
-  path_node_positions_.push_back(tree_[0].getPosition());
+  path_node_positions_.push_back(tree_.getPosition(0));
   path_node_origins_.push_back(0);
   tree_age_ = 0;
 
-  ROS_INFO(
-      "\033[0;35m[SP]Tree (%.0f nodes, %.0f path nodes, %.0f expanded) "
-      "calculated in %2.2fms.\033[0m",
+  // the build time is published as the tree build stage on /diagnostics
+  ROS_DEBUG(
+      "\033[0;35m[SP]Tree (%.0f nodes, %.0f path nodes, %.0f expanded)\033[0m",
       (double)tree_.size(), (double)path_node_positions_.size(),
-      (double)closed_set_.size(),
-      (std::clock() - start_time) / (double)(CLOCKS_PER_SEC / 1000));
+      (double)closed_set_.size());
   for (int j = 0; j < path_node_positions_.size(); j++) {
     ROS_DEBUG("\033[0;35m[SP] node %.0f : [ %f, %f, %f]\033[0m", (double)j,
               (double)path_node_positions_[j].x(),
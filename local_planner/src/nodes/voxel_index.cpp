@@ -0,0 +1,106 @@
+#include "local_planner/voxel_index.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace avoidance {
+
+VoxelIndex::VoxelIndex(float voxel_size) : voxel_size_{voxel_size} {}
+
+void VoxelIndex::build(const pcl::PointCloud<pcl::PointXYZI>& cloud) {
+  std::vector<std::pair<int64_t, int>> keys;
+  keys.reserve(cloud.points.size());
+  for (size_t i = 0; i < cloud.points.size(); i++) {
+    const pcl::PointXYZI& p = cloud.points[i];
+    Eigen::Vector3i v = voxelCoordinates(p.x, p.y, p.z);
+    keys.push_back(std::make_pair(voxelKey(v.x(), v.y(), v.z()), i));
+  }
+  std::sort(keys.begin(), keys.end());
+
+  points_.points.clear();
+  points_.points.reserve(keys.size());
+  voxels_.clear();
+  voxels_.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (i == 0 || keys[i].first != keys[i - 1].first) {
+      voxels_[keys[i].first] = std::make_pair(i, i);
+    }
+    voxels_[keys[i].first].second = i + 1;
+    points_.points.push_back(cloud.points[keys[i].second]);
+  }
+  points_.width = points_.points.size();
+  points_.height = 1;
+}
+
+void VoxelIndex::getPointsWithinRadius(
+    const Eigen::Vector3f& center, float radius,
+    pcl::PointCloud<pcl::PointXYZI>& cloud) const {
+  cloud.points.clear();
+  const float radius_sq = radius * radius;
+  Eigen::Vector3i min_voxel = voxelCoordinates(
+      center.x() - radius, center.y() - radius, center.z() - radius);
+  Eigen::Vector3i max_voxel = voxelCoordinates(
+      center.x() + radius, center.y() + radius, center.z() + radius);
+
+  for (int x = min_voxel.x(); x <= max_voxel.x(); x++) {
+    for (int y = min_voxel.y(); y <= max_voxel.y(); y++) {
+      for (int z = min_voxel.z(); z <= max_voxel.z(); z++) {
+        auto voxel = voxels_.find(voxelKey(x, y, z));
+        if (voxel == voxels_.end()) continue;
+        for (int i = voxel->second.first; i < voxel->second.second; i++) {
+          const pcl::PointXYZI& p = points_.points[i];
+          float dx = p.x - center.x();
+          float dy = p.y - center.y();
+          float dz = p.z - center.z();
+          if (dx * dx + dy * dy + dz * dz < radius_sq) {
+            cloud.points.push_back(p);
+          }
+        }
+      }
+    }
+  }
+  cloud.width = cloud.points.size();
+  cloud.height = 1;
+}
+
+bool VoxelIndex::isSegmentFree(const Eigen::Vector3f& start,
+                               const Eigen::Vector3f& end,
+                               float clearance) const {
+  const float clearance_sq = clearance * clearance;
+  const Eigen::Vector3f segment = end - start;
+  const float length_sq = segment.squaredNorm();
+  Eigen::Vector3f lower = start.cwiseMin(end).array() - clearance;
+  Eigen::Vector3f upper = start.cwiseMax(end).array() + clearance;
+  Eigen::Vector3i min_voxel =
+      voxelCoordinates(lower.x(), lower.y(), lower.z());
+  Eigen::Vector3i max_voxel =
+      voxelCoordinates(upper.x(), upper.y(), upper.z());
+
+  for (int x = min_voxel.x(); x <= max_voxel.x(); x++) {
+    for (int y = min_voxel.y(); y <= max_voxel.y(); y++) {
+      for (int z = min_voxel.z(); z <= max_voxel.z(); z++) {
+        auto voxel = voxels_.find(voxelKey(x, y, z));
+        if (voxel == voxels_.end()) continue;
+        for (int i = voxel->second.first; i < voxel->second.second; i++) {
+          const pcl::PointXYZI& p = points_.points[i];
+          Eigen::Vector3f to_point = Eigen::Vector3f(p.x, p.y, p.z) - start;
+          // project the point onto the segment and clamp to its end points
+          float t = 0.f;
+          if (length_sq > 0.f) {
+            t = std::min(1.f,
+                         std::max(0.f, to_point.dot(segment) / length_sq));
+          }
+          if ((to_point - t * segment).squaredNorm() < clearance_sq) {
+            // a point already within the clearance of the start only blocks
+            // the segments approaching it, otherwise it would block all
+            if (to_point.squaredNorm() >= clearance_sq || t > 0.f) {
+              return false;
+            }
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+}
@@ -0,0 +1,64 @@
+#include "local_planner/worker_pool.h"
+
+#include <algorithm>
+
+namespace avoidance {
+
+WorkerPool::WorkerPool(unsigned int n_threads)
+    : n_threads_{std::max(1u, n_threads)} {
+  for (unsigned int i = 1; i < n_threads_; i++) {
+    threads_.emplace_back(&WorkerPool::workerLoop, this, i);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::run(const std::function<void(unsigned int)>& task) {
+  if (threads_.empty()) {
+    task(0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    n_running_ = threads_.size();
+    generation_++;
+  }
+  start_cv_.notify_all();
+  task(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this] { return n_running_ == 0; });
+  task_ = nullptr;
+}
+
+void WorkerPool::workerLoop(unsigned int index) {
+  uint64_t generation = 0;
+  while (true) {
+    const std::function<void(unsigned int)>* task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cv_.wait(lock,
+                     [&] { return stop_ || generation_ != generation; });
+      if (stop_) return;
+      generation = generation_;
+      task = task_;
+    }
+    (*task)(index);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      n_running_--;
+    }
+    done_cv_.notify_one();
+  }
+}
+}
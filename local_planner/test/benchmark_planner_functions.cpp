@@ -0,0 +1,997 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/common.h"
+#include "../include/local_planner/layered_depth_memory.h"
+#include "../include/local_planner/planner_functions.h"
+#include "../include/local_planner/pointcloud_ingestion.h"
+#include "../include/local_planner/polar_binning.h"
+#include "../include/local_planner/stage_timer.h"
+#include "../include/local_planner/triple_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace avoidance;
+
+namespace {
+
+// direct convolution with the conic kernel, as smoothPolarMatrix used to do
+void smoothPolarMatrixReference(Eigen::MatrixXf& matrix,
+                                unsigned int smoothing_radius) {
+  Eigen::MatrixXf matrix_padded;
+  padPolarMatrix(matrix, smoothing_radius, matrix_padded);
+  Eigen::ArrayXf kernel1d = getConicKernel(smoothing_radius);
+
+  Eigen::ArrayXf temp_col(matrix_padded.rows());
+  for (int col_index = 0; col_index < matrix_padded.cols(); col_index++) {
+    temp_col = matrix_padded.col(col_index);
+    for (int row_index = 0; row_index < matrix.rows(); row_index++) {
+      float smooth_val =
+          (temp_col.segment(row_index, 2 * smoothing_radius + 1) * kernel1d)
+              .sum();
+      matrix_padded(row_index + smoothing_radius, col_index) = smooth_val;
+    }
+  }
+
+  Eigen::ArrayXf temp_row(matrix_padded.cols());
+  for (int row_index = 0; row_index < matrix.rows(); row_index++) {
+    temp_row = matrix_padded.row(row_index + smoothing_radius);
+    for (int col_index = 0; col_index < matrix.cols(); col_index++) {
+      float smooth_val =
+          (temp_row.segment(col_index, 2 * smoothing_radius + 1) * kernel1d)
+              .sum();
+      matrix(row_index, col_index) = smooth_val;
+    }
+  }
+}
+
+// bounded max-heap over all cells, as getBestCandidatesFromCostMatrix used to
+// do
+void getBestCandidatesReference(
+    const Eigen::MatrixXf& matrix, unsigned int number_of_candidates,
+    std::vector<candidateDirection>& candidate_vector) {
+  std::priority_queue<candidateDirection, std::vector<candidateDirection>,
+                      std::less<candidateDirection>>
+      queue;
+  const int resolution = 180 / matrix.rows();
+  for (int row_index = 0; row_index < matrix.rows(); row_index++) {
+    for (int col_index = 0; col_index < matrix.cols(); col_index++) {
+      PolarPoint p_pol =
+          histogramIndexToPolar(row_index, col_index, resolution, 1.0);
+      candidateDirection candidate(matrix(row_index, col_index), p_pol.e,
+                                   p_pol.z);
+      if (queue.size() < number_of_candidates) {
+        queue.push(candidate);
+      } else if (candidate < queue.top()) {
+        queue.push(candidate);
+        queue.pop();
+      }
+    }
+  }
+  candidate_vector.clear();
+  while (!queue.empty()) {
+    candidate_vector.push_back(queue.top());
+    queue.pop();
+  }
+  std::reverse(candidate_vector.begin(), candidate_vector.end());
+}
+
+Eigen::MatrixXf randomMatrix() {
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> cost(0.f, 700.f);
+  Eigen::MatrixXf matrix(GRID_LENGTH_E, GRID_LENGTH_Z);
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    for (int z = 0; z < GRID_LENGTH_Z; z++) {
+      matrix(e, z) = cost(generator);
+    }
+  }
+  return matrix;
+}
+
+// obstacle points scattered around the vehicle at 2 to 10m distance
+pcl::PointCloud<pcl::PointXYZI> randomCloud(const Eigen::Vector3f& position,
+                                            size_t n_points) {
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> elevation(-90.f, 90.f);
+  std::uniform_real_distribution<float> azimuth(-180.f, 180.f);
+  std::uniform_real_distribution<float> radius(2.f, 10.f);
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  for (size_t i = 0; i < n_points; i++) {
+    PolarPoint p_pol(elevation(generator), azimuth(generator),
+                     radius(generator));
+    cloud.push_back(toXYZI(polarToCartesian(p_pol, position), 0.f));
+  }
+  return cloud;
+}
+
+// times histogram generation and cost matrix evaluation at resolution RES and
+// measures how far the cheapest direction is off from the goal direction when
+// nothing is in the way
+template <int RES>
+void resolutionSweep(const pcl::PointCloud<pcl::PointXYZI>& cloud,
+                     const Eigen::Vector3f& position,
+                     const std::vector<Eigen::Vector3f>& goals) {
+  const int repetitions = 200;
+  costParameters cost_params;
+  Eigen::MatrixXf cost_matrix;
+
+  double histogram_us = 0.0;
+  double cost_us = 0.0;
+  for (int i = 0; i < repetitions; i++) {
+    PolarHistogram<RES> histogram;
+    auto start = std::chrono::steady_clock::now();
+    generateNewHistogram(histogram, cloud, position);
+    auto end = std::chrono::steady_clock::now();
+    histogram_us +=
+        std::chrono::duration<double, std::micro>(end - start).count();
+
+    start = std::chrono::steady_clock::now();
+    getCostMatrix(histogram, goals[i % goals.size()], position, 0.f,
+                  goals[i % goals.size()], cost_params, false, 40.f,
+                  cost_matrix);
+    end = std::chrono::steady_clock::now();
+    cost_us += std::chrono::duration<double, std::micro>(end - start).count();
+  }
+
+  float error_sum = 0.f;
+  float error_max = 0.f;
+  const PolarHistogram<RES> empty_histogram;
+  std::vector<candidateDirection> candidates;
+  for (const Eigen::Vector3f& goal : goals) {
+    getCostMatrix(empty_histogram, goal, position, 0.f, goal, cost_params,
+                  false, 40.f, cost_matrix);
+    getBestCandidatesFromCostMatrix(cost_matrix, 1, candidates);
+    Eigen::Vector3f best = polarToCartesian(
+        PolarPoint(candidates[0].elevation_angle, candidates[0].azimuth_angle,
+                   1.f),
+        Eigen::Vector3f::Zero());
+    float error = std::acos(std::min(
+                      1.f, best.dot((goal - position).normalized()))) *
+                  RAD_TO_DEG;
+    error_sum += error;
+    error_max = std::max(error_max, error);
+  }
+
+  std::printf("%10d %10d %15.2f %15.2f %12.2f %12.2f\n", RES,
+              PolarHistogram<RES>::e_dim * PolarHistogram<RES>::z_dim,
+              histogram_us / repetitions, cost_us / repetitions,
+              error_sum / goals.size(), error_max);
+  EXPECT_LT(error_max, 2.f * RES);
+}
+}
+
+TEST(PlannerFunctionsBenchmark, smoothPolarMatrixVsRadius) {
+  const int repetitions = 1000;
+  const Eigen::MatrixXf input = randomMatrix();
+
+  std::printf("%10s %15s %15s %10s\n", "radius", "kernel [us]",
+              "box [us]", "speedup");
+  for (unsigned int radius : {1, 3, 5, 7, 10, 15}) {
+    Eigen::MatrixXf reference = input;
+    Eigen::MatrixXf matrix = input;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++) {
+      reference = input;
+      smoothPolarMatrixReference(reference, radius);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double kernel_us =
+        std::chrono::duration<double, std::micro>(end - start).count() /
+        repetitions;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++) {
+      matrix = input;
+      smoothPolarMatrix(matrix, radius);
+    }
+    end = std::chrono::steady_clock::now();
+    double box_us =
+        std::chrono::duration<double, std::micro>(end - start).count() /
+        repetitions;
+
+    std::printf("%10u %15.2f %15.2f %9.1fx\n", radius, kernel_us, box_us,
+                kernel_us / box_us);
+    EXPECT_LT((reference - matrix).cwiseAbs().maxCoeff(),
+              1e-5f * reference.cwiseAbs().maxCoeff());
+  }
+}
+
+TEST(PlannerFunctionsBenchmark, bestCandidatesVsK) {
+  const int repetitions = 2000;
+  const Eigen::MatrixXf matrix = randomMatrix();
+  std::vector<candidateDirection> reference, candidates;
+
+  std::printf("%10s %15s %15s %10s\n", "k", "heap [us]", "select [us]",
+              "speedup");
+  for (unsigned int k : {1, 5, 10, 25, 50, 100, 200, 500}) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++) {
+      getBestCandidatesReference(matrix, k, reference);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double heap_us =
+        std::chrono::duration<double, std::micro>(end - start).count() /
+        repetitions;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++) {
+      getBestCandidatesFromCostMatrix(matrix, k, candidates);
+    }
+    end = std::chrono::steady_clock::now();
+    double select_us =
+        std::chrono::duration<double, std::micro>(end - start).count() /
+        repetitions;
+
+    std::printf("%10u %15.2f %15.2f %9.1fx\n", k, heap_us, select_us,
+                heap_us / select_us);
+    ASSERT_EQ(reference.size(), candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++) {
+      EXPECT_FLOAT_EQ(reference[i].cost, candidates[i].cost);
+      EXPECT_FLOAT_EQ(reference[i].elevation_angle,
+                      candidates[i].elevation_angle);
+      EXPECT_FLOAT_EQ(reference[i].azimuth_angle, candidates[i].azimuth_angle);
+    }
+  }
+}
+
+TEST(PlannerFunctionsBenchmark, processPointcloudScaling) {
+  // three cameras at 640x480 pixels, looking forward, left and right
+  const int repetitions = 10;
+  const Eigen::Vector3f position(0.f, 0.f, 2.f);
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> elevation(-21.f, 21.f);
+  std::uniform_real_distribution<float> azimuth(-43.f, 43.f);
+  std::uniform_real_distribution<float> radius(0.5f, 15.f);
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(3);
+  for (size_t camera = 0; camera < complete_cloud.size(); camera++) {
+    for (int i = 0; i < 640 * 480; i++) {
+      PolarPoint p_pol(elevation(generator),
+                       azimuth(generator) + 90.f * camera - 90.f,
+                       radius(generator));
+      complete_cloud[camera].push_back(
+          toXYZ(polarToCartesian(p_pol, position)));
+    }
+  }
+  Box histogram_box(12.f);
+  histogram_box.setBoxLimits(position, 2.f);
+
+  const unsigned int max_threads =
+      std::max(4u, std::thread::hardware_concurrency());
+  std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+  std::printf("%10s %15s %10s %10s\n", "threads", "process [ms]", "speedup",
+              "points");
+  double serial_ms = 0.0;
+  pcl::PointCloud<pcl::PointXYZI> serial_cloud;
+  for (unsigned int n_threads = 1; n_threads <= max_threads; n_threads++) {
+    WorkerPool pool(n_threads);
+    double process_ms = 0.0;
+    pcl::PointCloud<pcl::PointXYZI> final_cloud;
+    for (int i = 0; i < repetitions; i++) {
+      ObstacleMemory memory(0.1f);
+      auto start = std::chrono::steady_clock::now();
+      processPointcloud(final_cloud, complete_cloud, histogram_box, position,
+                        0.2f, 20.f, memory, 0.0, &pool);
+      auto end = std::chrono::steady_clock::now();
+      process_ms +=
+          std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    process_ms /= repetitions;
+    if (n_threads == 1) {
+      serial_ms = process_ms;
+      serial_cloud = final_cloud;
+    }
+    std::printf("%10u %15.3f %9.1fx %10zu\n", n_threads, process_ms,
+                serial_ms / process_ms, final_cloud.size());
+    EXPECT_EQ(serial_cloud.size(), final_cloud.size());
+  }
+}
+
+TEST(PlannerFunctionsBenchmark, polarBinningVsScalar) {
+  const int repetitions = 20;
+  const Eigen::Vector3f position(0.f, 0.f, 2.f);
+  const pcl::PointCloud<pcl::PointXYZI> cloud = randomCloud(position, 100000);
+  const size_t n = cloud.size();
+  std::vector<float> x(n), y(n), z(n), range(n);
+  std::vector<int> e_index(n), z_index(n);
+  for (size_t i = 0; i < n; i++) {
+    x[i] = cloud.points[i].x;
+    y[i] = cloud.points[i].y;
+    z[i] = cloud.points[i].z;
+  }
+
+  std::printf("instruction set: %s\n", polarBinningInstructionSet());
+  std::printf("%10s %15s %15s %10s\n", "res [deg]", "scalar [ns/pt]",
+              "batch [ns/pt]", "speedup");
+  for (int res : {3, 6}) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++) {
+      for (size_t i = 0; i < n; i++) {
+        PolarPoint p_pol = cartesianToPolar(x[i], y[i], z[i], position);
+        Eigen::Vector2i p_ind = polarToHistogramIndex(p_pol, res);
+        e_index[i] = p_ind.y();
+        z_index[i] = p_ind.x();
+        range[i] = p_pol.r;
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double scalar_ns =
+        std::chrono::duration<double, std::nano>(end - start).count() /
+        (repetitions * n);
+    const std::vector<int> scalar_e_index = e_index;
+    const std::vector<int> scalar_z_index = z_index;
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++) {
+      cartesianToHistogramIndices(x.data(), y.data(), z.data(), n, position,
+                                  res, e_index.data(), z_index.data(),
+                                  range.data());
+    }
+    end = std::chrono::steady_clock::now();
+    double batch_ns =
+        std::chrono::duration<double, std::nano>(end - start).count() /
+        (repetitions * n);
+
+    std::printf("%10d %15.2f %15.2f %9.1fx\n", res, scalar_ns, batch_ns,
+                scalar_ns / batch_ns);
+    EXPECT_TRUE(scalar_e_index == e_index);
+    EXPECT_TRUE(scalar_z_index == z_index);
+  }
+
+  std::printf("%10s %15s\n", "points", "histogram [us]");
+  for (size_t n_points : {1000, 10000, 100000}) {
+    const pcl::PointCloud<pcl::PointXYZI> histogram_cloud =
+        randomCloud(position, n_points);
+    Histogram histogram;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++) {
+      generateNewHistogram(histogram, histogram_cloud, position);
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::printf(
+        "%10zu %15.2f\n", n_points,
+        std::chrono::duration<double, std::micro>(end - start).count() /
+            repetitions);
+  }
+}
+
+TEST(PlannerFunctionsBenchmark, binningTableVsVoxelSize) {
+  const int repetitions = 20;
+  const float radius = 12.f;
+  const Eigen::Vector3f position(0.f, 0.f, 2.f);
+  const pcl::PointCloud<pcl::PointXYZI> cloud = randomCloud(position, 100000);
+  const size_t n = cloud.size();
+  std::vector<float> x(n), y(n), z(n), range(n);
+  std::vector<int> e_index(n), z_index(n);
+  for (size_t i = 0; i < n; i++) {
+    x[i] = cloud.points[i].x;
+    y[i] = cloud.points[i].y;
+    z[i] = cloud.points[i].z;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; i++) {
+    PolarPoint p_pol = cartesianToPolar(x[i], y[i], z[i], position);
+    Eigen::Vector2i p_ind = polarToHistogramIndex(p_pol, ALPHA_RES / 2);
+    e_index[i] = p_ind.y();
+    z_index[i] = p_ind.x();
+  }
+  auto end = std::chrono::steady_clock::now();
+  std::printf(
+      "scalar: %.2f ns/pt\n",
+      std::chrono::duration<double, std::nano>(end - start).count() / n);
+
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repetitions; r++) {
+    cartesianToHistogramIndices(x.data(), y.data(), z.data(), n, position,
+                                ALPHA_RES / 2, e_index.data(), z_index.data(),
+                                range.data());
+  }
+  end = std::chrono::steady_clock::now();
+  const double batch_ns =
+      std::chrono::duration<double, std::nano>(end - start).count() /
+      (repetitions * n);
+  const std::vector<int> batch_e_index = e_index;
+  const std::vector<int> batch_z_index = z_index;
+  std::printf("batch kernel (%s): %.2f ns/pt\n", polarBinningInstructionSet(),
+              batch_ns);
+
+  std::printf("%10s %12s %12s %12s %12s %15s %10s\n", "voxel [m]",
+              "memory [MB]", "build [ms]", "voxels [%]", "points [%]",
+              "table [ns/pt]", "speedup");
+  // 0.05m needs 221MB and several seconds to build
+  for (float voxel_size : {0.4f, 0.2f, 0.1f}) {
+    start = std::chrono::steady_clock::now();
+    const PolarBinningTable table(radius, voxel_size, ALPHA_RES / 2);
+    end = std::chrono::steady_clock::now();
+    const double build_ms =
+        std::chrono::duration<double, std::milli>(end - start).count();
+
+    size_t resolved = 0;
+    for (size_t i = 0; i < n; i++) {
+      int e, a;
+      resolved += table.lookup(x[i] - position.x(), y[i] - position.y(),
+                               z[i] - position.z(), ALPHA_RES / 2, e, a);
+    }
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++) {
+      cartesianToHistogramIndices(table, x.data(), y.data(), z.data(), n,
+                                  position, ALPHA_RES / 2, e_index.data(),
+                                  z_index.data(), range.data());
+    }
+    end = std::chrono::steady_clock::now();
+    const double table_ns =
+        std::chrono::duration<double, std::nano>(end - start).count() /
+        (repetitions * n);
+
+    std::printf("%10.2f %12.2f %12.1f %12.1f %12.1f %15.2f %9.1fx\n",
+                voxel_size, table.memoryFootprint() / 1e6, build_ms,
+                100.f * table.resolvedFraction(), 100.f * resolved / n,
+                table_ns, batch_ns / table_ns);
+    EXPECT_TRUE(batch_e_index == e_index);
+    EXPECT_TRUE(batch_z_index == z_index);
+  }
+}
+
+TEST(PlannerFunctionsBenchmark, obstacleMemoryVsSize) {
+  // one camera frame per cycle, the memory is filled with points inside and
+  // outside of the histogram box beforehand
+  const int repetitions = 20;
+  const Eigen::Vector3f position(0.f, 0.f, 2.f);
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> elevation(-21.f, 21.f);
+  std::uniform_real_distribution<float> azimuth(-43.f, 43.f);
+  std::uniform_real_distribution<float> radius(0.5f, 15.f);
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1);
+  for (int i = 0; i < 640 * 480; i++) {
+    PolarPoint p_pol(elevation(generator), azimuth(generator),
+                     radius(generator));
+    complete_cloud[0].push_back(toXYZ(polarToCartesian(p_pol, position)));
+  }
+  Box histogram_box(12.f);
+  histogram_box.setBoxLimits(position, 2.f);
+
+  std::uniform_real_distribution<float> inside(-12.f, 12.f);
+  std::uniform_real_distribution<float> outside(100.f, 500.f);
+  std::uniform_real_distribution<float> height(0.f, 20.f);
+  std::printf("%12s %12s %15s %12s\n", "outside box", "inside box",
+              "process [ms]", "points");
+  for (size_t n_outside : {0, 100000, 1000000}) {
+    for (size_t n_inside : {0, 10000, 50000}) {
+      pcl::PointCloud<pcl::PointXYZI> remembered;
+      for (size_t i = 0; i < n_outside; i++) {
+        remembered.push_back(toXYZI(outside(generator), outside(generator),
+                                    height(generator), 0.f));
+      }
+      for (size_t i = 0; i < n_inside; i++) {
+        remembered.push_back(toXYZI(inside(generator), inside(generator),
+                                    position.z() + inside(generator) / 3.f,
+                                    0.f));
+      }
+
+      double process_ms = 0.0;
+      pcl::PointCloud<pcl::PointXYZI> final_cloud;
+      for (int r = 0; r < repetitions; r++) {
+        ObstacleMemory memory(0.1f);
+        memory.insert(remembered, 0.0);
+        auto start = std::chrono::steady_clock::now();
+        processPointcloud(final_cloud, complete_cloud, histogram_box, position,
+                          0.2f, 1000.f, memory, 1.0);
+        auto end = std::chrono::steady_clock::now();
+        process_ms +=
+            std::chrono::duration<double, std::milli>(end - start).count();
+      }
+      std::printf("%12zu %12zu %15.3f %12zu\n", n_outside, n_inside,
+                  process_ms / repetitions, final_cloud.size());
+    }
+  }
+}
+
+TEST(PlannerFunctionsBenchmark, layeredDepthMemoryVsProcessPointcloud) {
+  // the vehicle flies sideways past a wall with pillars, one camera frame per
+  // cycle sees the obstacles within its field of view
+  const int cycles = 40;
+  const float cycle_s = 0.1f;
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> along(-20.f, 20.f);
+  std::uniform_real_distribution<float> height(0.f, 6.f);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  std::vector<Eigen::Vector3f> world;
+  for (int i = 0; i < 200000; i++) {
+    world.push_back(Eigen::Vector3f(8.f, along(generator), height(generator)));
+  }
+  for (int pillar = 0; pillar < 10; pillar++) {
+    const Eigen::Vector2f center(2.f + unit(generator) * 5.f,
+                                 along(generator));
+    for (int i = 0; i < 20000; i++) {
+      const float angle = unit(generator) * 2.f * M_PI_F;
+      world.push_back(Eigen::Vector3f(center.x() + 0.3f * std::cos(angle),
+                                      center.y() + 0.3f * std::sin(angle),
+                                      height(generator)));
+    }
+  }
+
+  std::printf("%10s %12s %12s %12s %12s %12s %12s\n", "layers",
+              "cycle [ms]", "memory [kB]", "buffers [kB]", "points",
+              "occupancy", "range [m]");
+  for (int n_layers : {0, 1, 2, 4}) {
+    ObstacleMemory obstacle_memory(0.1f);
+    LayeredDepthMemory layered_memory(std::max(1, n_layers));
+    ObstacleMemory reference_memory(0.1f);
+    double cycle_ms = 0.0;
+    size_t memory_bytes = 0;
+    float occupancy_agreement = 0.f;
+    float range_difference = 0.f;
+    pcl::PointCloud<pcl::PointXYZI> final_cloud, reference_cloud;
+    for (int cycle = 0; cycle < cycles; cycle++) {
+      const Eigen::Vector3f position(0.f, -10.f + 0.5f * cycle, 2.f);
+      Box histogram_box(12.f);
+      histogram_box.setBoxLimits(position, 2.f);
+      std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1);
+      for (const Eigen::Vector3f& point : world) {
+        PolarPoint p_pol = cartesianToPolar(point, position);
+        if (std::abs(p_pol.e) < 21.f && std::abs(p_pol.z - 90.f) < 43.f &&
+            p_pol.r < 15.f) {
+          complete_cloud[0].push_back(toXYZ(point));
+        }
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      if (n_layers == 0) {
+        processPointcloud(final_cloud, complete_cloud, histogram_box,
+                          position, 0.2f, 20.f, obstacle_memory,
+                          cycle * cycle_s);
+      } else {
+        layered_memory.update(complete_cloud, histogram_box, position, 0.2f,
+                              20.f, cycle_s);
+        layered_memory.getPoints(final_cloud);
+      }
+      auto end = std::chrono::steady_clock::now();
+      cycle_ms +=
+          std::chrono::duration<double, std::milli>(end - start).count();
+
+      // the histograms are compared to the ones of processPointcloud
+      processPointcloud(reference_cloud, complete_cloud, histogram_box,
+                        position, 0.2f, 20.f, reference_memory,
+                        cycle * cycle_s);
+      Histogram histogram, reference_histogram;
+      generateNewHistogram(histogram, final_cloud, position);
+      generateNewHistogram(reference_histogram, reference_cloud, position);
+      int agreeing = 0, occupied = 0;
+      float difference = 0.f;
+      for (int e = 0; e < Histogram::e_dim; e++) {
+        for (int z = 0; z < Histogram::z_dim; z++) {
+          const float dist = histogram.get_dist(e, z);
+          const float reference_dist = reference_histogram.get_dist(e, z);
+          agreeing += (dist > 0.f) == (reference_dist > 0.f);
+          if (dist > 0.f && reference_dist > 0.f) {
+            difference += std::abs(dist - reference_dist);
+            occupied++;
+          }
+        }
+      }
+      occupancy_agreement +=
+          static_cast<float>(agreeing) / (Histogram::e_dim * Histogram::z_dim);
+      range_difference += occupied > 0 ? difference / occupied : 0.f;
+    }
+
+    // the voxel memory is estimated as a hash node per voxel holding the
+    // point, its timestamp, the key and two pointers, the final cloud of
+    // processPointcloud is reserved for one point per subsampling cell
+    memory_bytes =
+        n_layers == 0
+            ? final_cloud.points.capacity() * sizeof(pcl::PointXYZI) +
+                  obstacle_memory.size() *
+                      (3 * sizeof(float) + sizeof(double) + sizeof(int) +
+                       2 * sizeof(void*))
+            : layered_memory.memoryFootprint();
+    const size_t buffer_bytes =
+        n_layers == 0 ? 0 : layered_memory.bufferFootprint();
+    std::printf("%10d %12.3f %12.1f %12.1f %12zu %11.1f%% %12.3f\n",
+                n_layers, cycle_ms / cycles, memory_bytes / 1024.f,
+                buffer_bytes / 1024.f, final_cloud.size(),
+                100.f * occupancy_agreement / cycles,
+                range_difference / cycles);
+  }
+}
+
+TEST(PlannerFunctionsBenchmark, pointcloudIngestion) {
+  // 640x480 organized depth camera cloud with 20% invalid pixels, compared
+  // to copying the message and running deserialisation, NaN removal and the
+  // transform as separate passes
+  const int repetitions = 20;
+  const int width = 640, height = 480;
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  sensor_msgs::PointCloud2 msg;
+  msg.width = width;
+  msg.height = height;
+  const char* names[] = {"x", "y", "z"};
+  for (int i = 0; i < 3; i++) {
+    sensor_msgs::PointField field;
+    field.name = names[i];
+    field.offset = 4 * i;
+    field.datatype = sensor_msgs::PointField::FLOAT32;
+    field.count = 1;
+    msg.fields.push_back(field);
+  }
+  msg.point_step = 16;
+  msg.row_step = msg.point_step * width;
+  msg.data.resize(msg.row_step * height);
+  for (int i = 0; i < width * height; i++) {
+    const float depth =
+        unit(generator) < 0.2f ? NAN : 1.f + 10.f * unit(generator);
+    const float xyz[3] = {depth * (unit(generator) - 0.5f),
+                          depth * (unit(generator) - 0.5f), depth};
+    std::memcpy(&msg.data[i * msg.point_step], xyz, sizeof(xyz));
+  }
+  const Eigen::Affine3f transform =
+      Eigen::Translation3f(1.f, 2.f, 3.f) *
+      Eigen::AngleAxisf(0.3f, Eigen::Vector3f::UnitZ());
+
+  double separate_ms = 0.0;
+  size_t separate_points = 0;
+  for (int r = 0; r < repetitions; r++) {
+    auto start = std::chrono::steady_clock::now();
+    sensor_msgs::PointCloud2 copy = msg;
+    pcl::PointCloud<pcl::PointXYZ> cloud, dense, transformed;
+    cloud.points.resize(copy.width * copy.height);
+    for (size_t i = 0; i < cloud.points.size(); i++) {
+      std::memcpy(&cloud.points[i].x, &copy.data[i * copy.point_step],
+                  3 * sizeof(float));
+    }
+    for (const pcl::PointXYZ& p : cloud) {
+      if (!std::isnan(p.x) && !std::isnan(p.y) && !std::isnan(p.z)) {
+        dense.points.push_back(p);
+      }
+    }
+    transformed.points.resize(dense.points.size());
+    for (size_t i = 0; i < dense.points.size(); i++) {
+      transformed.points[i] = toXYZ(transform * toEigen(dense.points[i]));
+    }
+    auto end = std::chrono::steady_clock::now();
+    separate_ms +=
+        std::chrono::duration<double, std::milli>(end - start).count();
+    separate_points = transformed.points.size();
+  }
+
+  std::printf("%20s %12s %12s\n", "", "time [ms]", "points");
+  std::printf("%20s %12.3f %12zu\n", "separate passes",
+              separate_ms / repetitions, separate_points);
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (int stride : {1, 2, 4}) {
+    ingestionParameters params;
+    params.max_range = 13.f;
+    params.row_stride = stride;
+    params.column_stride = stride;
+    double fused_ms = 0.0;
+    for (int r = 0; r < repetitions; r++) {
+      auto start = std::chrono::steady_clock::now();
+      ingestPointCloud(msg, transform, params, cloud);
+      auto end = std::chrono::steady_clock::now();
+      fused_ms +=
+          std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    std::printf("%17s %2d %12.3f %12zu\n", "fused, stride", stride,
+                fused_ms / repetitions, cloud.size());
+  }
+
+  // the same scene as a 16UC1 depth image, back-projected without the
+  // intermediate pointcloud message
+  sensor_msgs::Image image;
+  image.width = width;
+  image.height = height;
+  image.encoding = "16UC1";
+  image.step = width * sizeof(uint16_t);
+  image.data.resize(image.step * height);
+  for (int i = 0; i < width * height; i++) {
+    float depth;
+    std::memcpy(&depth, &msg.data[i * msg.point_step + 8], sizeof(float));
+    const uint16_t depth_mm =
+        std::isnan(depth) ? 0 : static_cast<uint16_t>(1000.f * depth);
+    std::memcpy(&image.data[i * sizeof(uint16_t)], &depth_mm,
+                sizeof(uint16_t));
+  }
+  sensor_msgs::CameraInfo info;
+  info.K = {{320.0, 0.0, 320.0, 0.0, 320.0, 240.0, 0.0, 0.0, 1.0}};
+  ingestionParameters params;
+  params.max_range = 13.f;
+  double image_ms = 0.0;
+  for (int r = 0; r < repetitions; r++) {
+    auto start = std::chrono::steady_clock::now();
+    ingestDepthImage(image, info, transform, params, cloud);
+    auto end = std::chrono::steady_clock::now();
+    image_ms += std::chrono::duration<double, std::milli>(end - start).count();
+  }
+  std::printf("%20s %12.3f %12zu\n", "depth image", image_ms / repetitions,
+              cloud.size());
+
+  // strides from the pixel footprint against the ALPHA_RES / 2 bins
+  info.width = width;
+  info.height = height;
+  setAngularStride(info, width, height, ALPHA_RES / 2.f, params);
+  double angular_ms = 0.0;
+  for (int r = 0; r < repetitions; r++) {
+    auto start = std::chrono::steady_clock::now();
+    ingestDepthImage(image, info, transform, params, cloud);
+    auto end = std::chrono::steady_clock::now();
+    angular_ms +=
+        std::chrono::duration<double, std::milli>(end - start).count();
+  }
+  std::printf("%14s %2dx%-2d %12.3f %12zu\n", "angular stride",
+              params.row_stride, params.column_stride,
+              angular_ms / repetitions, cloud.size());
+}
+
+TEST(PlannerFunctionsBenchmark, pointcloudPrefilter) {
+  // thinning a 640x480 camera cloud in the transform thread against the time
+  // processPointcloud spends on the points it would otherwise receive
+  const int repetitions = 10;
+  const Eigen::Vector3f position(0.f, 0.f, 2.f);
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  pcl::PointCloud<pcl::PointXYZ> camera_cloud;
+  for (int i = 0; i < 640 * 480; i++) {
+    // a wall and a pole in front of the vehicle
+    const float depth = unit(generator) < 0.1f ? 3.f : 8.f;
+    camera_cloud.push_back(
+        pcl::PointXYZ(depth, depth * (unit(generator) - 0.5f),
+                      2.f + depth * (unit(generator) - 0.5f)));
+  }
+  Box histogram_box(12.f);
+  histogram_box.setBoxLimits(position, 2.f);
+  std::minstd_rand sample_generator(1);
+
+  std::printf("%20s %12s %12s %15s\n", "", "filter [ms]", "points",
+              "process [ms]");
+  for (float leaf_size : {0.f, 0.05f, 0.1f, 0.2f}) {
+    double filter_ms = 0.0, process_ms = 0.0;
+    size_t n_points = 0;
+    for (int r = 0; r < repetitions; r++) {
+      std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1,
+                                                                 camera_cloud);
+      auto start = std::chrono::steady_clock::now();
+      voxelPrefilter(leaf_size, complete_cloud[0]);
+      auto end = std::chrono::steady_clock::now();
+      filter_ms +=
+          std::chrono::duration<double, std::milli>(end - start).count();
+      n_points = complete_cloud[0].size();
+
+      pcl::PointCloud<pcl::PointXYZI> final_cloud;
+      ObstacleMemory memory(0.1f);
+      start = std::chrono::steady_clock::now();
+      processPointcloud(final_cloud, complete_cloud, histogram_box, position,
+                        0.2f, 20.f, memory, 0.0);
+      end = std::chrono::steady_clock::now();
+      process_ms +=
+          std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    std::printf("%15s %4.2f %12.3f %12zu %15.3f\n", "voxel leaf", leaf_size,
+                filter_ms / repetitions, n_points, process_ms / repetitions);
+  }
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1, camera_cloud);
+  auto start = std::chrono::steady_clock::now();
+  randomPrefilter(20000, sample_generator, complete_cloud[0]);
+  auto end = std::chrono::steady_clock::now();
+  std::printf("%20s %12.3f %12zu\n", "random sample",
+              std::chrono::duration<double, std::milli>(end - start).count(),
+              complete_cloud[0].size());
+}
+
+TEST(PlannerFunctionsBenchmark, histogramResolutionSweep) {
+  const Eigen::Vector3f position(0.f, 0.f, 2.f);
+  const pcl::PointCloud<pcl::PointXYZI> cloud = randomCloud(position, 10000);
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<float> elevation(-30.f, 30.f);
+  std::uniform_real_distribution<float> azimuth(-180.f, 180.f);
+  std::vector<Eigen::Vector3f> goals;
+  for (int i = 0; i < 100; i++) {
+    goals.push_back(polarToCartesian(
+        PolarPoint(elevation(generator), azimuth(generator), 20.f),
+        position));
+  }
+
+  std::printf("%10s %10s %15s %15s %12s %12s\n", "res [deg]", "cells",
+              "histogram [us]", "cost [us]", "mean [deg]", "max [deg]");
+  resolutionSweep<3>(cloud, position, goals);
+  resolutionSweep<6>(cloud, position, goals);
+  resolutionSweep<12>(cloud, position, goals);
+}
+
+TEST(PlannerFunctionsBenchmark, coarseToFineCandidates) {
+  // random scenes of pillar obstacles with goals in random directions, the
+  // candidates of the coarse-to-fine search are compared to the full search
+  const int n_scenes = 200;
+  const unsigned int n_candidates = 50;
+  std::mt19937 generator(3);
+  std::uniform_real_distribution<float> offset(-10.f, 10.f);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  const Eigen::Vector3f position(0.f, 0.f, 2.f);
+  costParameters cost_params;
+  cost_params.goal_cost_param = 10.f;
+  cost_params.heading_cost_param = 0.5f;
+  cost_params.smooth_cost_param = 1.5f;
+
+  double full_us = 0.0;
+  double pyramid_us = 0.0;
+  float angle_sum = 0.f;
+  float regret_sum = 0.f;
+  float regret_max = 0.f;
+  int same_cell = 0;
+  Eigen::MatrixXf cost_matrix;
+  std::vector<candidateDirection> full_candidates, pyramid_candidates;
+  for (int i = 0; i < n_scenes; i++) {
+    pcl::PointCloud<pcl::PointXYZI> cloud;
+    for (int pillar = 0; pillar < 15; pillar++) {
+      Eigen::Vector2f xy(offset(generator), offset(generator));
+      if (xy.norm() < 2.f) continue;
+      for (int point = 0; point < 100; point++) {
+        cloud.push_back(toXYZI(xy.x() + 0.3f * unit(generator),
+                               xy.y() + 0.3f * unit(generator),
+                               6.f * unit(generator), 0.f));
+      }
+    }
+    Histogram histogram;
+    generateNewHistogram(histogram, cloud, position);
+    Eigen::Vector3f goal(offset(generator), offset(generator), 2.f);
+    Eigen::Vector3f last_wp = position + 0.3f * (goal - position);
+    float yaw = 360.f * unit(generator) - 180.f;
+
+    auto start = std::chrono::steady_clock::now();
+    getCostMatrix(histogram, goal, position, yaw, last_wp, cost_params, false,
+                  40.f, cost_matrix);
+    getBestCandidatesFromCostMatrix(cost_matrix, n_candidates,
+                                    full_candidates);
+    auto end = std::chrono::steady_clock::now();
+    full_us += std::chrono::duration<double, std::micro>(end - start).count();
+
+    start = std::chrono::steady_clock::now();
+    getBestCandidatesCoarseToFine(histogram, goal, position, yaw, last_wp,
+                                  cost_params, 40.f, n_candidates,
+                                  pyramid_candidates);
+    end = std::chrono::steady_clock::now();
+    pyramid_us +=
+        std::chrono::duration<double, std::micro>(end - start).count();
+
+    // cost of the chosen direction in the full cost matrix
+    PolarPoint best_pol(pyramid_candidates[0].elevation_angle,
+                        pyramid_candidates[0].azimuth_angle, 1.f);
+    Eigen::Vector2i best_index = polarToHistogramIndex(best_pol, ALPHA_RES);
+    const float best_cost = full_candidates[0].cost;
+    float regret =
+        (cost_matrix(best_index.y(), best_index.x()) - best_cost) / best_cost;
+    Eigen::Vector3f full_dir = polarToCartesian(
+        PolarPoint(full_candidates[0].elevation_angle,
+                   full_candidates[0].azimuth_angle, 1.f),
+        Eigen::Vector3f::Zero());
+    Eigen::Vector3f pyramid_dir =
+        polarToCartesian(best_pol, Eigen::Vector3f::Zero());
+    angle_sum +=
+        std::acos(std::min(1.f, full_dir.dot(pyramid_dir))) * RAD_TO_DEG;
+    regret_sum += regret;
+    regret_max = std::max(regret_max, regret);
+    if (regret <= 0.f) same_cell++;
+  }
+
+  std::printf("%12s %14s %10s %12s %12s %12s %10s\n", "full [us]",
+              "pyramid [us]", "speedup", "angle [deg]", "regret mean",
+              "regret max", "optimal");
+  std::printf("%12.2f %14.2f %9.1fx %12.2f %11.1f%% %11.1f%% %9d%%\n",
+              full_us / n_scenes, pyramid_us / n_scenes, full_us / pyramid_us,
+              angle_sum / n_scenes, 100.f * regret_sum / n_scenes,
+              100.f * regret_max, 100 * same_cell / n_scenes);
+  EXPECT_LT(regret_sum / n_scenes, 0.05f);
+}
+
+TEST(PlannerFunctionsBenchmark, cloudHandoffWaiting) {
+  // a camera thread publishing a cloud every 33ms while the main loop asks
+  // for it every 10ms, as with a 30Hz camera and a 100Hz pose stream. The
+  // condition variable handoff waits up to 30ms for a transformed cloud, the
+  // triple buffer takes whatever is newest
+  const auto duration = std::chrono::milliseconds(1000);
+  const auto frame_period = std::chrono::milliseconds(33);
+  const auto loop_period = std::chrono::milliseconds(10);
+  using Clock = std::chrono::steady_clock;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool transformed = false;
+  std::atomic<bool> stop{false};
+  std::thread producer([&] {
+    while (!stop) {
+      std::this_thread::sleep_for(frame_period);
+      std::lock_guard<std::mutex> lk(mutex);
+      transformed = true;
+      cv.notify_one();
+    }
+  });
+  double wait_ms = 0.0, wait_max_ms = 0.0;
+  int clouds = 0, iterations = 0;
+  for (auto end = Clock::now() + duration; Clock::now() < end; iterations++) {
+    auto start = Clock::now();
+    {
+      std::unique_lock<std::mutex> lk(mutex);
+      cv.wait_for(lk, std::chrono::milliseconds(30),
+                  [&transformed] { return transformed; });
+      if (transformed) clouds++;
+      transformed = false;
+    }
+    const double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    wait_ms += ms;
+    wait_max_ms = std::max(wait_max_ms, ms);
+    std::this_thread::sleep_for(loop_period);
+  }
+  stop = true;
+  producer.join();
+  std::printf("%20s %12s %12s %12s %12s\n", "", "loop iter", "clouds",
+              "mean [ms]", "max [ms]");
+  std::printf("%20s %12d %12d %12.4f %12.4f\n", "condition variable",
+              iterations, clouds, wait_ms / iterations, wait_max_ms);
+
+  TripleBuffer<pcl::PointCloud<pcl::PointXYZ>> buffer;
+  stop = false;
+  std::thread buffer_producer([&] {
+    while (!stop) {
+      std::this_thread::sleep_for(frame_period);
+      buffer.writeBuffer().points.assign(1000, pcl::PointXYZ());
+      buffer.publish();
+    }
+  });
+  wait_ms = wait_max_ms = 0.0;
+  clouds = iterations = 0;
+  for (auto end = Clock::now() + duration; Clock::now() < end; iterations++) {
+    auto start = Clock::now();
+    if (buffer.update()) clouds++;
+    const double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    wait_ms += ms;
+    wait_max_ms = std::max(wait_max_ms, ms);
+    std::this_thread::sleep_for(loop_period);
+  }
+  stop = true;
+  buffer_producer.join();
+  std::printf("%20s %12d %12d %12.4f %12.4f\n", "triple buffer", iterations,
+              clouds, wait_ms / iterations, wait_max_ms);
+}
+
+TEST(PlannerFunctionsBenchmark, stageTimerOverhead) {
+  // cost of one timed scope, recorded from one thread and from four threads
+  // sharing the same stage histogram
+  const int n_scopes = 1000000;
+  using Clock = std::chrono::steady_clock;
+  std::printf("%20s %12s\n", "", "ns / scope");
+  for (int n_threads : {1, 4}) {
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+    for (int t = 0; t < n_threads; t++) {
+      threads.emplace_back([n_scopes] {
+        for (int i = 0; i < n_scopes; i++) {
+          ScopedStageTimer timer(Stage::kHistogram);
+        }
+      });
+    }
+    for (std::thread& t : threads) t.join();
+    const double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start)
+            .count();
+    char label[32];
+    std::snprintf(label, sizeof(label), "%d thread(s)", n_threads);
+    std::printf("%20s %12.1f\n", label, ns / n_scopes);
+  }
+  const stageStatistics stats = stageHistogram(Stage::kHistogram).collect();
+  std::printf("%20s %12llu p50 %.5f ms p99 %.5f ms\n", "samples",
+              static_cast<unsigned long long>(stats.count), stats.p50_ms,
+              stats.p99_ms);
+}
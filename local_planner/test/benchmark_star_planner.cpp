@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/common.h"
+#include "../include/local_planner/planner_functions.h"
+#include "../include/local_planner/star_planner.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+using namespace avoidance;
+
+namespace {
+
+// random obstacle cloud made of vertical pillars, leaving the space around
+// the vehicle free
+pcl::PointCloud<pcl::PointXYZI> randomCloud(const Eigen::Vector3f& position,
+                                            float radius, size_t n_points) {
+  const size_t n_pillars = 30;
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> offset(-radius, radius);
+  std::uniform_real_distribution<float> angle(-M_PI_F, M_PI_F);
+  std::uniform_real_distribution<float> height(-2.f, 3.f);
+  std::vector<Eigen::Vector2f> pillars;
+  while (pillars.size() < n_pillars) {
+    Eigen::Vector2f pillar(offset(generator), offset(generator));
+    if (pillar.norm() > 2.f) pillars.push_back(pillar);
+  }
+
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  cloud.reserve(n_points);
+  for (size_t i = 0; i < n_points; i++) {
+    const Eigen::Vector2f& pillar = pillars[i % n_pillars];
+    float a = angle(generator);
+    cloud.push_back(toXYZI(position.x() + pillar.x() + 0.3f * std::cos(a),
+                           position.y() + pillar.y() + 0.3f * std::sin(a),
+                           position.z() + height(generator), 0.f));
+  }
+  return cloud;
+}
+}
+
+class StarPlannerBenchmark : public ::testing::Test {
+ public:
+  StarPlanner star_planner;
+  avoidance::LocalPlannerNodeConfig config;
+  Eigen::Vector3f position = Eigen::Vector3f(0.f, 0.f, 2.f);
+  Eigen::Vector3f goal = Eigen::Vector3f(0.f, 20.f, 2.f);
+  const int repetitions = 20;
+
+  void SetUp() override {
+    ros::Time::init();
+    config = avoidance::LocalPlannerNodeConfig::__getDefault__();
+    star_planner.dynamicReconfigureSetStarParams(config, 1);
+    star_planner.setParams(costParameters());
+    star_planner.setFOV(270.0f, 45.0f);
+    star_planner.setPose(position, 90.f);
+    star_planner.setGoal(goal);
+  }
+};
+
+TEST_F(StarPlannerBenchmark, treeBuildVsCloudSize) {
+  // the baseline rebuilt the histogram for every expanded node, emulate it by
+  // adding the histogram generations that are now saved by the cache
+  const int saved_histograms = config.n_expanded_nodes_ - 1;
+
+  std::printf("%10s %15s %15s %10s\n", "points", "per-node [ms]",
+              "cached [ms]", "speedup");
+  for (size_t n_points : {1000, 5000, 10000, 20000, 50000, 100000}) {
+    pcl::PointCloud<pcl::PointXYZI> cloud =
+        randomCloud(position, 12.f, n_points);
+
+    double cached_ms = 0.0;
+    double histogram_ms = 0.0;
+    for (int i = 0; i < repetitions; i++) {
+      star_planner.setPointcloud(cloud);
+      star_planner.tree_age_ = 1000;
+      auto start = std::chrono::steady_clock::now();
+      star_planner.buildLookAheadTree();
+      auto end = std::chrono::steady_clock::now();
+      cached_ms +=
+          std::chrono::duration<double, std::milli>(end - start).count();
+
+      start = std::chrono::steady_clock::now();
+      for (int j = 0; j < saved_histograms; j++) {
+        Histogram histogram;
+        generateNewHistogram(histogram, cloud, position);
+      }
+      end = std::chrono::steady_clock::now();
+      histogram_ms +=
+          std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    cached_ms /= repetitions;
+    histogram_ms /= repetitions;
+    std::printf("%10zu %15.3f %15.3f %9.1fx\n", n_points,
+                cached_ms + histogram_ms, cached_ms,
+                (cached_ms + histogram_ms) / cached_ms);
+    EXPECT_GT(star_planner.tree_.size(), 1u);
+  }
+}
+
+TEST_F(StarPlannerBenchmark, treeBuildVsTreeSize) {
+  pcl::PointCloud<pcl::PointXYZI> cloud = randomCloud(position, 12.f, 10000);
+  star_planner.setPointcloud(cloud);
+
+  std::printf("%10s %10s %10s %15s\n", "expanded", "children", "nodes",
+              "tree [ms]");
+  for (int n_expanded_nodes : {10, 50, 100, 200}) {
+    for (int children_per_node : {10, 50}) {
+      config.n_expanded_nodes_ = n_expanded_nodes;
+      config.children_per_node_ = children_per_node;
+      config.max_path_length_ = 15.0;
+      star_planner.dynamicReconfigureSetStarParams(config, 1);
+
+      double tree_ms = 0.0;
+      for (int i = 0; i < repetitions; i++) {
+        star_planner.tree_age_ = 1000;
+        auto start = std::chrono::steady_clock::now();
+        star_planner.buildLookAheadTree();
+        auto end = std::chrono::steady_clock::now();
+        tree_ms +=
+            std::chrono::duration<double, std::milli>(end - start).count();
+      }
+      std::printf("%10d %10d %10zu %15.3f\n", n_expanded_nodes,
+                  children_per_node, star_planner.tree_.size(),
+                  tree_ms / repetitions);
+    }
+  }
+}
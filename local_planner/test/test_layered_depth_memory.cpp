@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/common.h"
+#include "../include/local_planner/layered_depth_memory.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace avoidance;
+
+namespace {
+// ranges of the remembered points seen from position, sorted
+std::vector<float> rangesFrom(const LayeredDepthMemory& memory,
+                              const Eigen::Vector3f& position) {
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  memory.getPoints(cloud);
+  std::vector<float> ranges;
+  for (const pcl::PointXYZI& p : cloud) {
+    ranges.push_back((toEigen(p) - position).norm());
+  }
+  std::sort(ranges.begin(), ranges.end());
+  return ranges;
+}
+}
+
+TEST(LayeredDepthMemory, keepsNearestRangesPerCell) {
+  // GIVEN: a memory with two layers and four points in the same direction
+  LayeredDepthMemory memory(2);
+  const Eigen::Vector3f position(0.f, 0.f, 2.f);
+  Box histogram_box(10.f);
+  histogram_box.setBoxLimits(position, 2.f);
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1);
+  for (float range : {5.f, 3.f, 4.f, 2.f}) {
+    complete_cloud[0].push_back(
+        toXYZ(polarToCartesian(PolarPoint(0.6f, 20.7f, range), position)));
+  }
+
+  // WHEN: we update the memory
+  memory.update(complete_cloud, histogram_box, position, 0.2f, 10.f, 0.f);
+
+  // THEN: only the two nearest ranges are remembered, to the millimeter
+  std::vector<float> ranges = rangesFrom(memory, position);
+  ASSERT_EQ(2u, ranges.size());
+  EXPECT_NEAR(2.f, ranges[0], 0.002f);
+  EXPECT_NEAR(3.f, ranges[1], 0.002f);
+  EXPECT_EQ(2u, memory.size());
+}
+
+TEST(LayeredDepthMemory, reprojectsAndAgesOnMotion) {
+  // GIVEN: a memory holding one obstacle point
+  LayeredDepthMemory memory(3);
+  Eigen::Vector3f position(0.f, 0.f, 2.f);
+  Box histogram_box(10.f);
+  histogram_box.setBoxLimits(position, 2.f);
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1);
+  const Eigen::Vector3f obstacle(5.f, 1.f, 2.5f);
+  complete_cloud[0].push_back(toXYZ(obstacle));
+  memory.update(complete_cloud, histogram_box, position, 0.2f, 10.f, 0.f);
+
+  // WHEN: the vehicle moves and no new data arrives
+  complete_cloud[0].clear();
+  position = Eigen::Vector3f(2.f, -1.f, 2.f);
+  histogram_box.setBoxLimits(position, 2.f);
+  memory.update(complete_cloud, histogram_box, position, 0.2f, 10.f, 1.5f);
+
+  // THEN: the point stays where it was in the world and has aged
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  memory.getPoints(cloud);
+  ASSERT_EQ(1u, cloud.size());
+  EXPECT_LT((toEigen(cloud[0]) - obstacle).norm(), 0.01f);
+  EXPECT_FLOAT_EQ(1.5f, cloud[0].intensity);
+
+  // WHEN: the point gets older than the maximum age
+  memory.update(complete_cloud, histogram_box, position, 0.2f, 10.f, 9.f);
+
+  // THEN: it is forgotten
+  EXPECT_EQ(0u, memory.size());
+}
+
+TEST(LayeredDepthMemory, agesDoNotDriftAtHighUpdateRates) {
+  // GIVEN: a memory holding one obstacle point
+  LayeredDepthMemory memory(1);
+  const Eigen::Vector3f position(0.f, 0.f, 2.f);
+  Box histogram_box(10.f);
+  histogram_box.setBoxLimits(position, 2.f);
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1);
+  complete_cloud[0].push_back(toXYZ(Eigen::Vector3f(5.f, 1.f, 2.5f)));
+  memory.update(complete_cloud, histogram_box, position, 0.2f, 2.f, 0.f);
+  complete_cloud[0].clear();
+
+  // WHEN: it is updated at 30Hz for one second
+  for (int i = 0; i < 30; i++) {
+    memory.update(complete_cloud, histogram_box, position, 0.2f, 2.f,
+                  1.f / 30.f);
+  }
+
+  // THEN: its age is one second, to the rounding of a single stamp
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  memory.getPoints(cloud);
+  ASSERT_EQ(1u, cloud.size());
+  EXPECT_NEAR(1.f, cloud[0].intensity, 0.006f);
+
+  // WHEN: the updates continue until just before and after the maximum age
+  for (int i = 30; i < 59; i++) {
+    memory.update(complete_cloud, histogram_box, position, 0.2f, 2.f,
+                  1.f / 30.f);
+  }
+  EXPECT_EQ(1u, memory.size());
+  for (int i = 59; i < 61; i++) {
+    memory.update(complete_cloud, histogram_box, position, 0.2f, 2.f,
+                  1.f / 30.f);
+  }
+
+  // THEN: it is forgotten on time
+  EXPECT_EQ(0u, memory.size());
+}
+
+TEST(LayeredDepthMemory, newDataReplacesCell) {
+  // GIVEN: a memory holding a near point and a far point in another cell
+  LayeredDepthMemory memory(2);
+  const Eigen::Vector3f position(0.f, 0.f, 2.f);
+  Box histogram_box(10.f);
+  histogram_box.setBoxLimits(position, 2.f);
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1);
+  const PolarPoint direction(0.6f, 20.7f, 2.f);
+  complete_cloud[0].push_back(toXYZ(polarToCartesian(direction, position)));
+  complete_cloud[0].push_back(
+      toXYZ(polarToCartesian(PolarPoint(0.6f, -30.7f, 6.f), position)));
+  memory.update(complete_cloud, histogram_box, position, 0.2f, 10.f, 0.f);
+
+  // WHEN: new data sees the first direction free up to 4m
+  complete_cloud[0].clear();
+  complete_cloud[0].push_back(toXYZ(
+      polarToCartesian(PolarPoint(direction.e, direction.z, 4.f), position)));
+  memory.update(complete_cloud, histogram_box, position, 0.2f, 10.f, 1.f);
+
+  // THEN: the near point is replaced and the other cell is kept
+  std::vector<float> ranges = rangesFrom(memory, position);
+  ASSERT_EQ(2u, ranges.size());
+  EXPECT_NEAR(4.f, ranges[0], 0.002f);
+  EXPECT_NEAR(6.f, ranges[1], 0.002f);
+}
@@ -21,6 +21,7 @@ class LocalPlannerTests : public ::testing::Test {
     avoidance::LocalPlannerNodeConfig config =
         avoidance::LocalPlannerNodeConfig::__getDefault__();
     planner.dynamicReconfigureSetParams(config, 1);
+    planner.setBinningTable(planner.buildBinningTable(config));
 
     // start with basic pose
     Eigen::Vector3f pos(0.f, 0.f, 0.f);
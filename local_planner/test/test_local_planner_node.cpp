@@ -2,6 +2,11 @@
 
 #include "../include/local_planner/local_planner_node.h"
 
+#include <ros/callback_queue.h>
+
+#include <string>
+#include <vector>
+
 using namespace avoidance;
 
 TEST(LocalPlannerNodeTests, failsafe) {
@@ -55,3 +60,43 @@ TEST(LocalPlannerNodeTests, failsafe) {
               static_cast<int>(MAV_STATE::MAV_STATE_FLIGHT_TERMINATION));
   }
 }
+
+TEST(LocalPlannerNodeTests, lateCameraInfoIsReceived) {
+  // GIVEN: a node with a depth camera whose camera info is not published yet
+  ros::Time::init();
+  ros::NodeHandle nh("~");
+  ros::NodeHandle nh_private("");
+  nh.setParam("depth_image_topics",
+              std::vector<std::string>{"/late_camera/depth"});
+  LocalPlannerNode Node(nh, nh_private, false);
+  nh.deleteParam("depth_image_topics");
+  ASSERT_EQ(1u, Node.cameras_.size());
+
+  // WHEN: the main loop unsubscribes before the camera info arrives
+  Node.unsubscribeCameraInfo();
+
+  // THEN: the subscription is kept
+  EXPECT_TRUE(Node.cameras_[0].camera_info_sub_);
+
+  // WHEN: the camera info is published late
+  ros::Publisher camera_info_pub = nh.advertise<sensor_msgs::CameraInfo>(
+      "/late_camera/camera_info", 1, true);
+  sensor_msgs::CameraInfo camera_info;
+  camera_info.width = 640;
+  camera_info.height = 480;
+  camera_info.K[0] = 400.0;
+  camera_info.K[4] = 400.0;
+  camera_info_pub.publish(camera_info);
+  for (int i = 0; i < 50 && !Node.cameras_[0].camera_info_; i++) {
+    ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.1));
+  }
+
+  // THEN: the camera gets it and only then stops listening
+  EXPECT_TRUE(Node.cameras_[0].camera_info_ != nullptr);
+  Node.unsubscribeCameraInfo();
+  EXPECT_FALSE(Node.cameras_[0].camera_info_sub_);
+
+  Node.should_exit_ = true;
+  Node.cameras_[0].cloud_ready_cv_->notify_all();
+  Node.cameras_[0].transform_thread_.join();
+}
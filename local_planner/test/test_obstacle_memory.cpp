@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/common.h"
+#include "../include/local_planner/obstacle_memory.h"
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <tuple>
+
+using namespace avoidance;
+
+TEST(ObstacleMemory, keepsLastPointPerVoxel) {
+  // GIVEN: an empty memory
+  ObstacleMemory memory(1.f, 4);
+  pcl::PointCloud<pcl::PointXYZI> cloud, result;
+
+  // WHEN: we insert two points into the same voxel and one into another
+  // voxel, at block borders and negative coordinates
+  cloud.push_back(toXYZI(-0.5f, -0.5f, -0.5f, 0.f));
+  cloud.push_back(toXYZI(-0.2f, -0.2f, -0.2f, 0.f));
+  cloud.push_back(toXYZI(4.5f, 0.5f, 0.5f, 0.f));
+  memory.insert(cloud, 1.0);
+  memory.getPoints(Eigen::Vector3f(-10.f, -10.f, -10.f),
+                   Eigen::Vector3f(10.f, 10.f, 10.f), 3.0, 5.f, result);
+
+  // THEN: the memory holds the later point of the shared voxel and the age of
+  // the points
+  EXPECT_EQ(2u, memory.size());
+  ASSERT_EQ(2u, result.size());
+  bool found_later_point = false;
+  for (const pcl::PointXYZI& p : result) {
+    EXPECT_FLOAT_EQ(2.f, p.intensity);
+    EXPECT_NE(-0.5f, p.x);
+    found_later_point |= p.x == -0.2f;
+  }
+  EXPECT_TRUE(found_later_point);
+}
+
+TEST(ObstacleMemory, pointsWithinBoxMatchBruteForce) {
+  // GIVEN: a memory filled with random points seen at different times
+  std::mt19937 generator(5);
+  std::uniform_real_distribution<float> coordinate(-30.f, 30.f);
+  ObstacleMemory memory(0.5f);
+  // last point seen in every voxel
+  std::map<std::tuple<int, int, int>, pcl::PointXYZI> voxels;
+  for (int t = 0; t < 10; t++) {
+    pcl::PointCloud<pcl::PointXYZI> cloud;
+    for (int i = 0; i < 1000; i++) {
+      pcl::PointXYZI p =
+          toXYZI(coordinate(generator), coordinate(generator),
+                 coordinate(generator), static_cast<float>(t));
+      cloud.push_back(p);
+      voxels[std::make_tuple(static_cast<int>(std::floor(p.x / 0.5f)),
+                             static_cast<int>(std::floor(p.y / 0.5f)),
+                             static_cast<int>(std::floor(p.z / 0.5f)))] = p;
+    }
+    memory.insert(cloud, t);
+  }
+  EXPECT_EQ(voxels.size(), memory.size());
+
+  // WHEN: we read a box at a time where the first points have expired
+  const Eigen::Vector3f lower(-10.f, -5.f, -12.f);
+  const Eigen::Vector3f upper(12.f, 8.f, 3.f);
+  pcl::PointCloud<pcl::PointXYZI> result;
+  memory.getPoints(lower, upper, 12.0, 6.f, result);
+
+  // THEN: we get exactly the points inside the box which are younger than the
+  // maximum age
+  size_t expected = 0;
+  for (const auto& voxel : voxels) {
+    const pcl::PointXYZI& p = voxel.second;
+    if (12.f - p.intensity < 6.f && p.x >= lower.x() && p.x <= upper.x() &&
+        p.y >= lower.y() && p.y <= upper.y() && p.z >= lower.z() &&
+        p.z <= upper.z()) {
+      expected++;
+    }
+  }
+  EXPECT_EQ(expected, result.size());
+  for (const pcl::PointXYZI& p : result) {
+    EXPECT_LT(p.intensity, 6.f);
+  }
+  EXPECT_LT(memory.size(), voxels.size());
+}
+
+TEST(ObstacleMemory, eraseAndClear) {
+  // GIVEN: a memory with two points
+  ObstacleMemory memory(1.f);
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  cloud.push_back(toXYZI(0.5f, 0.5f, 0.5f, 0.f));
+  cloud.push_back(toXYZI(-3.5f, 0.5f, 0.5f, 0.f));
+  memory.insert(cloud, 0.0);
+
+  // WHEN: we erase a voxel, an empty voxel and then clear the memory
+  memory.erase(0.9f, 0.1f, 0.2f);
+  memory.erase(10.f, 10.f, 10.f);
+  EXPECT_EQ(1u, memory.size());
+  memory.clear();
+
+  // THEN: nothing is left
+  pcl::PointCloud<pcl::PointXYZI> result;
+  memory.getPoints(Eigen::Vector3f(-10.f, -10.f, -10.f),
+                   Eigen::Vector3f(10.f, 10.f, 10.f), 0.0, 5.f, result);
+  EXPECT_EQ(0u, memory.size());
+  EXPECT_EQ(0u, result.size());
+}
+
+TEST(ObstacleMemory, expiredBlocksOutsideTheBoxAreSwept) {
+  // GIVEN: a memory with old points along the flown path and recent points
+  // around the vehicle
+  ObstacleMemory memory(0.5f, 4);
+  pcl::PointCloud<pcl::PointXYZI> old_cloud, recent_cloud, result;
+  for (int i = 0; i < 1000; i++) {
+    old_cloud.push_back(toXYZI(0.5f * i, 0.f, 0.f, 0.f));
+  }
+  for (int i = 0; i < 10; i++) {
+    recent_cloud.push_back(toXYZI(600.f + 0.5f * i, 0.f, 0.f, 0.f));
+  }
+  memory.insert(old_cloud, 0.0);
+  memory.insert(recent_cloud, 9.0);
+  ASSERT_EQ(1010u, memory.size());
+
+  // WHEN: the vehicle keeps reading a box far away from the old points
+  for (int i = 0; i < 40; i++) {
+    memory.getPoints(Eigen::Vector3f(590.f, -10.f, -10.f),
+                     Eigen::Vector3f(596.f, 10.f, 10.f), 10.0, 5.f, result);
+  }
+
+  // THEN: the expired points outside the box are forgotten and the recent
+  // ones are kept
+  EXPECT_EQ(10u, memory.size());
+  memory.getPoints(Eigen::Vector3f(590.f, -10.f, -10.f),
+                   Eigen::Vector3f(610.f, 10.f, 10.f), 10.0, 5.f, result);
+  EXPECT_EQ(10u, result.size());
+}
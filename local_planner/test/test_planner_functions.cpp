@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <cmath>
+#include <random>
 
 #include "../include/local_planner/planner_functions.h"
 
@@ -10,7 +11,7 @@ using namespace avoidance;
 TEST(PlannerFunctions, generateNewHistogramEmpty) {
   // GIVEN: an empty pointcloud
   pcl::PointCloud<pcl::PointXYZI> empty_cloud;
-  Histogram histogram_output = Histogram(ALPHA_RES);
+  Histogram histogram_output;
   geometry_msgs::PoseStamped location;
   location.pose.position.x = 0;
   location.pose.position.y = 0;
@@ -30,7 +31,7 @@ TEST(PlannerFunctions, generateNewHistogramEmpty) {
 
 TEST(PlannerFunctions, generateNewHistogramSpecificCells) {
   // GIVEN: a pointcloud with an object of one cell size
-  Histogram histogram_output = Histogram(ALPHA_RES);
+  Histogram histogram_output;
   Eigen::Vector3f location(0.0f, 0.0f, 0.0f);
   float distance = 1.0f;
 
@@ -175,22 +176,99 @@ TEST(PlannerFunctionsTests, processPointcloud) {
   histogram_box.setBoxLimits(position, 4.5f);
   float min_realsense_dist = 0.2f;
 
+  // a point remembered from 5s ago
   pcl::PointCloud<pcl::PointXYZI> processed_cloud1, processed_cloud2;
+  pcl::PointCloud<pcl::PointXYZI> memory_cloud;
   Eigen::Vector3f memory_point(-0.4f, 0.3f, -0.4f);
-  processed_cloud1.push_back(toXYZI(position + memory_point, 5));
-  processed_cloud2.push_back(toXYZI(position + memory_point, 5));
+  memory_cloud.push_back(toXYZI(position + memory_point, 0));
+  ObstacleMemory memory1(0.1f), memory2(0.1f);
+  memory1.insert(memory_cloud, 0.0);
+  memory2.insert(memory_cloud, 0.0);
 
   // WHEN: we filter the PointCloud with different values max_age
   processPointcloud(processed_cloud1, complete_cloud, histogram_box, position,
-                    min_realsense_dist, 0.f, 0.5f);
+                    min_realsense_dist, 0.f, memory1, 5.0);
 
   processPointcloud(processed_cloud2, complete_cloud, histogram_box, position,
-                    min_realsense_dist, 10.f, .5f);
+                    min_realsense_dist, 10.f, memory2, 5.0);
 
   // THEN: we expect the first cloud to have 6 points
   // the second cloud should contain 7 points
   EXPECT_EQ(processed_cloud1.size(), 6);
   EXPECT_EQ(processed_cloud2.size(), 7);
+
+  // the remembered point keeps its age, the new points are remembered unless
+  // the maximum age disables the memory
+  EXPECT_FLOAT_EQ(5.f, processed_cloud2.points.back().intensity);
+  EXPECT_FLOAT_EQ(0.f, processed_cloud2.points.front().intensity);
+  EXPECT_EQ(0u, memory1.size());
+  EXPECT_EQ(7u, memory2.size());
+}
+
+TEST(PlannerFunctionsTests, processPointcloudForgetsOverriddenMemory) {
+  // GIVEN: a remembered point and new data in the same direction, but further
+  // away
+  const Eigen::Vector3f position(0.f, 0.f, 2.f);
+  Box histogram_box(10.0f);
+  histogram_box.setBoxLimits(position, 2.f);
+  ObstacleMemory memory(0.1f);
+  pcl::PointCloud<pcl::PointXYZI> memory_cloud;
+  memory_cloud.push_back(toXYZI(position + Eigen::Vector3f(0.f, 2.f, 0.f), 0));
+  memory.insert(memory_cloud, 0.0);
+
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(1);
+  complete_cloud[0].push_back(
+      toXYZ(position + Eigen::Vector3f(0.f, 4.f, 0.f)));
+
+  // WHEN: we process the new data
+  pcl::PointCloud<pcl::PointXYZI> final_cloud;
+  processPointcloud(final_cloud, complete_cloud, histogram_box, position, 0.2f,
+                    10.f, memory, 1.0);
+
+  // THEN: the remembered point is dropped from the output and the memory
+  ASSERT_EQ(1u, final_cloud.size());
+  EXPECT_FLOAT_EQ(position.y() + 4.f, final_cloud.points[0].y);
+  EXPECT_EQ(1u, memory.size());
+}
+
+TEST(PlannerFunctionsTests, processPointcloudParallelMatchesSerial) {
+  // GIVEN: three dense clouds, many points fall into the same subsampling
+  // cell, partly across cameras
+  const Eigen::Vector3f position(1.5f, 1.0f, 4.5f);
+  std::mt19937 generator(3);
+  std::uniform_real_distribution<float> offset(-6.f, 6.f);
+  std::vector<pcl::PointCloud<pcl::PointXYZ>> complete_cloud(3);
+  for (auto& cloud : complete_cloud) {
+    for (int i = 0; i < 5000; i++) {
+      cloud.push_back(toXYZ(position + Eigen::Vector3f(offset(generator),
+                                                       offset(generator),
+                                                       offset(generator))));
+    }
+  }
+  Box histogram_box(5.0f);
+  histogram_box.setBoxLimits(position, 4.5f);
+
+  // WHEN: we process the clouds serially and with several threads
+  pcl::PointCloud<pcl::PointXYZI> serial_cloud;
+  ObstacleMemory serial_memory(0.1f);
+  processPointcloud(serial_cloud, complete_cloud, histogram_box, position,
+                    0.2f, 10.f, serial_memory, 0.0);
+  for (unsigned int n_threads : {2, 3, 7}) {
+    WorkerPool pool(n_threads);
+    pcl::PointCloud<pcl::PointXYZI> parallel_cloud;
+    ObstacleMemory parallel_memory(0.1f);
+    processPointcloud(parallel_cloud, complete_cloud, histogram_box, position,
+                      0.2f, 10.f, parallel_memory, 0.0, &pool);
+
+    // THEN: the same points are kept in the same order
+    ASSERT_EQ(serial_cloud.size(), parallel_cloud.size());
+    for (size_t i = 0; i < serial_cloud.size(); i++) {
+      EXPECT_EQ(serial_cloud.points[i].x, parallel_cloud.points[i].x);
+      EXPECT_EQ(serial_cloud.points[i].y, parallel_cloud.points[i].y);
+      EXPECT_EQ(serial_cloud.points[i].z, parallel_cloud.points[i].z);
+    }
+  }
+  EXPECT_GT(serial_cloud.size(), 1000u);
 }
 
 TEST(PlannerFunctions, testDirectionTree) {
@@ -366,6 +444,105 @@ TEST(PlannerFunctions, getBestCandidatesFromCostMatrix) {
   EXPECT_FLOAT_EQ(4.7, candidate_vector[3].cost);
 }
 
+TEST(PlannerFunctions, getBestCandidatesFromCostMatrixTiesAndLargeK) {
+  // GIVEN: a cost matrix with equal costs and more candidates requested than
+  // there are cells
+  std::vector<candidateDirection> candidate_vector;
+  Eigen::MatrixXf matrix(2, 3);
+  matrix << 5.f, 1.f, 5.f, 3.f, 1.f, 2.f;
+
+  // WHEN: calculate the candidates from the matrix
+  getBestCandidatesFromCostMatrix(matrix, 100, candidate_vector);
+
+  // THEN: all cells are returned in increasing cost order, equal costs are
+  // ordered by azimuth first and then by elevation
+  ASSERT_EQ(6, candidate_vector.size());
+  const float expected[] = {1.f, 1.f, 2.f, 3.f, 5.f, 5.f};
+  for (size_t i = 0; i < candidate_vector.size(); i++) {
+    EXPECT_FLOAT_EQ(expected[i], candidate_vector[i].cost);
+  }
+  EXPECT_LT(candidate_vector[0].elevation_angle,
+            candidate_vector[1].elevation_angle);
+  EXPECT_LT(candidate_vector[4].azimuth_angle,
+            candidate_vector[5].azimuth_angle);
+
+  getBestCandidatesFromCostMatrix(matrix, 0, candidate_vector);
+  EXPECT_TRUE(candidate_vector.empty());
+}
+
+TEST(PlannerFunctions, getBestCandidatesCoarseToFine) {
+  // GIVEN: a goal straight ahead which is blocked by an obstacle
+  Eigen::Vector3f position(0.f, 0.f, 0.f);
+  Eigen::Vector3f goal(0.f, 10.f, 0.f);
+  costParameters cost_params;
+  Histogram histogram;
+  PolarPoint goal_pol = cartesianToPolar(goal, position);
+  Eigen::Vector2i goal_index = polarToHistogramIndex(goal_pol, ALPHA_RES);
+  for (int e = goal_index.y() - 2; e <= goal_index.y() + 2; e++) {
+    for (int z = goal_index.x() - 2; z <= goal_index.x() + 2; z++) {
+      histogram.set_dist(e, z, 2.f);
+    }
+  }
+
+  // WHEN: we select the candidates with the full cost matrix and coarse to
+  // fine
+  Eigen::MatrixXf cost_matrix;
+  std::vector<candidateDirection> full_candidates, pyramid_candidates;
+  getCostMatrix(histogram, goal, position, 90.f, goal, cost_params, false,
+                30.f, cost_matrix);
+  getBestCandidatesFromCostMatrix(cost_matrix, 10, full_candidates);
+  getBestCandidatesCoarseToFine(histogram, goal, position, 90.f, goal,
+                                cost_params, 30.f, 10, pyramid_candidates);
+
+  // THEN: both should return the requested number of candidates sorted by
+  // cost, none of them inside the obstacle
+  ASSERT_EQ(10u, pyramid_candidates.size());
+  for (size_t i = 1; i < pyramid_candidates.size(); i++) {
+    EXPECT_LE(pyramid_candidates[i - 1].cost, pyramid_candidates[i].cost);
+  }
+  for (const candidateDirection& candidate : pyramid_candidates) {
+    PolarPoint p_pol(candidate.elevation_angle, candidate.azimuth_angle, 1.f);
+    Eigen::Vector2i index = polarToHistogramIndex(p_pol, ALPHA_RES);
+    EXPECT_FLOAT_EQ(0.f, histogram.get_dist(index.y(), index.x()));
+  }
+
+  // AND: the candidates have the cost of their cell in the full cost matrix
+  for (const candidateDirection& candidate : pyramid_candidates) {
+    PolarPoint p_pol(candidate.elevation_angle, candidate.azimuth_angle, 1.f);
+    Eigen::Vector2i index = polarToHistogramIndex(p_pol, ALPHA_RES);
+    EXPECT_FLOAT_EQ(cost_matrix(index.y(), index.x()), candidate.cost);
+  }
+
+  // AND: the best direction should be close to the one of the full search
+  Eigen::Vector3f full_best = polarToCartesian(
+      PolarPoint(full_candidates[0].elevation_angle,
+                 full_candidates[0].azimuth_angle, 1.f),
+      position);
+  Eigen::Vector3f pyramid_best = polarToCartesian(
+      PolarPoint(pyramid_candidates[0].elevation_angle,
+                 pyramid_candidates[0].azimuth_angle, 1.f),
+      position);
+  EXPECT_LT(std::acos(std::min(1.f, full_best.dot(pyramid_best))) * RAD_TO_DEG,
+            2.f * ALPHA_RES + 0.1f);
+
+  // WHEN: the goal is steeply above, where the cost matrix interpolates the
+  // cells between the evaluated columns of a row
+  const Eigen::Vector3f high_goal(1.f, 2.f, 10.f);
+  getCostMatrix(histogram, high_goal, position, 90.f, goal, cost_params, false,
+                30.f, cost_matrix);
+  getBestCandidatesCoarseToFine(histogram, high_goal, position, 90.f, goal,
+                                cost_params, 30.f, 10, pyramid_candidates);
+
+  // THEN: the candidates still have the cost of their cell in the full cost
+  // matrix
+  ASSERT_EQ(10u, pyramid_candidates.size());
+  for (const candidateDirection& candidate : pyramid_candidates) {
+    PolarPoint p_pol(candidate.elevation_angle, candidate.azimuth_angle, 1.f);
+    Eigen::Vector2i index = polarToHistogramIndex(p_pol, ALPHA_RES);
+    EXPECT_FLOAT_EQ(cost_matrix(index.y(), index.x()), candidate.cost);
+  }
+}
+
 TEST(PlannerFunctions, smoothPolarMatrix) {
   // GIVEN: a smoothing radius and a known cost matrix with one costly cell,
   // otherwise all zeros.
@@ -442,7 +619,7 @@ TEST(PlannerFunctions, getCostMatrixNoObstacles) {
   cost_params.height_change_cost_param = 4.f;
   cost_params.height_change_cost_param_adapted = 4.f;
   Eigen::MatrixXf cost_matrix;
-  Histogram histogram = Histogram(ALPHA_RES);
+  Histogram histogram;
   float smoothing_radius = 30.f;
 
   // WHEN: we calculate the cost matrix from the input data
@@ -513,6 +690,76 @@ TEST(PlannerFunctions, getCostMatrixNoObstacles) {
   EXPECT_TRUE(row4);
 }
 
+TEST(PlannerFunctions, getCostMatrixWithoutImage) {
+  // GIVEN: a histogram with an obstacle in front of the vehicle
+  Eigen::Vector3f position(0.f, 0.f, 0.f);
+  Eigen::Vector3f goal(0.f, 5.f, 0.f);
+  Eigen::Vector3f last_sent_waypoint(0.f, 1.f, 0.f);
+  costParameters cost_params;
+  Histogram histogram;
+  for (int z = GRID_LENGTH_Z / 2 - 3; z < GRID_LENGTH_Z / 2 + 3; z++) {
+    histogram.set_dist(GRID_LENGTH_E / 2, z, 2.f);
+  }
+
+  // WHEN: we calculate the cost matrix with and without the cost image
+  Eigen::MatrixXf cost_matrix_image, cost_matrix;
+  std::vector<uint8_t> cost_image_data;
+  getCostMatrix(histogram, goal, position, 90.f, last_sent_waypoint,
+                cost_params, false, 30.f, cost_matrix_image, cost_image_data);
+  getCostMatrix(histogram, goal, position, 90.f, last_sent_waypoint,
+                cost_params, false, 30.f, cost_matrix);
+
+  // THEN: both cost matrices are identical and only the first call produced
+  // an image
+  EXPECT_EQ(3u * GRID_LENGTH_E * GRID_LENGTH_Z, cost_image_data.size());
+  ASSERT_EQ(cost_matrix_image.rows(), cost_matrix.rows());
+  ASSERT_EQ(cost_matrix_image.cols(), cost_matrix.cols());
+  EXPECT_TRUE(cost_matrix_image == cost_matrix);
+}
+
+TEST(PlannerFunctions, getCostMatrixMatchesCostFunction) {
+  // GIVEN: a vehicle below the goal with some obstacles in the histogram
+  Eigen::Vector3f position(1.f, -2.f, 3.f);
+  Eigen::Vector3f goal(4.f, 6.f, 5.f);
+  Eigen::Vector3f last_sent_waypoint(2.f, -1.f, 3.5f);
+  float heading = 30.f;
+  costParameters cost_params;
+  cost_params.goal_cost_param = 3.f;
+  cost_params.heading_cost_param = 0.5f;
+  cost_params.smooth_cost_param = 1.5f;
+  cost_params.height_change_cost_param = 4.f;
+  cost_params.height_change_cost_param_adapted = 2.f;
+  Histogram histogram;
+  for (int e = 0; e < GRID_LENGTH_E; e += 3) {
+    for (int z = 0; z < GRID_LENGTH_Z; z += 7) {
+      histogram.set_dist(e, z, 1.f + 0.1f * (e + z));
+    }
+  }
+
+  // WHEN: we calculate the cost matrix without smoothing the obstacle costs
+  Eigen::MatrixXf cost_matrix;
+  getCostMatrix(histogram, goal, position, heading, last_sent_waypoint,
+                cost_params, false, 0.f, cost_matrix);
+
+  // THEN: every evaluated cell should match the single cell cost function
+  for (int e = 0; e < GRID_LENGTH_E; e++) {
+    const float bin_width =
+        std::cos(histogramIndexToPolar(e, 0, ALPHA_RES, 1).e * DEG_TO_RAD);
+    const int step_size = static_cast<int>(std::round(1 / bin_width));
+    for (int z = 0; z < GRID_LENGTH_Z; z += step_size) {
+      float obstacle_distance = histogram.get_dist(e, z);
+      PolarPoint p_pol =
+          histogramIndexToPolar(e, z, ALPHA_RES, obstacle_distance);
+      float distance_cost, other_costs;
+      costFunction(p_pol.e, p_pol.z, obstacle_distance, goal, position,
+                   heading, last_sent_waypoint, cost_params, distance_cost,
+                   other_costs);
+      float expected = distance_cost + other_costs;
+      EXPECT_NEAR(expected, cost_matrix(e, z), 1e-4f * expected);
+    }
+  }
+}
+
 TEST(PlannerFunctions, CostfunctionGoalCost) {
   // GIVEN: a scenario with two different goal locations
   Eigen::Vector3f position(0.f, 0.f, 0.f);
@@ -649,25 +896,25 @@ TEST(PlannerFunctions, CostfunctionSmoothingCost) {
 
 TEST(Histogram, HistogramDownsampleCorrectUsage) {
   // GIVEN: a histogram of the correct resolution
-  Histogram histogram = Histogram(ALPHA_RES);
+  Histogram histogram;
   histogram.set_dist(0, 0, 1.3);
   histogram.set_dist(1, 0, 1.3);
   histogram.set_dist(0, 1, 1.3);
   histogram.set_dist(1, 1, 1.3);
 
   // WHEN: we downsample the histogram to have a larger bin size
-  histogram.downsample();
+  PolarHistogram<ALPHA_RES * 2> low_res_histogram = downsample(histogram);
 
   // THEN: The downsampled histogram should fuse four cells of the regular
   // resolution histogram into one
   for (int i = 0; i < GRID_LENGTH_E / 2; ++i) {
     for (int j = 0; j < GRID_LENGTH_Z / 2; ++j) {
       if (i == 0 && j == 0) {
-        EXPECT_FLOAT_EQ(1.3, histogram.get_dist(i, j));
+        EXPECT_FLOAT_EQ(1.3, low_res_histogram.get_dist(i, j));
       } else if (i == 1 && j == 1) {
-        EXPECT_FLOAT_EQ(0.0, histogram.get_dist(i, j));
+        EXPECT_FLOAT_EQ(0.0, low_res_histogram.get_dist(i, j));
       } else {
-        EXPECT_FLOAT_EQ(0.0, histogram.get_dist(i, j));
+        EXPECT_FLOAT_EQ(0.0, low_res_histogram.get_dist(i, j));
       }
     }
   }
@@ -675,11 +922,11 @@ TEST(Histogram, HistogramDownsampleCorrectUsage) {
 
 TEST(Histogram, HistogramUpsampleCorrectUsage) {
   // GIVEN: a histogram of the correct resolution
-  Histogram histogram = Histogram(ALPHA_RES * 2);
-  histogram.set_dist(0, 0, 1.3);
+  PolarHistogram<ALPHA_RES * 2> low_res_histogram;
+  low_res_histogram.set_dist(0, 0, 1.3);
 
   // WHEN: we upsample the histogram to have regular bin size
-  histogram.upsample();
+  Histogram histogram = upsample(low_res_histogram);
 
   // THEN: The upsampled histogram should split every cell of the lower
   // resolution histogram into four cells
@@ -698,20 +945,34 @@ TEST(Histogram, HistogramUpsampleCorrectUsage) {
   }
 }
 
-TEST(Histogram, HistogramUpDownpsampleInorrectUsage) {
-  // GIVEN: a histogram of the correct resolution
-  Histogram low_res_histogram = Histogram(ALPHA_RES * 2);
-  Histogram high_res_histogram = Histogram(ALPHA_RES);
-
-  // THEN: We expect the functions to throw if the input histogram has the wrong
-  // resolution
-  EXPECT_THROW(low_res_histogram.downsample(), std::logic_error);
-  EXPECT_THROW(high_res_histogram.upsample(), std::logic_error);
+TEST(Histogram, HistogramResolutionDimensions) {
+  // GIVEN: histograms of the shipped resolutions
+  PolarHistogram<3> histogram_3;
+  PolarHistogram<6> histogram_6;
+  PolarHistogram<12> histogram_12;
+
+  // THEN: the dimensions should follow from the resolution and the
+  // histograms should start out empty
+  EXPECT_EQ(60, (PolarHistogram<3>::e_dim));
+  EXPECT_EQ(120, (PolarHistogram<3>::z_dim));
+  EXPECT_EQ(GRID_LENGTH_E, Histogram::e_dim);
+  EXPECT_EQ(GRID_LENGTH_Z, Histogram::z_dim);
+  EXPECT_EQ(15, (PolarHistogram<12>::e_dim));
+  EXPECT_EQ(30, (PolarHistogram<12>::z_dim));
+  EXPECT_TRUE(histogram_3.isEmpty());
+  EXPECT_TRUE(histogram_6.isEmpty());
+  EXPECT_TRUE(histogram_12.isEmpty());
+
+  // AND: the wrapping accessor should agree with the unchecked one
+  histogram_6.set_dist(0, 0, 1.3f);
+  EXPECT_FLOAT_EQ(1.3f, histogram_6.get_dist(Histogram::e_dim,
+                                             -Histogram::z_dim));
+  EXPECT_FLOAT_EQ(1.3f, histogram_6.get_dist_unchecked(0, 0));
 }
 
 TEST(Histogram, HistogramisEmpty) {
   // GIVEN: a histogram
-  Histogram histogram = Histogram(ALPHA_RES);
+  Histogram histogram;
   // Set a cell
   histogram.set_dist(0, 0, 1.3);
   EXPECT_FALSE(histogram.isEmpty());
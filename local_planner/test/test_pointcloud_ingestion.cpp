@@ -0,0 +1,248 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/pointcloud_ingestion.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace avoidance;
+
+namespace {
+// organized cloud message with x, y, z and a padding field, like the ones
+// produced by depth_image_proc
+sensor_msgs::PointCloud2 cloudMessage(
+    int width, int height, const std::vector<Eigen::Vector3f>& points) {
+  sensor_msgs::PointCloud2 msg;
+  msg.width = width;
+  msg.height = height;
+  const char* names[] = {"x", "y", "z"};
+  for (int i = 0; i < 3; i++) {
+    sensor_msgs::PointField field;
+    field.name = names[i];
+    field.offset = 4 * i;
+    field.datatype = sensor_msgs::PointField::FLOAT32;
+    field.count = 1;
+    msg.fields.push_back(field);
+  }
+  msg.point_step = 16;
+  msg.row_step = msg.point_step * width;
+  msg.data.resize(msg.row_step * height);
+  for (size_t i = 0; i < points.size(); i++) {
+    std::memcpy(&msg.data[i * msg.point_step], points[i].data(),
+                3 * sizeof(float));
+  }
+  return msg;
+}
+}
+
+TEST(PointcloudIngestion, dropsNaNAndTransforms) {
+  // GIVEN: an organized cloud with invalid pixels and a sensor transform
+  std::vector<Eigen::Vector3f> points;
+  for (int i = 0; i < 24; i++) {
+    points.push_back(i % 5 == 0 ? Eigen::Vector3f(NAN, NAN, NAN)
+                                : Eigen::Vector3f(0.1f * i, -0.2f * i, 2.f));
+  }
+  sensor_msgs::PointCloud2 msg = cloudMessage(6, 4, points);
+  Eigen::Affine3f transform =
+      Eigen::Translation3f(1.f, 2.f, 3.f) *
+      Eigen::AngleAxisf(0.5f, Eigen::Vector3f(0.f, 0.f, 1.f).normalized());
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+
+  // WHEN: we ingest it
+  ASSERT_TRUE(ingestPointCloud(msg, transform, ingestionParameters(), cloud));
+
+  // THEN: the valid points are transformed in their original order
+  ASSERT_EQ(19u, cloud.size());
+  size_t k = 0;
+  for (const Eigen::Vector3f& p : points) {
+    if (std::isnan(p.x())) continue;
+    const Eigen::Vector3f expected = transform * p;
+    EXPECT_NEAR(expected.x(), cloud[k].x, 1e-5f);
+    EXPECT_NEAR(expected.y(), cloud[k].y, 1e-5f);
+    EXPECT_NEAR(expected.z(), cloud[k].z, 1e-5f);
+    k++;
+  }
+  EXPECT_EQ(cloud.points.size(), cloud.width);
+  EXPECT_EQ(1u, cloud.height);
+}
+
+TEST(PointcloudIngestion, cropsAndDecimates) {
+  // GIVEN: an organized cloud where the range grows with the column
+  const int width = 7, height = 5;
+  std::vector<Eigen::Vector3f> points;
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++) {
+      points.push_back(Eigen::Vector3f(0.f, 0.f, 1.f + col));
+    }
+  }
+  sensor_msgs::PointCloud2 msg = cloudMessage(width, height, points);
+  ingestionParameters params;
+  params.max_range = 5.5f;
+  params.row_stride = 2;
+  params.column_stride = 2;
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+
+  // WHEN: we ingest it with a range limit and a stride
+  ASSERT_TRUE(
+      ingestPointCloud(msg, Eigen::Affine3f::Identity(), params, cloud));
+
+  // THEN: only every second row and column within range is kept
+  ASSERT_EQ(3u * 3u, cloud.size());
+  for (const pcl::PointXYZ& p : cloud) {
+    EXPECT_TRUE(p.z == 1.f || p.z == 3.f || p.z == 5.f);
+  }
+}
+
+TEST(PointcloudIngestion, rejectsCloudsWithoutCoordinates) {
+  // GIVEN: a cloud without a z field
+  sensor_msgs::PointCloud2 msg =
+      cloudMessage(2, 1, {Eigen::Vector3f::Ones(), Eigen::Vector3f::Ones()});
+  msg.fields.pop_back();
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  cloud.push_back(pcl::PointXYZ(1.f, 2.f, 3.f));
+
+  // THEN: it cannot be read and the output is empty
+  EXPECT_FALSE(ingestPointCloud(msg, Eigen::Affine3f::Identity(),
+                                ingestionParameters(), cloud));
+  EXPECT_EQ(0u, cloud.size());
+}
+
+TEST(PointcloudIngestion, backProjectsDepthImages) {
+  // GIVEN: the same depth image in millimeters and meters, with pixels
+  // without depth
+  const int width = 4, height = 3;
+  sensor_msgs::CameraInfo info;
+  info.K = {{2.0, 0.0, 1.5, 0.0, 4.0, 1.0, 0.0, 0.0, 1.0}};
+  sensor_msgs::Image mm, m;
+  mm.width = m.width = width;
+  mm.height = m.height = height;
+  mm.encoding = "16UC1";
+  m.encoding = "32FC1";
+  mm.step = width * sizeof(uint16_t);
+  m.step = width * sizeof(float);
+  mm.data.resize(mm.step * height);
+  m.data.resize(m.step * height);
+  for (int i = 0; i < width * height; i++) {
+    const uint16_t depth_mm = i % 4 == 1 ? 0 : 1000 + 100 * i;
+    const float depth_m = depth_mm == 0 ? NAN : depth_mm / 1000.f;
+    std::memcpy(&mm.data[i * sizeof(uint16_t)], &depth_mm, sizeof(uint16_t));
+    std::memcpy(&m.data[i * sizeof(float)], &depth_m, sizeof(float));
+  }
+  const Eigen::Affine3f transform(Eigen::Translation3f(0.f, 0.f, 1.f));
+  pcl::PointCloud<pcl::PointXYZ> cloud_mm, cloud_m;
+
+  // WHEN: we back-project them
+  ASSERT_TRUE(ingestDepthImage(mm, info, transform, ingestionParameters(),
+                               cloud_mm));
+  ASSERT_TRUE(ingestDepthImage(m, info, transform, ingestionParameters(),
+                               cloud_m));
+
+  // THEN: every pixel with depth becomes a point on its pixel ray
+  ASSERT_EQ(9u, cloud_mm.size());
+  ASSERT_EQ(9u, cloud_m.size());
+  size_t k = 0;
+  for (int v = 0; v < height; v++) {
+    for (int u = 0; u < width; u++) {
+      const int i = v * width + u;
+      if (i % 4 == 1) continue;
+      const float depth = 1.f + 0.1f * i;
+      EXPECT_NEAR((u - 1.5f) / 2.f * depth, cloud_mm[k].x, 1e-4f);
+      EXPECT_NEAR((v - 1.f) / 4.f * depth, cloud_mm[k].y, 1e-4f);
+      EXPECT_NEAR(depth + 1.f, cloud_mm[k].z, 1e-4f);
+      EXPECT_NEAR(cloud_mm[k].z, cloud_m[k].z, 1e-4f);
+      k++;
+    }
+  }
+
+  // WHEN: the encoding is not a depth encoding
+  m.encoding = "rgb8";
+
+  // THEN: the image is rejected
+  EXPECT_FALSE(ingestDepthImage(m, info, transform, ingestionParameters(),
+                                cloud_m));
+}
+
+TEST(PointcloudIngestion, angularStrideFollowsPixelFootprint) {
+  // GIVEN: a 640x480 camera with a 90 degree horizontal field of view
+  sensor_msgs::CameraInfo info;
+  info.width = 640;
+  info.height = 480;
+  info.K = {{320.0, 0.0, 320.0, 0.0, 320.0, 240.0, 0.0, 0.0, 1.0}};
+  ingestionParameters params;
+
+  // WHEN: the samples are binned at 3 degrees
+  setAngularStride(info, 640, 480, 3.f, params);
+
+  // THEN: neighbouring samples at the image center are at most 3 degrees apart
+  // (one pixel spans 0.179 degrees there)
+  EXPECT_EQ(16, params.row_stride);
+  EXPECT_EQ(16, params.column_stride);
+
+  // WHEN: the cloud is published at half the calibrated width
+  setAngularStride(info, 320, 480, 3.f, params);
+
+  // THEN: the column stride halves
+  EXPECT_EQ(16, params.row_stride);
+  EXPECT_EQ(8, params.column_stride);
+
+  // WHEN: the pixels are wider than the resolution
+  setAngularStride(info, 640, 480, 0.1f, params);
+
+  // THEN: every pixel is read
+  EXPECT_EQ(1, params.row_stride);
+  EXPECT_EQ(1, params.column_stride);
+}
+
+TEST(PointcloudIngestion, voxelPrefilterKeepsFirstPointPerVoxel) {
+  // GIVEN: points in three voxels of 0.5m, one of them on the negative side
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  cloud.push_back(pcl::PointXYZ(0.1f, 0.1f, 0.1f));
+  cloud.push_back(pcl::PointXYZ(0.6f, 0.1f, 0.1f));
+  cloud.push_back(pcl::PointXYZ(0.4f, 0.4f, 0.4f));
+  cloud.push_back(pcl::PointXYZ(-0.1f, 0.1f, 0.1f));
+  cloud.push_back(pcl::PointXYZ(0.9f, 0.2f, 0.3f));
+
+  // WHEN: we prefilter it
+  voxelPrefilter(0.5f, cloud);
+
+  // THEN: the first point of each voxel is kept in order
+  ASSERT_EQ(3u, cloud.size());
+  EXPECT_FLOAT_EQ(0.1f, cloud[0].x);
+  EXPECT_FLOAT_EQ(0.6f, cloud[1].x);
+  EXPECT_FLOAT_EQ(-0.1f, cloud[2].x);
+  EXPECT_EQ(3u, cloud.width);
+
+  // WHEN: the leaf size is zero
+  voxelPrefilter(0.f, cloud);
+
+  // THEN: the cloud is unchanged
+  EXPECT_EQ(3u, cloud.size());
+}
+
+TEST(PointcloudIngestion, randomPrefilterSamplesWithoutRepetition) {
+  // GIVEN: a cloud of 100 distinct points
+  pcl::PointCloud<pcl::PointXYZ> cloud;
+  for (int i = 0; i < 100; i++) {
+    cloud.push_back(pcl::PointXYZ(static_cast<float>(i), 0.f, 0.f));
+  }
+  std::minstd_rand generator(3);
+
+  // WHEN: we sample 30 of them
+  randomPrefilter(30, generator, cloud);
+
+  // THEN: 30 distinct points of the original cloud are left
+  ASSERT_EQ(30u, cloud.size());
+  std::vector<bool> seen(100, false);
+  for (const pcl::PointXYZ& p : cloud) {
+    const int i = static_cast<int>(p.x);
+    ASSERT_TRUE(i >= 0 && i < 100);
+    EXPECT_FALSE(seen[i]);
+    seen[i] = true;
+  }
+
+  // WHEN: the sample is larger than the cloud
+  randomPrefilter(50, generator, cloud);
+
+  // THEN: all points are kept
+  EXPECT_EQ(30u, cloud.size());
+}
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/common.h"
+#include "../include/local_planner/polar_binning.h"
+
+#include <random>
+#include <vector>
+
+using namespace avoidance;
+
+namespace {
+
+// bins the points with the batch kernel and the scalar functions and counts
+// the points where they disagree
+int countMismatches(const std::vector<float>& x, const std::vector<float>& y,
+                    const std::vector<float>& z, const Eigen::Vector3f& origin,
+                    int res, const PolarBinningTable* table = nullptr) {
+  const size_t n = x.size();
+  std::vector<int> e_index(n), z_index(n);
+  std::vector<float> range(n);
+  if (table) {
+    cartesianToHistogramIndices(*table, x.data(), y.data(), z.data(), n,
+                                origin, res, e_index.data(), z_index.data(),
+                                range.data());
+  } else {
+    cartesianToHistogramIndices(x.data(), y.data(), z.data(), n, origin, res,
+                                e_index.data(), z_index.data(), range.data());
+  }
+  int mismatches = 0;
+  for (size_t i = 0; i < n; i++) {
+    PolarPoint p_pol = cartesianToPolar(x[i], y[i], z[i], origin);
+    Eigen::Vector2i p_ind = polarToHistogramIndex(p_pol, res);
+    if (p_ind.y() != e_index[i] || p_ind.x() != z_index[i] ||
+        p_pol.r != range[i]) {
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+}
+
+TEST(PolarBinning, matchesScalarOnRandomClouds) {
+  // GIVEN: randomised clouds around randomised origins, with sizes which are
+  // not a multiple of the SIMD width
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> coordinate(-20.f, 20.f);
+  for (int cloud = 0; cloud < 20; cloud++) {
+    const Eigen::Vector3f origin(coordinate(generator), coordinate(generator),
+                                 coordinate(generator));
+    const size_t n = 10001 + cloud;
+    std::vector<float> x(n), y(n), z(n);
+    for (size_t i = 0; i < n; i++) {
+      x[i] = origin.x() + coordinate(generator);
+      y[i] = origin.y() + coordinate(generator);
+      z[i] = origin.z() + coordinate(generator);
+    }
+
+    // WHEN: we bin them with the batch kernel
+    // THEN: the bins and ranges are the ones of the scalar path
+    for (int res : {3, 6, 12}) {
+      EXPECT_EQ(0, countMismatches(x, y, z, origin, res))
+          << "resolution " << res << " with " << polarBinningInstructionSet();
+    }
+  }
+}
+
+TEST(PolarBinning, matchesScalarOnBinBorders) {
+  // GIVEN: points exactly on and right next to bin borders, on the axes and
+  // at the origin
+  const Eigen::Vector3f origin(1.f, -2.f, 0.5f);
+  std::vector<float> x, y, z;
+  for (int e = -90; e <= 90; e += 3) {
+    for (int a = -180; a <= 180; a += 3) {
+      for (float delta : {-1e-4f, 0.f, 1e-4f}) {
+        PolarPoint p_pol(e + delta, a + delta, 5.f);
+        Eigen::Vector3f p = polarToCartesian(p_pol, origin);
+        x.push_back(p.x());
+        y.push_back(p.y());
+        z.push_back(p.z());
+      }
+    }
+  }
+  for (const Eigen::Vector3f& offset :
+       {Eigen::Vector3f(0.f, 0.f, 0.f), Eigen::Vector3f(0.f, -1.f, 0.f),
+        Eigen::Vector3f(0.f, 0.f, 2.f), Eigen::Vector3f(-3.f, 0.f, 0.f)}) {
+    x.push_back(origin.x() + offset.x());
+    y.push_back(origin.y() + offset.y());
+    z.push_back(origin.z() + offset.z());
+  }
+
+  // WHEN: we bin them with the batch kernel
+  // THEN: the bins and ranges are the ones of the scalar path
+  for (int res : {3, 6}) {
+    EXPECT_EQ(0, countMismatches(x, y, z, origin, res));
+  }
+}
+
+TEST(PolarBinning, tableMatchesScalar) {
+  // GIVEN: a binning table at 3 degrees and a random cloud which partly lies
+  // outside of the table
+  const PolarBinningTable table(12.f, 0.2f, 3);
+  const Eigen::Vector3f origin(4.f, -3.f, 2.f);
+  std::mt19937 generator(2);
+  std::uniform_real_distribution<float> coordinate(-14.f, 14.f);
+  const size_t n = 50000;
+  std::vector<float> x(n), y(n), z(n);
+  for (size_t i = 0; i < n; i++) {
+    x[i] = origin.x() + coordinate(generator);
+    y[i] = origin.y() + coordinate(generator);
+    z[i] = origin.z() + coordinate(generator);
+  }
+
+  // WHEN: we bin the points through the table
+  // THEN: the bins and ranges are the ones of the scalar path, also for
+  // multiples of the table resolution
+  EXPECT_EQ(0, countMismatches(x, y, z, origin, 3, &table));
+  EXPECT_EQ(0, countMismatches(x, y, z, origin, 6, &table));
+  EXPECT_EQ(0, countMismatches(x, y, z, origin, 12, &table));
+  EXPECT_GT(table.resolvedFraction(), 0.f);
+  EXPECT_EQ(120u * 120u * 120u * sizeof(uint16_t), table.memoryFootprint());
+  EXPECT_EQ(table.memoryFootprint(),
+            PolarBinningTable::memoryFootprint(12.f, 0.2f));
+  // small voxels are refused before their table is allocated
+  EXPECT_LT(PolarBinningTable::memoryFootprint(12.f, 0.05f),
+            MAX_BINNING_TABLE_BYTES);
+  EXPECT_GT(PolarBinningTable::memoryFootprint(12.f, 0.01f),
+            MAX_BINNING_TABLE_BYTES);
+
+  // the voxels next to the vehicle cannot be resolved
+  int e_index, z_index;
+  EXPECT_FALSE(table.lookup(0.1f, 0.1f, 0.1f, 3, e_index, z_index));
+  EXPECT_FALSE(table.lookup(20.f, 0.f, 0.f, 3, e_index, z_index));
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/pose_buffer.h"
+
+#include <cmath>
+
+using namespace avoidance;
+
+TEST(PoseBuffer, interpolatesBetweenPoses) {
+  // GIVEN: two poses one second apart, turning by 90 degrees
+  PoseBuffer buffer;
+  buffer.insert(10.0, Eigen::Vector3f(0.f, 0.f, 2.f),
+                Eigen::Quaternionf::Identity());
+  buffer.insert(11.0, Eigen::Vector3f(2.f, 4.f, 2.f),
+                Eigen::Quaternionf(
+                    Eigen::AngleAxisf(M_PI / 2.0, Eigen::Vector3f::UnitZ())));
+
+  // WHEN: we query the pose in between
+  Eigen::Affine3f pose;
+  ASSERT_TRUE(buffer.get(10.25, pose));
+
+  // THEN: position and heading are interpolated
+  EXPECT_TRUE(pose.translation().isApprox(Eigen::Vector3f(0.5f, 1.f, 2.f)));
+  const Eigen::Vector3f heading = pose.linear() * Eigen::Vector3f::UnitX();
+  EXPECT_NEAR(M_PI / 8.0, std::atan2(heading.y(), heading.x()), 1e-5);
+}
+
+TEST(PoseBuffer, rejectsTimesOutsideHistory) {
+  // GIVEN: a buffer keeping one second of poses
+  PoseBuffer buffer(1.0, 0.05);
+  Eigen::Affine3f pose;
+  EXPECT_FALSE(buffer.get(0.0, pose));
+  for (int i = 0; i <= 30; i++) {
+    buffer.insert(0.1 * i, Eigen::Vector3f(0.1f * i, 0.f, 0.f),
+                  Eigen::Quaternionf::Identity());
+  }
+
+  // THEN: old poses are dropped, out of order poses are ignored and queries
+  // slightly newer than the newest pose get the newest pose
+  EXPECT_EQ(11u, buffer.size());
+  buffer.insert(2.5, Eigen::Vector3f::Zero(), Eigen::Quaternionf::Identity());
+  EXPECT_EQ(11u, buffer.size());
+  EXPECT_FALSE(buffer.get(1.5, pose));
+  ASSERT_TRUE(buffer.get(3.03, pose));
+  EXPECT_NEAR(3.f, pose.translation().x(), 1e-5f);
+  EXPECT_FALSE(buffer.get(3.1, pose));
+}
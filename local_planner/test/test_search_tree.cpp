@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/search_tree.h"
+
+#include <random>
+
+using namespace avoidance;
+
+namespace {
+
+bool hasNodeCloserThanBruteForce(const SearchTree& tree,
+                                 const Eigen::Vector3f& pos, float distance) {
+  for (size_t i = 0; i < tree.size(); i++) {
+    if ((tree.getPosition(i) - pos).norm() < distance) {
+      return true;
+    }
+  }
+  return false;
+}
+}
+
+TEST(SearchTree, addNode) {
+  // GIVEN: an empty tree
+  SearchTree tree;
+
+  // WHEN: we add a root and a child node
+  int root = tree.addNode(0, 0, Eigen::Vector3f(1.f, 2.f, 3.f));
+  int child = tree.addNode(root, 1, Eigen::Vector3f(-1.f, 2.f, 3.f));
+
+  // THEN: the nodes are stored in insertion order and open
+  EXPECT_EQ(0, root);
+  EXPECT_EQ(1, child);
+  EXPECT_EQ(2u, tree.size());
+  EXPECT_EQ(root, tree.origin_[child]);
+  EXPECT_EQ(1, tree.depth_[child]);
+  EXPECT_EQ(0, tree.closed_[child]);
+  EXPECT_TRUE(tree.getPosition(child).isApprox(Eigen::Vector3f(-1, 2, 3)));
+
+  // WHEN: we clear the tree
+  tree.clear();
+
+  // THEN: no node is left to be found
+  EXPECT_EQ(0u, tree.size());
+  EXPECT_FALSE(tree.hasNodeCloserThan(Eigen::Vector3f(1.f, 2.f, 3.f), 0.2f));
+}
+
+TEST(SearchTree, closeNodeHashMatchesBruteForce) {
+  // GIVEN: two trees grown from the same random candidate sequence, one
+  // rejecting close candidates through the hash grid and one by comparing
+  // against every node
+  std::mt19937 generator(3);
+  std::uniform_real_distribution<float> coordinate(-2.f, 2.f);
+  std::uniform_int_distribution<int> parent(0, 100);
+  SearchTree hash_tree(0.2f);
+  SearchTree brute_force_tree(0.2f);
+  hash_tree.addNode(0, 0, Eigen::Vector3f::Zero());
+  brute_force_tree.addNode(0, 0, Eigen::Vector3f::Zero());
+
+  // WHEN: we insert the candidates which have no close node
+  for (int i = 0; i < 5000; i++) {
+    Eigen::Vector3f candidate(coordinate(generator), coordinate(generator),
+                              coordinate(generator));
+    int origin = parent(generator) % hash_tree.size();
+    if (!hash_tree.hasNodeCloserThan(candidate, 0.2f)) {
+      hash_tree.addNode(origin, 1, candidate);
+    }
+    if (!hasNodeCloserThanBruteForce(brute_force_tree, candidate, 0.2f)) {
+      brute_force_tree.addNode(origin, 1, candidate);
+    }
+  }
+
+  // THEN: both trees are identical
+  ASSERT_EQ(brute_force_tree.size(), hash_tree.size());
+  for (size_t i = 0; i < hash_tree.size(); i++) {
+    EXPECT_EQ(brute_force_tree.origin_[i], hash_tree.origin_[i]);
+    EXPECT_EQ(brute_force_tree.getPosition(i), hash_tree.getPosition(i));
+  }
+}
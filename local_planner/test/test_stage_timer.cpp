@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/stage_timer.h"
+
+#include <thread>
+#include <vector>
+
+using namespace avoidance;
+
+TEST(StageTimer, percentilesOfRecordedDurations) {
+  // GIVEN: durations of 1ms to 100ms
+  LatencyHistogram histogram;
+  for (int i = 1; i <= 100; i++) {
+    histogram.record(static_cast<uint64_t>(i) * 1000000);
+  }
+
+  // WHEN: we collect them
+  stageStatistics stats = histogram.collect();
+
+  // THEN: the percentiles are within the bucket resolution
+  EXPECT_EQ(100u, stats.count);
+  EXPECT_GE(stats.p50_ms, 50.0);
+  EXPECT_LE(stats.p50_ms, 50.0 * 1.13);
+  EXPECT_GE(stats.p95_ms, 95.0);
+  EXPECT_LE(stats.p95_ms, 100.0);
+  EXPECT_GE(stats.p99_ms, 99.0);
+  EXPECT_LE(stats.p99_ms, 100.0);
+  EXPECT_DOUBLE_EQ(100.0, stats.max_ms);
+
+  // WHEN: we collect again
+  stats = histogram.collect();
+
+  // THEN: the window was restarted
+  EXPECT_EQ(0u, stats.count);
+  EXPECT_DOUBLE_EQ(0.0, stats.max_ms);
+
+  // WHEN: durations are below 1us or above the largest bucket
+  histogram.record(10);
+  histogram.record(60ull * 1000000000ull);
+  stats = histogram.collect();
+
+  // THEN: they are still counted
+  EXPECT_EQ(2u, stats.count);
+  EXPECT_DOUBLE_EQ(60000.0, stats.max_ms);
+  EXPECT_LE(stats.p50_ms, 1.25e-3);
+}
+
+TEST(StageTimer, concurrentRecordingIsCounted) {
+  // GIVEN: several threads recording while another one collects
+  LatencyHistogram histogram;
+  const int n_threads = 4, n_samples = 100000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < n_threads; t++) {
+    threads.emplace_back([&histogram, t] {
+      for (int i = 0; i < n_samples; i++) histogram.record(1000 * (t + 1));
+    });
+  }
+  uint64_t count = 0;
+  for (int i = 0; i < 100; i++) count += histogram.collect().count;
+  for (std::thread& t : threads) t.join();
+  count += histogram.collect().count;
+
+  // THEN: every sample is counted exactly once
+  EXPECT_EQ(static_cast<uint64_t>(n_threads * n_samples), count);
+}
+
+TEST(StageTimer, scopedTimerRecordsIntoItsStage) {
+  // GIVEN: a stage without samples
+  stageHistogram(Stage::kCostMatrix).collect();
+
+  // WHEN: a scope of 2ms is timed
+  {
+    ScopedStageTimer timer(Stage::kCostMatrix);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+
+  // THEN: one sample of at least 2ms is recorded
+  const stageStatistics stats = stageHistogram(Stage::kCostMatrix).collect();
+  EXPECT_EQ(1u, stats.count);
+  EXPECT_GE(stats.max_ms, 2.0);
+  EXPECT_STREQ("cost matrix", stageName(Stage::kCostMatrix));
+}
@@ -1,8 +1,8 @@
 #include <gtest/gtest.h>
 
 #include "../include/local_planner/common.h"
+#include "../include/local_planner/search_tree.h"
 #include "../include/local_planner/star_planner.h"
-#include "../include/local_planner/tree_node.h"
 
 using namespace avoidance;
 
@@ -65,9 +65,9 @@ TEST_F(StarPlannerTests, buildTree) {
   // WHEN: we build the tree for 15 times
   for (size_t i = 0; i < 15; i++) {
     star_planner.buildLookAheadTree();
-    for (auto node : star_planner.tree_) {
+    for (size_t node = 0; node < star_planner.tree_.size(); node++) {
       // THEN: we expect each tree node position not to be close to the obstacle
-      Eigen::Vector3f n = node.getPosition();
+      Eigen::Vector3f n = star_planner.tree_.getPosition(node);
       bool node_inside_obstacle =
           n.x() > obstacle_min_x && n.x() < obstacle_max_x &&
           n.y() > obstacle_y - 0.1f && n.y() < obstacle_y + 0.1f &&
@@ -85,7 +85,7 @@ TEST_F(StarPlannerTests, buildTree) {
 
     // we set the vehicle position to be the first node position after the
     // origin for the next algorithm iterarion
-    position = star_planner.tree_[1].getPosition();
+    position = star_planner.tree_.getPosition(1);
     star_planner.setPose(position, 0.0);
   }
 }
@@ -97,15 +97,15 @@ TEST_F(StarPlannerBasicTests, treeCostFunctionTargetCost) {
 
   // insert tree root
   Eigen::Vector3f tree_root(0.f, 0.f, 0.f);
-  tree_.push_back(TreeNode(0, 0, tree_root));
-  tree_.back().yaw_ = 90.0;  // drone looks straight ahead
-  tree_.back().last_z_ = tree_.back().yaw_;
+  tree_.addNode(0, 0, tree_root);
+  tree_.yaw_.back() = 90.0;  // drone looks straight ahead
+  tree_.last_z_.back() = tree_.yaw_.back();
 
   // insert first Node
   Eigen::Vector3f node1(1.f, 0.f, 0.f);
-  tree_.push_back(TreeNode(0, 1, node1));
-  tree_.back().last_e_ = 0.f;
-  tree_.back().last_z_ = 90.f;
+  tree_.addNode(0, 1, node1);
+  tree_.last_e_.back() = 0.f;
+  tree_.last_z_.back() = 90.f;
 
   // last path equal to the given nodes
   std::vector<Eigen::Vector3f> path_node_positions_;
@@ -134,15 +134,15 @@ TEST_F(StarPlannerBasicTests, treeCostFunctionOldPathCost) {
 
   // insert tree root
   Eigen::Vector3f tree_root(0.f, 0.f, 0.f);
-  tree_.push_back(TreeNode(0, 0, tree_root));
-  tree_.back().yaw_ = 90.0;  // drone looks straight ahead
-  tree_.back().last_z_ = tree_.back().yaw_;
+  tree_.addNode(0, 0, tree_root);
+  tree_.yaw_.back() = 90.0;  // drone looks straight ahead
+  tree_.last_z_.back() = tree_.yaw_.back();
 
   // insert first Node
   Eigen::Vector3f node1(1.f, 0.f, 0.f);
-  tree_.push_back(TreeNode(0, 1, node1));
-  tree_.back().last_e_ = 0.f;
-  tree_.back().last_z_ = 90.f;
+  tree_.addNode(0, 1, node1);
+  tree_.last_e_.back() = 0.f;
+  tree_.last_z_.back() = 90.f;
 
   // last path case 1: equal to the current nodes
   std::vector<Eigen::Vector3f> path_node_positions1;
@@ -175,9 +175,9 @@ TEST_F(StarPlannerBasicTests, treeCostFunctionYawCost) {
 
   // insert tree root
   Eigen::Vector3f tree_root(0.f, 0.f, 0.f);
-  tree_.push_back(TreeNode(0, 0, tree_root));
-  tree_.back().yaw_ = 90;  // drone looks straight ahead
-  tree_.back().last_z_ = tree_.back().yaw_;
+  tree_.addNode(0, 0, tree_root);
+  tree_.yaw_.back() = 90;  // drone looks straight ahead
+  tree_.last_z_.back() = tree_.yaw_.back();
 
   // insert two nodes to both sides
   PolarPoint node1_pol(0, 110, 1);  // to the right
@@ -185,13 +185,13 @@ TEST_F(StarPlannerBasicTests, treeCostFunctionYawCost) {
   Eigen::Vector3f node1 = polarToCartesian(node1_pol, tree_root);
   Eigen::Vector3f node2 = polarToCartesian(node2_pol, tree_root);
 
-  tree_.push_back(TreeNode(0, 1, node1));
-  tree_.back().last_e_ = node1_pol.e;
-  tree_.back().last_z_ = node1_pol.z;
+  tree_.addNode(0, 1, node1);
+  tree_.last_e_.back() = node1_pol.e;
+  tree_.last_z_.back() = node1_pol.z;
 
-  tree_.push_back(TreeNode(0, 1, node2));
-  tree_.back().last_e_ = node2_pol.e;
-  tree_.back().last_z_ = node2_pol.z;
+  tree_.addNode(0, 1, node2);
+  tree_.last_e_.back() = node2_pol.e;
+  tree_.last_z_.back() = node2_pol.z;
 
   // last path straight ahead
   Eigen::Vector3f node_old(1.f, 0.f, 0.f);
@@ -205,14 +205,14 @@ TEST_F(StarPlannerBasicTests, treeCostFunctionYawCost) {
   float cost2_straight = treeCostFunction(2);
 
   // WHEN: we calculate the cost for both nodes as the drone looks to the right
-  tree_[0].yaw_ = 100;  // drone looks 10 degrees to the right
-  tree_[0].last_z_ = tree_[0].yaw_;
+  tree_.yaw_[0] = 100;  // drone looks 10 degrees to the right
+  tree_.last_z_[0] = tree_.yaw_[0];
   float cost1_right = treeCostFunction(1);
   float cost2_right = treeCostFunction(2);
 
   // WHEN: we calculate the cost for both nodes as the drone looks to the left
-  tree_[0].yaw_ = 80;  // drone looks 10 degrees to the right
-  tree_[0].last_z_ = tree_[0].yaw_;
+  tree_.yaw_[0] = 80;  // drone looks 10 degrees to the right
+  tree_.last_z_[0] = tree_.yaw_[0];
   float cost1_left = treeCostFunction(1);
   float cost2_left = treeCostFunction(2);
 
@@ -235,14 +235,14 @@ TEST_F(StarPlannerBasicTests, treeCostFunctionSmoothingCost) {
 
   // insert tree root
   Eigen::Vector3f tree_root(0.f, 0.f, 0.f);
-  tree_.push_back(TreeNode(0, 0, tree_root));
-  tree_.back().last_z_ = 90;
+  tree_.addNode(0, 0, tree_root);
+  tree_.last_z_.back() = 90;
 
   // insert first node (straight ahead)
   Eigen::Vector3f node1(1.f, 0.f, 0.f);
-  tree_.push_back(TreeNode(0, 1, node1));
-  tree_.back().last_e_ = 0.f;
-  tree_.back().last_z_ = 90.f;
+  tree_.addNode(0, 1, node1);
+  tree_.last_e_.back() = 0.f;
+  tree_.last_z_.back() = 90.f;
 
   // insert two more nodes with node 1 as origin
   PolarPoint node2_pol(0, 100, 1);
@@ -250,13 +250,13 @@ TEST_F(StarPlannerBasicTests, treeCostFunctionSmoothingCost) {
   Eigen::Vector3f node2 = polarToCartesian(node2_pol, node1);
   Eigen::Vector3f node3 = polarToCartesian(node3_pol, node1);
 
-  tree_.push_back(TreeNode(1, 2, node2));
-  tree_.back().last_e_ = node2_pol.e;
-  tree_.back().last_z_ = node2_pol.z;
+  tree_.addNode(1, 2, node2);
+  tree_.last_e_.back() = node2_pol.e;
+  tree_.last_z_.back() = node2_pol.z;
 
-  tree_.push_back(TreeNode(1, 2, node3));
-  tree_.back().last_e_ = node3_pol.e;
-  tree_.back().last_z_ = node3_pol.z;
+  tree_.addNode(1, 2, node3);
+  tree_.last_e_.back() = node3_pol.e;
+  tree_.last_z_.back() = node3_pol.z;
 
   // calculate two goal positions in direction of the nodes 2, 3
   PolarPoint goal2_pol(0, 100, 5);
@@ -266,13 +266,145 @@ TEST_F(StarPlannerBasicTests, treeCostFunctionSmoothingCost) {
 
   // WHEN: we calculate the cost for nodes 2, 3
   setGoal(goal2);
-  tree_[0].yaw_ = 100;
+  tree_.yaw_[0] = 100;
   float cost2 = treeCostFunction(2);
   setGoal(goal3);
-  tree_[0].yaw_ = 110;
+  tree_.yaw_[0] = 110;
   float cost3 = treeCostFunction(3);
 
   // THEN: the path node with the more curved path (node 3) should be more
   // expensive
   EXPECT_GT(cost3, cost2);
 }
+
+TEST_F(StarPlannerBasicTests, histogramCacheInvalidation) {
+  // GIVEN: a pointcloud with a single obstacle in front of the vehicle
+  Eigen::Vector3f position(0.f, 0.f, 0.f);
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  cloud.push_back(toXYZI(0.f, 3.f, 0.f, 0));
+  setPose(position, 90.f);
+  setPointcloud(cloud);
+
+  // WHEN: we request the histogram twice
+  PolarPoint obstacle_pol = cartesianToPolar(toEigen(cloud[0]), position);
+  Eigen::Vector2i obstacle_idx = polarToHistogramIndex(obstacle_pol, ALPHA_RES);
+  float first_dist =
+      getHistogram().get_dist(obstacle_idx.y(), obstacle_idx.x());
+  float second_dist =
+      getHistogram().get_dist(obstacle_idx.y(), obstacle_idx.x());
+
+  // THEN: the cached histogram contains the obstacle both times
+  EXPECT_FLOAT_EQ(3.f, first_dist);
+  EXPECT_FLOAT_EQ(first_dist, second_dist);
+
+  // WHEN: the vehicle moves closer to the obstacle
+  setPose(Eigen::Vector3f(0.f, 1.f, 0.f), 90.f);
+
+  // THEN: the histogram is regenerated around the new position
+  EXPECT_FLOAT_EQ(2.f,
+                  getHistogram().get_dist(obstacle_idx.y(), obstacle_idx.x()));
+
+  // WHEN: a new empty pointcloud is set
+  setPointcloud(pcl::PointCloud<pcl::PointXYZI>());
+
+  // THEN: the histogram is regenerated and empty
+  EXPECT_TRUE(getHistogram().isEmpty());
+}
+
+TEST_F(StarPlannerTests, obstacleWithinClearanceOfRoot) {
+  // GIVEN: an obstacle point 0.1m beside the vehicle, within the node
+  // clearance
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  cloud.push_back(toXYZI(position.x() - 0.1f, position.y(), position.z(), 0));
+  star_planner.setPointcloud(cloud);
+
+  // WHEN: we build the tree
+  star_planner.buildLookAheadTree();
+
+  // THEN: the tree still grows towards the goal, away from the point
+  ASSERT_GT(star_planner.tree_.size(), 1u);
+  ASSERT_GT(star_planner.path_node_positions_.size(), 1u);
+  const Eigen::Vector3f first_node = star_planner.tree_.getPosition(1);
+  EXPECT_LT((goal - first_node).norm(), (goal - position).norm());
+}
+
+TEST_F(StarPlannerTests, obstacleAtRoot) {
+  // GIVEN: a noisy obstacle point 1cm in front of the vehicle, towards the
+  // goal, and enough children per node to find the directions away from it
+  avoidance::LocalPlannerNodeConfig config =
+      avoidance::LocalPlannerNodeConfig::__getDefault__();
+  config.children_per_node_ = 50;
+  config.n_expanded_nodes_ = 10;
+  star_planner.dynamicReconfigureSetStarParams(config, 1);
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  const Eigen::Vector3f point = position + Eigen::Vector3f(0.f, 0.01f, 0.f);
+  cloud.push_back(toXYZI(point.x(), point.y(), point.z(), 0));
+  star_planner.setPointcloud(cloud);
+
+  // WHEN: we build the tree
+  star_planner.buildLookAheadTree();
+
+  // THEN: the tree still grows, but no child of the root approaches the point
+  // and the deeper nodes keep the full clearance
+  const SearchTree& tree = star_planner.tree_;
+  ASSERT_GT(tree.size(), 1u);
+  EXPECT_GT(star_planner.closed_set_.size(), 1u);
+  for (size_t node = 1; node < tree.size(); node++) {
+    const Eigen::Vector3f node_position = tree.getPosition(node);
+    if (tree.origin_[node] == 0) {
+      EXPECT_LE((node_position - position).dot(point - position), 0.f);
+    } else {
+      EXPECT_GE((node_position - point).norm(), config.node_clearance_);
+    }
+  }
+}
+
+TEST_F(StarPlannerTests, nonFiniteCostsAreNotExpanded) {
+  // GIVEN: a star planner smoothing towards a previous path with invalid
+  // positions, so the cost of every new node is NaN
+  avoidance::LocalPlannerNodeConfig config =
+      avoidance::LocalPlannerNodeConfig::__getDefault__();
+  config.children_per_node_ = 8;
+  config.n_expanded_nodes_ = 20;
+  star_planner.dynamicReconfigureSetStarParams(config, 1);
+  star_planner.tree_age_ = 0;
+  star_planner.path_node_positions_.assign(5, Eigen::Vector3f(NAN, NAN, NAN));
+
+  // WHEN: we build the tree
+  star_planner.buildLookAheadTree();
+
+  // THEN: the children of the root are created but none of them is expanded
+  EXPECT_GT(star_planner.tree_.size(), 1u);
+  ASSERT_EQ(1u, star_planner.closed_set_.size());
+  EXPECT_EQ(0, star_planner.closed_set_[0]);
+  EXPECT_EQ(1u, star_planner.path_node_positions_.size());
+}
+
+TEST_F(StarPlannerTests, expandNodesOnlyOnce) {
+  // GIVEN: a star planner allowed to build a large tree
+  avoidance::LocalPlannerNodeConfig config =
+      avoidance::LocalPlannerNodeConfig::__getDefault__();
+  config.children_per_node_ = 50;
+  config.n_expanded_nodes_ = 100;
+  config.max_path_length_ = 5.0;
+  star_planner.dynamicReconfigureSetStarParams(config, 1);
+
+  // WHEN: we build the tree
+  star_planner.buildLookAheadTree();
+
+  // THEN: every node is expanded at most once, the closed flags match the
+  // closed set and expanded nodes are within the maximum path length
+  const SearchTree& tree = star_planner.tree_;
+  std::vector<int> expansions(tree.size(), 0);
+  for (int node : star_planner.closed_set_) {
+    expansions[node]++;
+    EXPECT_LT((tree.getPosition(node) - position).norm(),
+              config.max_path_length_);
+  }
+  for (size_t node = 0; node < tree.size(); node++) {
+    EXPECT_LE(expansions[node], 1);
+    EXPECT_EQ(expansions[node] == 1, tree.closed_[node] == 1);
+  }
+  EXPECT_EQ(static_cast<size_t>(config.n_expanded_nodes_),
+            star_planner.closed_set_.size());
+}
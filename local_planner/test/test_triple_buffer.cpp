@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/triple_buffer.h"
+
+#include <thread>
+#include <vector>
+
+using namespace avoidance;
+
+TEST(TripleBuffer, consumerGetsNewestValue) {
+  // GIVEN: an empty buffer
+  TripleBuffer<int> buffer;
+
+  // THEN: there is nothing to read
+  EXPECT_FALSE(buffer.update());
+  EXPECT_FALSE(buffer.hasValue());
+
+  // WHEN: the producer publishes two values before the consumer reads
+  buffer.writeBuffer() = 1;
+  buffer.publish();
+  buffer.writeBuffer() = 2;
+  buffer.publish();
+
+  // THEN: the consumer gets the newest one, once
+  EXPECT_TRUE(buffer.update());
+  EXPECT_TRUE(buffer.hasValue());
+  EXPECT_EQ(2, buffer.readBuffer());
+  EXPECT_FALSE(buffer.update());
+  EXPECT_EQ(2, buffer.readBuffer());
+
+  // WHEN: the producer writes its next value
+  buffer.writeBuffer() = 3;
+
+  // THEN: the value held by the consumer is not touched
+  EXPECT_EQ(2, buffer.readBuffer());
+  buffer.publish();
+  EXPECT_TRUE(buffer.update());
+  EXPECT_EQ(3, buffer.readBuffer());
+}
+
+TEST(TripleBuffer, concurrentHandoffIsConsistent) {
+  // GIVEN: a producer publishing vectors filled with their sequence number
+  TripleBuffer<std::vector<int>> buffer;
+  const int n_values = 20000;
+  std::thread producer([&buffer, n_values] {
+    for (int i = 1; i <= n_values; i++) {
+      std::vector<int>& value = buffer.writeBuffer();
+      value.assign(64, i);
+      buffer.publish();
+    }
+  });
+
+  // WHEN: the consumer reads while the producer is writing
+  int last = 0;
+  bool consistent = true;
+  while (last < n_values) {
+    if (!buffer.update()) {
+      std::this_thread::yield();
+      continue;
+    }
+    const std::vector<int>& value = buffer.readBuffer();
+    for (int v : value) consistent &= v == value[0];
+    // THEN: every value is complete and newer than the previous one
+    EXPECT_GT(value[0], last);
+    last = value[0];
+  }
+  producer.join();
+  EXPECT_TRUE(consistent);
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/common.h"
+#include "../include/local_planner/voxel_index.h"
+
+#include <random>
+
+using namespace avoidance;
+
+TEST(VoxelIndex, emptyIndex) {
+  // GIVEN: an index built from an empty pointcloud
+  VoxelIndex index(1.f);
+  index.build(pcl::PointCloud<pcl::PointXYZI>());
+
+  // WHEN: we query points and segments
+  pcl::PointCloud<pcl::PointXYZI> result;
+  index.getPointsWithinRadius(Eigen::Vector3f(0.f, 0.f, 0.f), 10.f, result);
+
+  // THEN: no points are found and every segment is free
+  EXPECT_EQ(0u, index.size());
+  EXPECT_EQ(0u, result.size());
+  EXPECT_TRUE(index.isSegmentFree(Eigen::Vector3f(0.f, 0.f, 0.f),
+                                  Eigen::Vector3f(5.f, 5.f, 5.f), 1.f));
+}
+
+TEST(VoxelIndex, pointsWithinRadiusMatchBruteForce) {
+  // GIVEN: a random pointcloud with negative and positive coordinates
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<float> coordinate(-10.f, 10.f);
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  for (int i = 0; i < 5000; i++) {
+    cloud.push_back(toXYZI(coordinate(generator), coordinate(generator),
+                           coordinate(generator), 0.f));
+  }
+  VoxelIndex index(0.7f);
+  index.build(cloud);
+  EXPECT_EQ(cloud.size(), index.size());
+
+  for (int query = 0; query < 20; query++) {
+    // WHEN: we query the points around a random center
+    Eigen::Vector3f center(coordinate(generator), coordinate(generator),
+                           coordinate(generator));
+    float radius = 0.5f + 0.25f * query;
+    pcl::PointCloud<pcl::PointXYZI> result;
+    index.getPointsWithinRadius(center, radius, result);
+
+    // THEN: the index finds the same number of points as a linear search
+    size_t expected = 0;
+    for (const pcl::PointXYZI& p : cloud) {
+      if ((toEigen(p) - center).norm() < radius) expected++;
+    }
+    EXPECT_EQ(expected, result.size());
+    for (const pcl::PointXYZI& p : result) {
+      EXPECT_LT((toEigen(p) - center).norm(), radius);
+    }
+  }
+}
+
+TEST(VoxelIndex, segmentClearance) {
+  // GIVEN: an index with a single point
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  cloud.push_back(toXYZI(1.f, 0.5f, 0.f, 0.f));
+  VoxelIndex index(1.f);
+  index.build(cloud);
+
+  Eigen::Vector3f start(0.f, 0.f, 0.f);
+  Eigen::Vector3f end(2.f, 0.f, 0.f);
+
+  // THEN: a segment passing the point at 0.5m is only free for a smaller
+  // clearance
+  EXPECT_TRUE(index.isSegmentFree(start, end, 0.4f));
+  EXPECT_FALSE(index.isSegmentFree(start, end, 0.6f));
+
+  // THEN: a segment ending before the point is measured from its end point
+  Eigen::Vector3f short_end(0.5f, 0.f, 0.f);
+  EXPECT_TRUE(index.isSegmentFree(start, short_end, 0.7f));
+  EXPECT_FALSE(index.isSegmentFree(start, short_end, 0.75f));
+}
+
+TEST(VoxelIndex, pointWithinClearanceOfStart) {
+  // GIVEN: an index with a point 1cm from the segment start
+  pcl::PointCloud<pcl::PointXYZI> cloud;
+  cloud.push_back(toXYZI(0.01f, 0.f, 0.f, 0.f));
+  VoxelIndex index(1.f);
+  index.build(cloud);
+  const Eigen::Vector3f start(0.f, 0.f, 0.f);
+
+  // THEN: segments moving away from the point or passing it sideways are
+  // free, segments approaching it are not
+  EXPECT_TRUE(index.isSegmentFree(start, Eigen::Vector3f(-1.f, 0.f, 0.f),
+                                  0.3f));
+  EXPECT_TRUE(index.isSegmentFree(start, Eigen::Vector3f(0.f, 1.f, 0.f),
+                                  0.3f));
+  EXPECT_FALSE(index.isSegmentFree(start, Eigen::Vector3f(1.f, 1.f, 0.f),
+                                   0.3f));
+  EXPECT_FALSE(index.isSegmentFree(start, Eigen::Vector3f(1.f, 0.f, 0.f),
+                                   0.3f));
+
+  // THEN: the full clearance applies to the other points
+  cloud.push_back(toXYZI(-0.5f, 0.2f, 0.f, 0.f));
+  index.build(cloud);
+  EXPECT_FALSE(index.isSegmentFree(start, Eigen::Vector3f(-1.f, 0.f, 0.f),
+                                   0.3f));
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include "../include/local_planner/worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+using namespace avoidance;
+
+TEST(WorkerPool, runsEveryIndexOncePerCall) {
+  for (unsigned int n_threads : {0u, 1u, 4u}) {
+    // GIVEN: a pool of threads
+    WorkerPool pool(n_threads);
+    std::vector<std::atomic<int>> calls(pool.size());
+    for (auto& c : calls) c = 0;
+
+    // WHEN: we run many short tasks
+    const int n_runs = 1000;
+    for (int r = 0; r < n_runs; r++) {
+      pool.run([&calls](unsigned int index) { calls[index]++; });
+    }
+
+    // THEN: each index ran once per call and every call waited for all of
+    // them
+    EXPECT_EQ(std::max(1u, n_threads), pool.size());
+    for (const auto& c : calls) {
+      EXPECT_EQ(n_runs, c);
+    }
+  }
+}
+
+TEST(WorkerPool, tasksRunConcurrently) {
+  // GIVEN: a pool of three threads
+  WorkerPool pool(3);
+  std::atomic<unsigned int> arrived{0};
+
+  // WHEN: every task waits until all tasks have started
+  pool.run([&](unsigned int) {
+    arrived++;
+    while (arrived < 3) {
+    }
+  });
+
+  // THEN: the call returns, so the tasks ran on different threads
+  EXPECT_EQ(3u, arrived);
+}